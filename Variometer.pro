@@ -4,26 +4,34 @@ greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 DEFINES += QT_POSITIONING_IOS    # For iOS-specific positioning
 
+# NMEA from a serial port or pseudo-terminal (--nmea /dev/...), desktop only
+!android:!ios:qtHaveModule(serialport) {
+    QT += serialport
+    DEFINES += HAVE_SERIALPORT
+}
+
 CONFIG += c++17
 
 # You can make your code fail to compile if it uses deprecated APIs.
 # In order to do so, uncomment the following line.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+include(libvario/libvario.pri)
+
 SOURCES += \
-    KalmanFilter.cpp \
     main.cpp \
     mainwindow.cpp \
     readgps.cpp \
     sensormanager.cpp \
+    varioengine.cpp \
     variosound.cpp
 
 HEADERS += \
-    KalmanFilter.h \
     mainwindow.h \
     readgps.h \
     sensormanager.h \
     utils.h \
+    varioengine.h \
     variosound.h \
     variowidget.h
 
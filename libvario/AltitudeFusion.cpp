@@ -0,0 +1,176 @@
+#include "AltitudeFusion.h"
+#include <algorithm>
+#include <cmath>
+
+AltitudeFusion::AltitudeFusion(const double bias_drift, const double gps_sigma,
+                               const double latency_time_constant)
+  :bias_drift_(bias_drift),
+   gps_variance_(gps_sigma * gps_sigma),
+   latency_time_constant_(latency_time_constant)
+{
+}
+
+void AltitudeFusion::Reset()
+{
+  next_ = count_ = 0;
+  last_baro_ = 0;
+  baro_ = 0;
+  has_offset_ = false;
+  offset_ = 0;
+  last_arrival_ = 0;
+  weight_ = mean_r_ = mean_v_ = mean_rv_ = mean_vv_ = 0;
+  latency_ = 0;
+  has_bias_ = false;
+  bias_ = variance_ = 0;
+  last_fix_ = used_ = rejected_ = rejected_in_row_ = 0;
+}
+
+double AltitudeFusion::BiasSigma() const
+{
+  return std::sqrt(variance_);
+}
+
+void AltitudeFusion::UpdateBaro(const std::uint64_t timestamp, const double altitude, const double vario)
+{
+  baro_ = altitude;
+  last_baro_ = timestamp;
+
+  if (count_ > 0) {
+    const std::uint64_t newest = history_[(next_ + kHistory - 1) % kHistory].timestamp;
+    if (timestamp < newest) {
+      count_ = 0;  // The sensor clock went backwards, the history is useless
+    } else if (timestamp < newest + static_cast<std::uint64_t>(kHistoryInterval * 1e6)) {
+      return;
+    }
+  }
+
+  history_[next_] = {timestamp, altitude, vario};
+  next_ = (next_ + 1) % kHistory;
+  if (count_ < kHistory)
+    ++count_;
+}
+
+bool AltitudeFusion::Lookup(const double time, double& altitude, double& vario) const
+{
+  if (count_ == 0)
+    return false;
+
+  // Newer than the last slot: carry it forward along its vario
+  std::size_t i = (next_ + kHistory - 1) % kHistory;
+  if (time >= history_[i].timestamp) {
+    const double ahead = (time - history_[i].timestamp) * 1e-6;
+    altitude = history_[i].altitude + history_[i].vario * ahead;
+    vario = history_[i].vario;
+    return true;
+  }
+
+  for (std::size_t n = 1; n < count_; ++n) {
+    const std::size_t older = (i + kHistory - 1) % kHistory;
+    if (time >= history_[older].timestamp) {
+      const Slot& a = history_[older];
+      const Slot& b = history_[i];
+      const double f = (time - a.timestamp) / static_cast<double>(b.timestamp - a.timestamp);
+      altitude = a.altitude + f * (b.altitude - a.altitude);
+      vario = a.vario + f * (b.vario - a.vario);
+      return true;
+    }
+    i = older;
+  }
+  return false;  // Older than the history reaches
+}
+
+void AltitudeFusion::UpdateLatency(const double residual, const double vario, const double dt)
+{
+  // High-pass both first: the GPS error and the baro bias wander over
+  // minutes, slow enough to correlate with long climbs and glides by chance,
+  // while the latency shows up in every change of the climb rate
+  if (weight_ == 0) {
+    mean_r_ = residual;
+    mean_v_ = vario;
+  }
+  const double a = std::min(dt / kHighPassTimeConstant, 1.0);
+  mean_r_ += a * (residual - mean_r_);
+  mean_v_ += a * (vario - mean_v_);
+  const double r = residual - mean_r_;
+  const double v = vario - mean_v_;
+
+  // Weighted running means with a forgetting factor; the weight grows to
+  // about latency_time_constant_ / dt, so early fixes are not underweighted
+  weight_ = weight_ * std::max(0.0, 1 - dt / latency_time_constant_) + 1;
+  const double f = 1 / weight_;
+  mean_rv_ += f * (r * v - mean_rv_);
+  mean_vv_ += f * (v * v - mean_vv_);
+
+  // The residual falls by latency * vario; only measurable while the climb
+  // rate actually varies
+  if (weight_ >= kMinLatencyFixes && mean_vv_ >= kMinVarioVariance)
+    latency_ = std::min(std::max(-mean_rv_ / mean_vv_, 0.0), kMaxLatency);
+}
+
+void AltitudeFusion::UpdateGps(const std::uint64_t timestamp, const double altitude)
+{
+  if (!std::isfinite(altitude) || altitude == 0 || count_ == 0)
+    return;
+
+  // GPS time minus the sensor time the fix arrived at: the clock offset less
+  // the delay on the way, so the largest one seen is the best estimate
+  const std::uint64_t arrival = last_baro_;
+  const std::int64_t candidate = static_cast<std::int64_t>(timestamp) - static_cast<std::int64_t>(arrival);
+  if (!has_offset_ || offset_ - candidate > static_cast<std::int64_t>(kClockJump * 1e6)) {
+    offset_ = candidate;
+    has_offset_ = true;
+  } else {
+    const std::int64_t relax = arrival > last_arrival_
+        ? static_cast<std::int64_t>((arrival - last_arrival_) * kClockDrift) : 0;
+    offset_ = std::max(candidate, offset_ - relax);
+  }
+  last_arrival_ = arrival;
+
+  // Faster fixes than this carry little new information, their errors are
+  // correlated
+  if (has_bias_ && timestamp >= last_fix_
+      && timestamp < last_fix_ + static_cast<std::uint64_t>(kFixInterval * 1e6)) {
+    return;
+  }
+  const double dt = has_bias_ && timestamp > last_fix_ ? (timestamp - last_fix_) * 1e-6 : 0;
+  last_fix_ = timestamp;
+
+  const double time = static_cast<double>(timestamp) - static_cast<double>(offset_);
+  double baro, vario;
+  if (!Lookup(time, baro, vario))
+    return;
+  UpdateLatency(altitude - baro, vario, dt);
+
+  if (latency_ > 0 && !Lookup(time - latency_ * 1e6, baro, vario))
+    return;
+  const double measured = altitude - baro;
+
+  if (!has_bias_) {
+    bias_ = measured;
+    variance_ = gps_variance_;
+    has_bias_ = true;
+    ++used_;
+    return;
+  }
+
+  variance_ += bias_drift_ * bias_drift_ * dt;
+  const double innovation = measured - bias_;
+  const double innovation_variance = variance_ + gps_variance_;
+  if (innovation * innovation > kGate * kGate * innovation_variance) {
+    ++rejected_;
+    // A lasting disagreement is a new QNH or a GPS that changed its
+    // reference, not a string of outliers
+    if (++rejected_in_row_ >= kMaxRejected) {
+      bias_ = measured;
+      variance_ = gps_variance_;
+      rejected_in_row_ = 0;
+    }
+    return;
+  }
+
+  rejected_in_row_ = 0;
+  const double gain = variance_ / innovation_variance;
+  bias_ += gain * innovation;
+  variance_ *= 1 - gain;
+  ++used_;
+}
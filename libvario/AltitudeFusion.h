@@ -0,0 +1,122 @@
+#ifndef ALTITUDEFUSION_H
+#define ALTITUDEFUSION_H
+
+#include <cstddef>
+#include <cstdint>
+
+// One altitude from two sources with opposite strengths: the barometric
+// altitude (smooth, fast, but off by the QNH error and by whatever the
+// sensor drifts during a flight) and the GPS altitude (absolute, but noisy
+// and only once a second or so). The output is the baro altitude plus a
+// bias that a one-state Kalman filter learns from the GPS, so it keeps all
+// the baro's resolution and none of its offset.
+//
+// Comparing the two needs the baro altitude at the instant the GPS measured,
+// and the fixes are stamped on the GPS clock, not the sensor clock. The
+// clock offset is tracked the way NTP does it: each fix gives the GPS time
+// minus the sensor time it arrived at, which is the offset less a transport
+// delay, and the largest of those (the least delayed fix) is kept, relaxing
+// slowly to follow drift between the clocks. What remains is the receiver's
+// own latency, which shows up as the GPS altitude lagging the baro while
+// climbing or sinking: it is the regression slope of the GPS-minus-baro
+// residual on the vario, kept as running sums.
+//
+// UpdateBaro() runs at the sensor rate and only appends to a fixed ring of
+// recent altitudes when a history slot is due, so it is O(1) with no
+// allocation; a fix looks the ring up once.
+class AltitudeFusion {
+ public:
+  static constexpr std::size_t kHistory = 64;
+  static constexpr double kHistoryInterval = 0.05;   // s between history slots, 3.2 s in all
+  static constexpr double kMaxLatency = 2.0;         // s, receiver latency is clamped to this
+  static constexpr double kFixInterval = 1.0;        // s between fixes used for the bias
+  static constexpr double kClockDrift = 100e-6;      // s/s the offset may relax by, 100 ppm
+  static constexpr double kClockJump = 5.0;          // s of apparent delay that restarts the offset
+  static constexpr double kGate = 4.0;               // sigmas beyond which a fix is an outlier
+  static constexpr std::uint64_t kMaxRejected = 10;  // outliers in a row that restart the bias
+  static constexpr double kHighPassTimeConstant = 20.0;  // s, see UpdateLatency()
+  static constexpr double kMinVarioVariance = 0.1;       // (m/s)^2 needed to estimate the latency
+  static constexpr double kMinLatencyFixes = 60;         // Weight of fixes before it is trusted
+
+  /**
+   * bias_drift is how fast the baro error may wander, in m per sqrt(s);
+   * gps_sigma the GPS altitude noise in m; latency_time_constant how long
+   * in seconds the latency regression remembers.
+   */
+  explicit AltitudeFusion(double bias_drift = 0.05, double gps_sigma = 5.0,
+                          double latency_time_constant = 600.0);
+
+  void Reset();
+
+  /**
+   * Filtered baro altitude in m and vario in m/s, with the sensor timestamp
+   * in us.
+   */
+  void UpdateBaro(std::uint64_t timestamp, double altitude, double vario);
+
+  /**
+   * GPS altitude in m with the fix timestamp in us on the GPS clock, arriving
+   * now. Fixes without a vertical solution (NaN or exactly 0) are ignored.
+   */
+  void UpdateGps(std::uint64_t timestamp, double altitude);
+
+  // Whether a GPS fix has set the bias yet; before that Altitude() is the baro.
+  bool IsValid() const { return has_bias_; }
+
+  double Altitude() const { return baro_ + bias_; }  // m
+  double Bias() const { return bias_; }              // m added to the baro altitude
+  double BiasSigma() const;                          // m, standard deviation of Bias()
+
+  // GPS clock minus sensor clock in us, including the least transport delay.
+  std::int64_t ClockOffset() const { return offset_; }
+
+  // Receiver latency in s beyond ClockOffset(), 0 until it has been measured.
+  double Latency() const { return latency_; }
+
+  std::uint64_t FixesUsed() const { return used_; }
+  std::uint64_t FixesRejected() const { return rejected_; }
+
+ private:
+  struct Slot {
+    std::uint64_t timestamp;
+    double altitude;
+    double vario;
+  };
+
+  // Baro altitude and vario at a sensor time, interpolated between slots.
+  bool Lookup(double time, double& altitude, double& vario) const;
+  void UpdateLatency(double residual, double vario, double dt);
+
+  double bias_drift_;
+  double gps_variance_;
+  double latency_time_constant_;
+
+  Slot history_[kHistory];
+  std::size_t next_ = 0;
+  std::size_t count_ = 0;
+  std::uint64_t last_baro_ = 0;
+  double baro_ = 0;
+
+  bool has_offset_ = false;
+  std::int64_t offset_ = 0;
+  std::uint64_t last_arrival_ = 0;
+
+  // Running means of the lag-free residual r and the vario v, and the
+  // exponentially weighted moments of their high-passed parts.
+  double weight_ = 0;
+  double mean_r_ = 0;
+  double mean_v_ = 0;
+  double mean_rv_ = 0;
+  double mean_vv_ = 0;
+  double latency_ = 0;
+
+  bool has_bias_ = false;
+  double bias_ = 0;
+  double variance_ = 0;
+  std::uint64_t last_fix_ = 0;
+  std::uint64_t used_ = 0;
+  std::uint64_t rejected_ = 0;
+  std::uint64_t rejected_in_row_ = 0;
+};
+
+#endif // ALTITUDEFUSION_H
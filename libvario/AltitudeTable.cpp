@@ -0,0 +1,100 @@
+#include "AltitudeTable.h"
+#include <cmath>
+#include <vector>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr double kScaleHeight = 44330.0;   // m
+constexpr double kExponent = 0.19;
+
+// One entry per kStepHpa plus one, so the last interval interpolates
+// without a bounds check.
+constexpr std::size_t kEntries = static_cast<std::size_t>(
+    (AltitudeTable::kMaxPressureHpa - AltitudeTable::kMinPressureHpa) / AltitudeTable::kStepHpa) + 2;
+
+}  // namespace
+
+AltitudeTable::AltitudeTable(const double qnh)
+  :table_(Table())
+{
+  SetQnh(qnh);
+}
+
+void AltitudeTable::SetQnh(const double qnh)
+{
+  qnh_ = qnh > 0 ? qnh : kStandardQnh;
+  scale_ = kScaleHeight * std::pow(qnh_, -kExponent);
+}
+
+const double* AltitudeTable::Table()
+{
+  static const std::vector<double> table = [] {
+    std::vector<double> t(kEntries);
+    for (std::size_t i = 0; i < kEntries; ++i)
+      t[i] = std::pow(kMinPressureHpa + i * kStepHpa, kExponent);
+    return t;
+  }();
+  return table.data();
+}
+
+double AltitudeTable::Exact(const double pressure_hpa, const double qnh)
+{
+  return kScaleHeight * (1.0 - std::pow(pressure_hpa / qnh, kExponent));
+}
+
+double AltitudeTable::Altitude(const double pressure_hpa) const
+{
+  // Also rejects NaN
+  if (!(pressure_hpa >= kMinPressureHpa && pressure_hpa <= kMaxPressureHpa))
+    return Exact(pressure_hpa, qnh_);
+
+  const double x = (pressure_hpa - kMinPressureHpa) * (1.0 / kStepHpa);
+  const std::size_t i = static_cast<std::size_t>(x);
+  const double f = x - i;
+  const double power = table_[i] + f * (table_[i + 1] - table_[i]);
+  return kScaleHeight - scale_ * power;
+}
+
+void AltitudeTable::Altitude(const double* pressure_hpa, const std::size_t n, double* altitude) const
+{
+  std::size_t k = 0;
+
+#if defined(__AVX2__) && defined(__FMA__)
+  const __m256d lo = _mm256_set1_pd(kMinPressureHpa);
+  const __m256d hi = _mm256_set1_pd(kMaxPressureHpa);
+  const __m256d inv_step = _mm256_set1_pd(1.0 / kStepHpa);
+  const __m256d height = _mm256_set1_pd(kScaleHeight);
+  const __m256d scale = _mm256_set1_pd(scale_);
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+
+  for (; k + 4 <= n; k += 4) {
+    const __m256d p = _mm256_loadu_pd(pressure_hpa + k);
+    const __m256d inside = _mm256_and_pd(_mm256_cmp_pd(p, lo, _CMP_GE_OQ),
+                                         _mm256_cmp_pd(p, hi, _CMP_LE_OQ));
+    if (_mm256_movemask_pd(inside) != 0xF) {
+      // Rare: leave the group to the scalar path
+      for (std::size_t j = k; j < k + 4; ++j)
+        altitude[j] = Altitude(pressure_hpa[j]);
+      continue;
+    }
+
+    const __m256d x = _mm256_mul_pd(_mm256_sub_pd(p, lo), inv_step);
+    const __m256d whole = _mm256_round_pd(x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+    const __m128i i = _mm256_cvttpd_epi32(whole);
+    // The masked form with an explicit zero source: the plain gather passes
+    // an undefined register that GCC 12 flags as maybe uninitialized
+    const __m256d a = _mm256_mask_i32gather_pd(zero, table_, i, all, 8);
+    const __m256d b = _mm256_mask_i32gather_pd(zero, table_ + 1, i, all, 8);
+    const __m256d power = _mm256_fmadd_pd(_mm256_sub_pd(x, whole), _mm256_sub_pd(b, a), a);
+    _mm256_storeu_pd(altitude + k, _mm256_fnmadd_pd(scale, power, height));
+  }
+#endif
+
+  for (; k < n; ++k)
+    altitude[k] = Altitude(pressure_hpa[k]);
+}
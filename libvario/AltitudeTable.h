@@ -0,0 +1,52 @@
+#ifndef ALTITUDETABLE_H
+#define ALTITUDETABLE_H
+
+#include <cstddef>
+
+// Barometric altitude from pressure without a std::pow per sample.
+//
+// The standard atmosphere formula h = 44330 * (1 - (p / qnh)^0.19) splits
+// into 44330 - 44330 * qnh^-0.19 * p^0.19, so only p^0.19 needs tabulating
+// and the QNH is a plain scale factor. The table covers kMinPressureHpa to
+// kMaxPressureHpa (about 13.5 km down to 700 m below sea level) in kStepHpa
+// steps and is linearly interpolated. The interpolation error of a concave
+// function is at most step^2 / 8 times its second derivative, which is
+// largest at the low-pressure end: under 7 mm there, under 1 mm below
+// 4000 m. Pressures outside the table fall back to the exact formula.
+//
+// The table is shared by all instances and built on first use.
+class AltitudeTable {
+ public:
+  static constexpr double kStandardQnh = 1013.25;    // hPa
+  static constexpr double kMinPressureHpa = 150.0;
+  static constexpr double kMaxPressureHpa = 1100.0;
+  static constexpr double kStepHpa = 0.5;
+
+  explicit AltitudeTable(double qnh = kStandardQnh);
+
+  // Sea level pressure the altitudes refer to, in hPa.
+  void SetQnh(double qnh);
+  double Qnh() const { return qnh_; }
+
+  /** Altitude in m for a pressure in hPa. */
+  double Altitude(double pressure_hpa) const;
+
+  /**
+   * Converts n pressures in hPa to altitudes in m. in and out may be the same
+   * array. Uses AVX2 gathers when the build targets it (-mavx2 -mfma, or
+   * -march=haswell and later), a scalar loop otherwise.
+   */
+  void Altitude(const double* pressure_hpa, std::size_t n, double* altitude) const;
+
+  // The formula the table approximates, for reference and out-of-range input.
+  static double Exact(double pressure_hpa, double qnh = kStandardQnh);
+
+ private:
+  static const double* Table();
+
+  const double* table_;   // p^0.19 at every kStepHpa
+  double qnh_;
+  double scale_;    // 44330 * qnh^-0.19
+};
+
+#endif // ALTITUDETABLE_H
@@ -0,0 +1,167 @@
+#include "AttitudeEstimator.h"
+#include <cmath>
+#include <limits>
+
+namespace {
+
+constexpr double kGravity = 9.80665;
+constexpr double kRadToDeg = 57.29577951308232;
+
+void Normalize(Quaternion& q)
+{
+  const double norm = std::sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+  q.w /= norm;
+  q.x /= norm;
+  q.y /= norm;
+  q.z /= norm;
+}
+
+}  // namespace
+
+AttitudeEstimator::AttitudeEstimator(const double kp, const double ki)
+  :kp_(kp),
+   ki_(ki)
+{
+}
+
+void AttitudeEstimator::Reset()
+{
+  q_ = Quaternion();
+  integral_x_ = integral_y_ = integral_z_ = 0;
+  initialized_ = false;
+}
+
+void AttitudeEstimator::Initialize(double ax, double ay, double az,
+                                   const double mx, const double my, const double mz)
+{
+  // Shortest rotation taking the measured up direction onto the earth z axis
+  const double norm = std::sqrt(ax * ax + ay * ay + az * az);
+  ax /= norm;
+  ay /= norm;
+  az /= norm;
+  if (az < -0.999999) {
+    q_ = {0, 1, 0, 0};  // Upside down: half a turn about x
+  } else {
+    q_ = {1 + az, ay, -ax, 0};
+    Normalize(q_);
+  }
+
+  // Then turn about the vertical until the horizontal field points north
+  if (mx != 0 || my != 0 || mz != 0) {
+    const Quaternion q = q_;
+    const double hx = (1 - 2 * (q.y * q.y + q.z * q.z)) * mx + 2 * (q.x * q.y - q.w * q.z) * my
+                      + 2 * (q.x * q.z + q.w * q.y) * mz;
+    const double hy = 2 * (q.x * q.y + q.w * q.z) * mx + (1 - 2 * (q.x * q.x + q.z * q.z)) * my
+                      + 2 * (q.y * q.z - q.w * q.x) * mz;
+    const double half = -0.5 * std::atan2(hy, hx);
+    const double c = std::cos(half);
+    const double s = std::sin(half);
+    q_ = {c * q.w - s * q.z, c * q.x - s * q.y, c * q.y + s * q.x, c * q.z + s * q.w};
+  }
+  initialized_ = true;
+}
+
+void AttitudeEstimator::Update(double gx, double gy, double gz,
+                               double ax, double ay, double az,
+                               double mx, double my, double mz, const double dt)
+{
+  const double accel = std::sqrt(ax * ax + ay * ay + az * az);
+  if (!initialized_) {
+    if (accel > 0)
+      Initialize(ax, ay, az, mx, my, mz);
+    return;
+  }
+
+  const double q0 = q_.w, q1 = q_.x, q2 = q_.y, q3 = q_.z;
+
+  // Only trust the accelerometer as a gravity reference while it measures
+  // about 1 g; in a turn or a gust it mostly sees the manoeuvre.
+  if (accel > 0 && std::fabs(accel - kGravity) < kAccelGate * kGravity) {
+    ax /= accel;
+    ay /= accel;
+    az /= accel;
+
+    // Up as the current estimate sees it, in device coordinates
+    const double vx = 2 * (q1 * q3 - q0 * q2);
+    const double vy = 2 * (q0 * q1 + q2 * q3);
+    const double vz = q0 * q0 - q1 * q1 - q2 * q2 + q3 * q3;
+
+    double ex = ay * vz - az * vy;
+    double ey = az * vx - ax * vz;
+    double ez = ax * vy - ay * vx;
+
+    const double field = std::sqrt(mx * mx + my * my + mz * mz);
+    if (field > 0) {
+      mx /= field;
+      my /= field;
+      mz /= field;
+
+      // Field in the earth frame, reduced to its north and vertical parts,
+      // and back in device coordinates: where north should be.
+      const double hx = 2 * (mx * (0.5 - q2 * q2 - q3 * q3) + my * (q1 * q2 - q0 * q3) + mz * (q1 * q3 + q0 * q2));
+      const double hy = 2 * (mx * (q1 * q2 + q0 * q3) + my * (0.5 - q1 * q1 - q3 * q3) + mz * (q2 * q3 - q0 * q1));
+      const double bx = std::sqrt(hx * hx + hy * hy);
+      const double bz = 2 * (mx * (q1 * q3 - q0 * q2) + my * (q2 * q3 + q0 * q1) + mz * (0.5 - q1 * q1 - q2 * q2));
+      const double wx = 2 * (bx * (0.5 - q2 * q2 - q3 * q3) + bz * (q1 * q3 - q0 * q2));
+      const double wy = 2 * (bx * (q1 * q2 - q0 * q3) + bz * (q0 * q1 + q2 * q3));
+      const double wz = 2 * (bx * (q0 * q2 + q1 * q3) + bz * (0.5 - q1 * q1 - q2 * q2));
+
+      ex += my * wz - mz * wy;
+      ey += mz * wx - mx * wz;
+      ez += mx * wy - my * wx;
+    }
+
+    if (ki_ > 0) {
+      integral_x_ += ki_ * ex * dt;
+      integral_y_ += ki_ * ey * dt;
+      integral_z_ += ki_ * ez * dt;
+    }
+    gx += kp_ * ex;
+    gy += kp_ * ey;
+    gz += kp_ * ez;
+  }
+  gx += integral_x_;
+  gy += integral_y_;
+  gz += integral_z_;
+
+  // q' = q + 0.5 * q * (0, g) * dt
+  const double h = 0.5 * dt;
+  q_.w = q0 + (-q1 * gx - q2 * gy - q3 * gz) * h;
+  q_.x = q1 + (q0 * gx + q2 * gz - q3 * gy) * h;
+  q_.y = q2 + (q0 * gy - q1 * gz + q3 * gx) * h;
+  q_.z = q3 + (q0 * gz + q1 * gy - q2 * gx) * h;
+  Normalize(q_);
+}
+
+void AttitudeEstimator::Up(double& x, double& y, double& z) const
+{
+  x = 2 * (q_.x * q_.z - q_.w * q_.y);
+  y = 2 * (q_.y * q_.z + q_.w * q_.x);
+  z = q_.w * q_.w - q_.x * q_.x - q_.y * q_.y + q_.z * q_.z;
+}
+
+double AttitudeEstimator::Vertical(const double x, const double y, const double z) const
+{
+  double ux, uy, uz;
+  Up(ux, uy, uz);
+  return x * ux + y * uy + z * uz;
+}
+
+double AttitudeEstimator::Heading() const
+{
+  // Earth-frame north and west components of the device vector (0, 1, -1)
+  const double north = 2 * (q_.x * q_.y - q_.w * q_.z) - 2 * (q_.x * q_.z + q_.w * q_.y);
+  const double west = 1 - 2 * (q_.x * q_.x + q_.z * q_.z) - 2 * (q_.y * q_.z - q_.w * q_.x);
+  if (north * north + west * west < 1e-6)
+    return std::numeric_limits<double>::quiet_NaN();
+
+  double heading = std::atan2(-west, north) * kRadToDeg;
+  if (heading < 0)
+    heading += 360;
+  return heading < 360 ? heading : 0;
+}
+
+double AttitudeEstimator::Yaw() const
+{
+  return std::atan2(2 * (q_.w * q_.z + q_.x * q_.y), 1 - 2 * (q_.y * q_.y + q_.z * q_.z)) * kRadToDeg;
+}
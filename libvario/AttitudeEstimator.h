@@ -0,0 +1,98 @@
+#ifndef ATTITUDEESTIMATOR_H
+#define ATTITUDEESTIMATOR_H
+
+// Rotation from the device frame to the earth frame (x north, y west, z up).
+struct Quaternion {
+  double w = 1;
+  double x = 0;
+  double y = 0;
+  double z = 0;
+};
+
+// Mahony's complementary filter on the rotation group: integrates the gyro
+// and pulls the estimate towards the gravity direction the accelerometer
+// sees (and the horizontal magnetic field, when a magnetometer is present)
+// through a PI feedback. The integral term learns the gyro bias, so a cheap
+// phone gyro does not make the attitude drift. One update is about 50
+// floating point operations and one square root per sensor, cheap enough to
+// run for every sample at the IMU's native rate.
+//
+// Without a gyro it still works, with zero rates: the accelerometer feedback
+// then acts as a first-order low-pass of the gravity direction with time
+// constant 1 / kp.
+//
+// Vectors are in the Qt sensor frame (x right, y to the top of the screen,
+// z out of the screen); the accelerometer in m/s^2, the gyro in rad/s and
+// the magnetometer in any unit.
+class AttitudeEstimator {
+ public:
+  /**
+   * kp is the proportional gain in rad/s per unit of attitude error, ki the
+   * integral gain that tracks the gyro bias (0 disables it).
+   */
+  explicit AttitudeEstimator(double kp = 1.0, double ki = 0.05);
+
+  void Reset();
+
+  /**
+   * Advances the attitude by dt seconds of rotation at the gyro rates and
+   * corrects it towards the measured accelerometer and magnetometer
+   * directions. Pass a zero magnetometer vector when there is none. The
+   * first call with a usable accelerometer vector initializes the attitude
+   * from it directly, so there is no start-up transient.
+   */
+  void Update(double gx, double gy, double gz,
+              double ax, double ay, double az,
+              double mx, double my, double mz, double dt);
+
+  void Update(double gx, double gy, double gz,
+              double ax, double ay, double az, double dt) {
+    Update(gx, gy, gz, ax, ay, az, 0, 0, 0, dt);
+  }
+
+  bool IsInitialized() const { return initialized_; }
+  const Quaternion& Attitude() const { return q_; }
+
+  // Unit vector pointing up, in device coordinates.
+  void Up(double& x, double& y, double& z) const;
+
+  // Component of a device-frame vector along the earth vertical.
+  double Vertical(double x, double y, double z) const;
+
+  // Rotation about the vertical in degrees, counterclockwise from magnetic
+  // north seen from above; only meaningful with a magnetometer.
+  double Yaw() const;
+
+  /**
+   * Compass heading of the direction the device faces, in degrees clockwise
+   * from magnetic north (0-360), or NaN when that direction is vertical.
+   * "Facing" is the horizontal part of the top edge plus the back of the
+   * device, so it stays defined whether the phone lies flat (top edge
+   * forward) or stands upright in a cockpit mount (back forward). Tilt is
+   * compensated through the full attitude; only meaningful with a
+   * magnetometer.
+   */
+  double Heading() const;
+
+  // Learned gyro bias in rad/s, device frame.
+  double BiasX() const { return -integral_x_; }
+  double BiasY() const { return -integral_y_; }
+  double BiasZ() const { return -integral_z_; }
+
+  // Accelerometer readings whose magnitude differs from gravity by more than
+  // this fraction (turns, gusts) are not used for the correction.
+  static constexpr double kAccelGate = 0.15;
+
+ private:
+  void Initialize(double ax, double ay, double az, double mx, double my, double mz);
+
+  double kp_;
+  double ki_;
+  Quaternion q_;
+  double integral_x_ = 0;
+  double integral_y_ = 0;
+  double integral_z_ = 0;
+  bool initialized_ = false;
+};
+
+#endif // ATTITUDEESTIMATOR_H
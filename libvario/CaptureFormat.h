@@ -0,0 +1,65 @@
+#ifndef CAPTUREFORMAT_H
+#define CAPTUREFORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include "SensorSamples.h"
+
+// Layout of a raw sensor capture file (.vcap).
+//
+// The file starts with a FileHeader, followed by records. Each record is one
+// RecordType byte followed by the sample struct from SensorSamples.h copied
+// as is, so the record size follows from the type. Values are in the byte
+// order of the device that wrote them; byte_order lets a reader detect a
+// file from a machine of the other endianness. A record cut short at the
+// end of the file, left by a killed writer, is simply ignored.
+//
+// Version 2 appended the attitude quaternion to AccelSample, version 3 the
+// magnetic heading; older files are still read, with an identity attitude
+// and no heading.
+namespace capture {
+
+constexpr char kMagic[8] = {'V', 'A', 'R', 'I', 'O', 'C', 'A', 'P'};
+constexpr std::uint32_t kVersion = 3;
+constexpr std::uint32_t kOldestVersion = 1;
+constexpr std::uint32_t kByteOrderMark = 0x01020304;
+
+struct FileHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t byte_order;
+};
+
+enum RecordType : std::uint8_t {
+  kPressure = 1,
+  kAccel = 2,
+  kTemperature = 3,
+  kGps = 4,
+};
+
+template<typename T> struct RecordTraits;
+template<> struct RecordTraits<PressureSample> { static constexpr RecordType kType = kPressure; };
+template<> struct RecordTraits<AccelSample> { static constexpr RecordType kType = kAccel; };
+template<> struct RecordTraits<TemperatureSample> { static constexpr RecordType kType = kTemperature; };
+template<> struct RecordTraits<GpsFix> { static constexpr RecordType kType = kGps; };
+
+// Payload size of a record type in a file of the given version, 0 for an
+// unknown type.
+inline std::size_t RecordSize(const std::uint8_t type, const std::uint32_t version = kVersion) {
+  switch (type) {
+    case kPressure: return sizeof(PressureSample);
+    case kAccel:
+      if (version < 2)
+        return offsetof(AccelSample, qw);
+      if (version < 3)
+        return offsetof(AccelSample, heading);
+      return sizeof(AccelSample);
+    case kTemperature: return sizeof(TemperatureSample);
+    case kGps: return sizeof(GpsFix);
+    default: return 0;
+  }
+}
+
+}  // namespace capture
+
+#endif // CAPTUREFORMAT_H
@@ -0,0 +1,71 @@
+#include "CaptureReader.h"
+#include <cstddef>
+#include <cstring>
+#include <limits>
+
+CaptureReader::~CaptureReader()
+{
+  Close();
+}
+
+bool CaptureReader::Open(const std::string& path)
+{
+  Close();
+
+  file_ = std::fopen(path.c_str(), "rb");
+  if (!file_)
+    return false;
+
+  capture::FileHeader header;
+  if (std::fread(&header, sizeof(header), 1, file_) != 1 ||
+      std::memcmp(header.magic, capture::kMagic, sizeof(header.magic)) != 0 ||
+      header.version < capture::kOldestVersion || header.version > capture::kVersion ||
+      header.byte_order != capture::kByteOrderMark) {
+    Close();
+    return false;
+  }
+
+  version_ = header.version;
+  records_ = 0;
+  corrupt_ = false;
+  return true;
+}
+
+void CaptureReader::Close()
+{
+  if (file_) {
+    std::fclose(file_);
+    file_ = nullptr;
+  }
+}
+
+bool CaptureReader::Next(CaptureRecord& record)
+{
+  if (!file_)
+    return false;
+
+  const int type = std::fgetc(file_);
+  if (type == EOF)
+    return false;
+
+  const std::size_t size = capture::RecordSize(static_cast<std::uint8_t>(type), version_);
+  if (size == 0) {
+    corrupt_ = true;
+    return false;
+  }
+
+  // All members of the union start at its address, so any of them will do.
+  record.type = static_cast<capture::RecordType>(type);
+  if (std::fread(&record.pressure, 1, size, file_) != size)
+    return false;
+  if (record.type == capture::kAccel && size < sizeof(AccelSample)) {
+    if (size <= offsetof(AccelSample, qw)) {
+      record.accel.qw = 1;  // Written before the attitude was recorded
+      record.accel.qx = record.accel.qy = record.accel.qz = 0;
+    }
+    record.accel.heading = std::numeric_limits<double>::quiet_NaN();
+  }
+
+  ++records_;
+  return true;
+}
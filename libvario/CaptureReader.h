@@ -0,0 +1,54 @@
+#ifndef CAPTUREREADER_H
+#define CAPTUREREADER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include "CaptureFormat.h"
+
+// One record of a capture file; type tells which member is valid.
+struct CaptureRecord {
+  capture::RecordType type;
+  union {
+    PressureSample pressure;
+    AccelSample accel;
+    TemperatureSample temperature;
+    GpsFix gps;
+  };
+};
+
+// Sequential reader for files written by CaptureWriter.
+class CaptureReader {
+ public:
+  CaptureReader() = default;
+  ~CaptureReader();
+
+  CaptureReader(const CaptureReader&) = delete;
+  CaptureReader& operator=(const CaptureReader&) = delete;
+
+  /**
+   * Opens a capture file and checks its header. Fails for a missing file,
+   * another format or an unsupported version, or a file written with the
+   * other byte order.
+   */
+  bool Open(const std::string& path);
+  void Close();
+  bool IsOpen() const { return file_ != nullptr; }
+
+  /**
+   * Reads the next record. Returns false at the end of the file, on a
+   * record cut short by a killed writer, or on an unknown record type.
+   */
+  bool Next(CaptureRecord& record);
+
+  std::uint64_t Records() const { return records_; }  // Records read so far
+  bool Corrupt() const { return corrupt_; }           // Stopped on an unknown record type
+
+ private:
+  std::FILE* file_ = nullptr;
+  std::uint32_t version_ = 0;
+  std::uint64_t records_ = 0;
+  bool corrupt_ = false;
+};
+
+#endif // CAPTUREREADER_H
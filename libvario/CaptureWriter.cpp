@@ -0,0 +1,117 @@
+#include "CaptureWriter.h"
+
+CaptureWriter::CaptureWriter(const std::size_t batch_bytes, const std::size_t batch_count,
+                             const std::chrono::milliseconds flush_interval)
+  :batch_bytes_(batch_bytes),
+   batch_count_(batch_count < 2 ? 2 : batch_count),
+   flush_interval_(flush_interval),
+   buffers_(new char[batch_bytes_ * batch_count_]),
+   sizes_(new std::size_t[batch_count_])
+{
+  // Touch the buffers now so the first pass through them does not page fault
+  // on the producer thread.
+  std::memset(buffers_.get(), 0, batch_bytes_ * batch_count_);
+}
+
+CaptureWriter::~CaptureWriter()
+{
+  Close();
+}
+
+bool CaptureWriter::Open(const std::string& path)
+{
+  Close();
+
+  file_ = std::fopen(path.c_str(), "wb");
+  if (!file_)
+    return false;
+
+  capture::FileHeader header;
+  std::memcpy(header.magic, capture::kMagic, sizeof(header.magic));
+  header.version = capture::kVersion;
+  header.byte_order = capture::kByteOrderMark;
+  if (std::fwrite(&header, sizeof(header), 1, file_) != 1 || std::fflush(file_) != 0) {
+    std::fclose(file_);
+    file_ = nullptr;
+    return false;
+  }
+
+  submitted_.store(0);
+  written_.store(0);
+  filling_ = false;
+  fill_ = 0;
+  records_ = 0;
+  dropped_ = 0;
+  bytes_written_.store(sizeof(header));
+  failed_.store(false);
+  stop_ = false;
+  writer_ = std::thread(&CaptureWriter::WriterLoop, this);
+  return true;
+}
+
+void CaptureWriter::Close()
+{
+  if (!file_)
+    return;
+
+  Submit();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_one();
+  writer_.join();
+
+  std::fclose(file_);
+  file_ = nullptr;
+}
+
+void CaptureWriter::FlushIfDue()
+{
+  if (filling_ && fill_ > 0 &&
+      std::chrono::steady_clock::now() - batch_started_ >= flush_interval_)
+    Submit();
+}
+
+void CaptureWriter::Submit()
+{
+  if (!filling_ || fill_ == 0)
+    return;
+
+  const std::uint64_t batch = submitted_.load(std::memory_order_relaxed);
+  sizes_[batch % batch_count_] = fill_;
+  filling_ = false;
+  fill_ = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    submitted_.store(batch + 1, std::memory_order_release);
+  }
+  wake_.notify_one();
+}
+
+void CaptureWriter::WriterLoop()
+{
+  for (;;) {
+    std::uint64_t batch;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [this] {
+        return stop_ || written_.load(std::memory_order_relaxed) < submitted_.load(std::memory_order_relaxed);
+      });
+      batch = written_.load(std::memory_order_relaxed);
+      if (batch == submitted_.load(std::memory_order_acquire))
+        return;  // Stopping and everything is written
+    }
+
+    // The batch belongs to this thread until written_ moves past it.
+    const std::size_t slot = batch % batch_count_;
+    const std::size_t size = sizes_[slot];
+    if (std::fwrite(buffers_.get() + slot * batch_bytes_, 1, size, file_) == size &&
+        std::fflush(file_) == 0)
+      bytes_written_.fetch_add(size, std::memory_order_relaxed);
+    else
+      failed_.store(true, std::memory_order_relaxed);
+
+    written_.store(batch + 1, std::memory_order_release);
+  }
+}
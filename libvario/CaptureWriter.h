@@ -0,0 +1,129 @@
+#ifndef CAPTUREWRITER_H
+#define CAPTUREWRITER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "CaptureFormat.h"
+
+// Appends raw sensor samples to a capture file (see CaptureFormat.h) without
+// doing any I/O on the calling thread.
+//
+// Records are copied into one of a fixed set of batch buffers allocated up
+// front. A full batch, or one older than the flush interval, is handed to a
+// writer thread that writes and flushes it. The batches are used strictly in
+// turn, so handing one over is a single counter update; the producer only
+// touches the mutex to wake the writer once per batch. If the writer falls so
+// far behind that every batch is still queued, samples are dropped and
+// counted rather than blocking the producer.
+//
+// Every batch is flushed to the OS as soon as it is written, so killing the
+// app loses the batch being filled and the batches queued but not yet
+// written: normally just the one being filled, since the writer keeps up,
+// and never more than all of them.
+//
+// Write() and FlushIfDue() must be called from a single producer thread.
+class CaptureWriter {
+ public:
+  CaptureWriter(std::size_t batch_bytes = 64 * 1024, std::size_t batch_count = 8,
+                std::chrono::milliseconds flush_interval = std::chrono::milliseconds(1000));
+  ~CaptureWriter();
+
+  CaptureWriter(const CaptureWriter&) = delete;
+  CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+  /**
+   * Creates the file, writes the header and starts the writer thread.
+   * Returns false if the file cannot be created.
+   */
+  bool Open(const std::string& path);
+
+  // Hands over the partial batch, waits for the writer and closes the file.
+  void Close();
+
+  bool IsOpen() const { return file_ != nullptr; }
+
+  template<typename T>
+  void Write(const T& sample) {
+    constexpr std::size_t kRecordBytes = 1 + sizeof(T);
+    if (!file_)
+      return;
+    if (fill_ + kRecordBytes > batch_bytes_)
+      Submit();
+    if (!AcquireBatch()) {
+      ++dropped_;
+      return;
+    }
+    char* record = Current() + fill_;
+    record[0] = static_cast<char>(capture::RecordTraits<T>::kType);
+    std::memcpy(record + 1, &sample, sizeof(T));
+    fill_ += kRecordBytes;
+    ++records_;
+  }
+
+  /**
+   * Hands over the current batch if it was started more than the flush
+   * interval ago. Call it regularly, e.g. after each drain of the sensor bus,
+   * so a slow stream still reaches the file in bounded time.
+   */
+  void FlushIfDue();
+
+  std::uint64_t Records() const { return records_; }   // Samples accepted
+  std::uint64_t Dropped() const { return dropped_; }   // Samples lost to a full queue
+  std::uint64_t BytesWritten() const { return bytes_written_.load(std::memory_order_relaxed); }
+  bool Failed() const { return failed_.load(std::memory_order_relaxed); }  // A write error occurred
+
+ private:
+  char* Current() { return buffers_.get() + (submitted_.load(std::memory_order_relaxed) % batch_count_) * batch_bytes_; }
+
+  // Makes sure a batch is being filled; false if all of them are queued.
+  bool AcquireBatch() {
+    if (filling_)
+      return true;
+    if (submitted_.load(std::memory_order_relaxed) - written_.load(std::memory_order_acquire) >= batch_count_)
+      return false;
+    filling_ = true;
+    fill_ = 0;
+    batch_started_ = std::chrono::steady_clock::now();
+    return true;
+  }
+
+  void Submit();
+  void WriterLoop();
+
+  const std::size_t batch_bytes_;
+  const std::size_t batch_count_;
+  const std::chrono::milliseconds flush_interval_;
+  std::unique_ptr<char[]> buffers_;   // batch_count_ batches of batch_bytes_
+  std::unique_ptr<std::size_t[]> sizes_;
+
+  std::FILE* file_ = nullptr;
+  std::thread writer_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stop_ = false;
+
+  // Batches handed over by the producer and batches written so far; batch
+  // n lives in slot n % batch_count_.
+  std::atomic<std::uint64_t> submitted_{0};
+  std::atomic<std::uint64_t> written_{0};
+
+  // Producer state.
+  bool filling_ = false;
+  std::size_t fill_ = 0;
+  std::chrono::steady_clock::time_point batch_started_;
+  std::uint64_t records_ = 0;
+  std::uint64_t dropped_ = 0;
+
+  std::atomic<std::uint64_t> bytes_written_{0};
+  std::atomic<bool> failed_{false};
+};
+
+#endif // CAPTUREWRITER_H
@@ -0,0 +1,96 @@
+#include "Decimator.h"
+#include <algorithm>
+#include <assert.h>
+#include <cmath>
+
+Decimator::Decimator(const std::size_t ratio, const std::size_t taps)
+  :Decimator(ratio, DesignLowPass(taps, 0.8 * 0.5 / std::max<std::size_t>(ratio, 1)))
+{
+}
+
+Decimator::Decimator(const std::size_t ratio, std::vector<double> taps)
+  :ratio_(std::max<std::size_t>(ratio, 1)),
+   taps_(taps.rbegin(), taps.rend()),
+   history_(2 * taps.size())
+{
+  assert(!taps_.empty());
+  Reset();
+}
+
+std::vector<double> Decimator::DesignLowPass(const std::size_t taps, const double cutoff)
+{
+  assert(taps > 0 && cutoff > 0 && cutoff < 0.5);
+  const double pi = 3.14159265358979323846;
+  const double center = (taps - 1) * 0.5;
+
+  std::vector<double> h(taps);
+  double sum = 0;
+  for (std::size_t k = 0; k < taps; ++k) {
+    const double m = k - center;
+    const double sinc = m == 0 ? 2 * cutoff : std::sin(2 * pi * cutoff * m) / (pi * m);
+    const double window = taps == 1 ? 1.0
+        : 0.42 - 0.5 * std::cos(2 * pi * k / (taps - 1)) + 0.08 * std::cos(4 * pi * k / (taps - 1));
+    h[k] = sinc * window;
+    sum += h[k];
+  }
+  for (double& c : h)
+    c /= sum;
+  return h;
+}
+
+void Decimator::Reset()
+{
+  pos_ = 0;
+  phase_ = 0;
+  primed_ = false;
+  output_ = 0;
+}
+
+double Decimator::Filter() const
+{
+  // Oldest sample at pos_ + 1, newest at pos_ + n.
+  const std::size_t n = taps_.size();
+  const double* x = history_.data() + pos_ + 1;
+  const double* b = taps_.data();
+
+  double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  std::size_t k = 0;
+  for (; k + 4 <= n; k += 4) {
+    s0 += b[k] * x[k];
+    s1 += b[k + 1] * x[k + 1];
+    s2 += b[k + 2] * x[k + 2];
+    s3 += b[k + 3] * x[k + 3];
+  }
+  for (; k < n; ++k)
+    s0 += b[k] * x[k];
+  return (s0 + s1) + (s2 + s3);
+}
+
+bool Decimator::Add(const double x)
+{
+  const std::size_t n = taps_.size();
+  if (!primed_) {
+    std::fill(history_.begin(), history_.end(), x);
+    primed_ = true;
+  }
+
+  pos_ = pos_ + 1 == n ? 0 : pos_ + 1;
+  history_[pos_] = x;
+  history_[pos_ + n] = x;
+
+  if (++phase_ < ratio_)
+    return false;
+  phase_ = 0;
+  output_ = Filter();
+  return true;
+}
+
+std::size_t Decimator::Process(const double* in, const std::size_t n, double* out)
+{
+  std::size_t count = 0;
+  for (std::size_t i = 0; i < n; ++i) {
+    if (Add(in[i]))
+      out[count++] = output_;
+  }
+  return count;
+}
@@ -0,0 +1,70 @@
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+#include <cstddef>
+#include <vector>
+
+// FIR low-pass filter and downsampler for oversampled sensor input, e.g. a
+// barometer read at 100-200 Hz feeding filters that only need 25-50 Hz.
+// Averaging the extra samples lowers the noise floor by up to sqrt(ratio)
+// without the lag a heavier Kalman setting would add; the price is the
+// FIR's constant group delay of (taps - 1) / 2 input samples.
+//
+// Only every ratio-th output is computed, which costs the same taps / ratio
+// multiply-adds per input sample as a polyphase implementation. The history
+// is kept twice in a row, so the newest taps samples are always contiguous
+// and the dot product runs without wrap-around, in independent partial sums
+// the compiler turns into SIMD code.
+class Decimator {
+ public:
+  /**
+   * Decimates by ratio through a windowed-sinc low-pass of the given number
+   * of taps, cut off at 80% of the output Nyquist frequency.
+   */
+  Decimator(std::size_t ratio, std::size_t taps);
+
+  // Decimates by ratio through the given FIR coefficients, oldest tap last.
+  Decimator(std::size_t ratio, std::vector<double> taps);
+
+  /**
+   * Blackman-windowed sinc low-pass with cutoff in cycles per input sample
+   * (0 < cutoff < 0.5), normalized to a DC gain of exactly 1 so a constant
+   * pressure passes unchanged.
+   */
+  static std::vector<double> DesignLowPass(std::size_t taps, double cutoff);
+
+  // Forgets the history; the next sample primes it.
+  void Reset();
+
+  /**
+   * Adds an input sample. Returns true when it completes a group of ratio
+   * samples, with the new output available from Output(). The first sample
+   * fills the whole history, so there is no start-up transient.
+   */
+  bool Add(double x);
+
+  double Output() const { return output_; }
+
+  /**
+   * Filters n input samples and writes the outputs to out, which must hold
+   * n / ratio + 1 entries. Returns the number of outputs written.
+   */
+  std::size_t Process(const double* in, std::size_t n, double* out);
+
+  std::size_t Ratio() const { return ratio_; }
+  std::size_t Taps() const { return taps_.size(); }
+  double GroupDelay() const { return (taps_.size() - 1) * 0.5; }  // Input samples
+
+ private:
+  double Filter() const;
+
+  std::size_t ratio_;
+  std::vector<double> taps_;      // Reversed: taps_[0] weighs the oldest sample
+  std::vector<double> history_;   // Two copies of the last taps_.size() samples
+  std::size_t pos_ = 0;
+  std::size_t phase_ = 0;
+  bool primed_ = false;
+  double output_ = 0;
+};
+
+#endif // DECIMATOR_H
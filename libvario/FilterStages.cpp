@@ -0,0 +1,249 @@
+#include "FilterStages.h"
+#include <algorithm>
+#include <assert.h>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+namespace {
+
+std::size_t ClampWindow(const std::size_t window)
+{
+  assert(window >= 1 && window <= FilterStage::kMaxWindow);
+  return std::min(std::max<std::size_t>(window, 1), FilterStage::kMaxWindow);
+}
+
+}  // namespace
+
+RunningMean::RunningMean(const std::size_t window)
+  :window_(ClampWindow(window))
+{
+  Reset();
+}
+
+void RunningMean::Reset()
+{
+  next_ = 0;
+  count_ = 0;
+  sum_ = 0;
+}
+
+double RunningMean::Process(const double x)
+{
+  if (count_ < window_) {
+    ++count_;
+  } else {
+    sum_ -= buffer_[next_];
+  }
+  buffer_[next_] = x;
+  sum_ += x;
+
+  if (++next_ == window_) {
+    next_ = 0;
+    if (count_ == window_) {
+      sum_ = 0;
+      for (std::size_t i = 0; i < window_; ++i)
+        sum_ += buffer_[i];
+    }
+  }
+  return sum_ / count_;
+}
+
+std::string RunningMean::Name() const
+{
+  return "mean(" + std::to_string(window_) + ")";
+}
+
+RunningMedian::RunningMedian(const std::size_t window)
+  :window_(ClampWindow(window))
+{
+  Reset();
+}
+
+void RunningMedian::Reset()
+{
+  next_ = 0;
+  count_ = 0;
+}
+
+double RunningMedian::Process(const double x)
+{
+  if (std::isnan(x))
+    return count_ ? Median() : x;   // Would break the ordering of the window
+
+  double* const end = sorted_ + count_;
+  if (count_ < window_) {
+    ++count_;
+  } else {
+    // Drop the outgoing sample from the sorted copy
+    double* const out = std::lower_bound(sorted_, end, buffer_[next_]);
+    std::memmove(out, out + 1, (end - out - 1) * sizeof(double));
+  }
+  buffer_[next_] = x;
+  next_ = next_ + 1 == window_ ? 0 : next_ + 1;
+
+  double* const last = sorted_ + count_ - 1;
+  double* const in = std::upper_bound(sorted_, last, x);
+  std::memmove(in + 1, in, (last - in) * sizeof(double));
+  *in = x;
+  return Median();
+}
+
+double RunningMedian::Median() const
+{
+  if (count_ == 0)
+    return 0;
+  const std::size_t half = count_ / 2;
+  return count_ % 2 ? sorted_[half] : 0.5 * (sorted_[half - 1] + sorted_[half]);
+}
+
+double RunningMedian::MedianAbsoluteDeviation() const
+{
+  if (count_ == 0)
+    return 0;
+
+  // The deviations below and above the median are each sorted already, so
+  // merging them from the median outwards yields them in order.
+  const double median = Median();
+  const double* lo = std::lower_bound(sorted_, sorted_ + count_, median);
+  const double* hi = lo;
+  const std::size_t half = count_ / 2;
+  double previous = 0;
+  double current = 0;
+  for (std::size_t k = 0; k <= half; ++k) {
+    previous = current;
+    const bool take_lo = hi == sorted_ + count_
+        || (lo != sorted_ && median - lo[-1] <= *hi - median);
+    current = take_lo ? median - *--lo : *hi++ - median;
+  }
+  return count_ % 2 ? current : 0.5 * (previous + current);
+}
+
+std::string RunningMedian::Name() const
+{
+  return "median(" + std::to_string(window_) + ")";
+}
+
+HampelFilter::HampelFilter(const std::size_t window, const double threshold,
+                           const double min_sigma)
+  :median_(window),
+   window_(ClampWindow(window)),
+   threshold_(threshold),
+   min_sigma_(min_sigma)
+{
+}
+
+void HampelFilter::Reset()
+{
+  median_.Reset();
+  rejected_ = 0;
+}
+
+double HampelFilter::Process(const double x)
+{
+  median_.Process(x);
+  const double median = median_.Median();
+  const double sigma = std::max(1.4826 * median_.MedianAbsoluteDeviation(), min_sigma_);
+  if (std::fabs(x - median) > threshold_ * sigma) {
+    ++rejected_;
+    return median;
+  }
+  return x;
+}
+
+std::string HampelFilter::Name() const
+{
+  std::ostringstream name;
+  name << "hampel(" << window_ << ", " << threshold_ << ", " << min_sigma_ << ")";
+  return name.str();
+}
+
+bool FilterChain::Parse(const std::string& spec)
+{
+  Clear();
+  if (spec.empty() || spec == "none")
+    return true;
+
+  std::istringstream stages(spec);
+  std::string stage;
+  while (std::getline(stages, stage, ',')) {
+    std::vector<std::string> fields;
+    std::istringstream parts(stage);
+    std::string field;
+    while (std::getline(parts, field, ':'))
+      fields.push_back(field);
+    if (fields.size() < 2) {
+      Clear();
+      return false;
+    }
+
+    const long window = std::strtol(fields[1].c_str(), nullptr, 10);
+    if (window < 1 || window > static_cast<long>(FilterStage::kMaxWindow)) {
+      Clear();
+      return false;
+    }
+
+    if (fields[0] == "mean" && fields.size() == 2) {
+      Add(std::unique_ptr<FilterStage>(new RunningMean(window)));
+    } else if (fields[0] == "median" && fields.size() == 2) {
+      Add(std::unique_ptr<FilterStage>(new RunningMedian(window)));
+    } else if (fields[0] == "hampel" && (fields.size() == 3 || fields.size() == 4)) {
+      const double min_sigma = fields.size() == 4 ? std::atof(fields[3].c_str())
+                                                  : HampelFilter::kDefaultMinSigma;
+      Add(std::unique_ptr<FilterStage>(new HampelFilter(window, std::atof(fields[2].c_str()),
+                                                        min_sigma)));
+    } else {
+      Clear();
+      return false;
+    }
+  }
+  return true;
+}
+
+void FilterChain::Add(std::unique_ptr<FilterStage> stage)
+{
+  stages_.push_back({std::move(stage), 0, 0});
+}
+
+void FilterChain::Clear()
+{
+  stages_.clear();
+}
+
+void FilterChain::Reset()
+{
+  for (Entry& entry : stages_) {
+    entry.stage->Reset();
+    entry.samples = 0;
+    entry.total_ns = 0;
+  }
+}
+
+double FilterChain::Process(double x)
+{
+  if (!profiling_) {
+    for (Entry& entry : stages_)
+      x = entry.stage->Process(x);
+    return x;
+  }
+
+  using Clock = std::chrono::steady_clock;
+  for (Entry& entry : stages_) {
+    const Clock::time_point start = Clock::now();
+    x = entry.stage->Process(x);
+    entry.total_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    ++entry.samples;
+  }
+  return x;
+}
+
+std::vector<FilterChain::StageCost> FilterChain::Costs() const
+{
+  std::vector<StageCost> costs;
+  costs.reserve(stages_.size());
+  for (const Entry& entry : stages_)
+    costs.push_back({entry.stage->Name(), entry.samples, static_cast<double>(entry.total_ns)});
+  return costs;
+}
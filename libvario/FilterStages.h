@@ -0,0 +1,153 @@
+#ifndef FILTERSTAGES_H
+#define FILTERSTAGES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Streaming pre-filters for raw sensor samples, run in front of the Kalman
+// filters. Every stage keeps its window in a fixed array of kMaxWindow
+// entries, so processing a sample never allocates and each stage owns all
+// of its state (no statics), so any number of chains can run side by side.
+class FilterStage {
+ public:
+  static constexpr std::size_t kMaxWindow = 64;
+
+  virtual ~FilterStage() = default;
+
+  virtual void Reset() = 0;
+
+  // Takes one input sample and returns the filtered one.
+  virtual double Process(double x) = 0;
+
+  // Short description for logs, e.g. "mean(10)".
+  virtual std::string Name() const = 0;
+};
+
+// Moving average over the last window samples, O(1) per sample: the sum is
+// updated with the incoming and outgoing sample and recomputed from the
+// window once per pass to keep rounding errors from building up. Until the
+// window has filled it averages what it has.
+class RunningMean : public FilterStage {
+ public:
+  explicit RunningMean(std::size_t window);
+
+  void Reset() override;
+  double Process(double x) override;
+  std::string Name() const override;
+
+ private:
+  std::size_t window_;
+  double buffer_[kMaxWindow];
+  std::size_t next_;
+  std::size_t count_;
+  double sum_;
+};
+
+// Median of the last window samples. Keeps the window both in arrival order
+// (to know which sample leaves) and sorted; each sample moves at most
+// window entries of the sorted copy, which for the short windows used here
+// beats a two-heap median on cache behaviour and code size.
+class RunningMedian : public FilterStage {
+ public:
+  explicit RunningMedian(std::size_t window);
+
+  void Reset() override;
+  double Process(double x) override;
+  std::string Name() const override;
+
+  // Median and median absolute deviation of the current window. Both are 0
+  // while the window is empty.
+  double Median() const;
+  double MedianAbsoluteDeviation() const;
+
+ private:
+  std::size_t window_;
+  double buffer_[kMaxWindow];   // Arrival order
+  double sorted_[kMaxWindow];
+  std::size_t next_;
+  std::size_t count_;
+};
+
+// Hampel outlier rejector: a sample further than threshold robust standard
+// deviations (1.4826 * MAD) from the median of the last window samples is
+// replaced by that median; anything else passes unchanged, so unlike a
+// median filter it adds no lag to clean data. Spikes from a glitching
+// sensor or a door slamming in the car do not reach the Kalman filter.
+//
+// The deviation is floored at min_sigma, about the sensor's resolution: a
+// window of identical readings (quantized sensor, still air) has no spread
+// at all, and then a step of one count must still pass while a spike of
+// any size is rejected.
+class HampelFilter : public FilterStage {
+ public:
+  static constexpr double kDefaultMinSigma = 1.0;  // Pa, one count of a phone barometer
+
+  HampelFilter(std::size_t window, double threshold, double min_sigma = kDefaultMinSigma);
+
+  void Reset() override;
+  double Process(double x) override;
+  std::string Name() const override;
+
+  std::uint64_t Rejected() const { return rejected_; }
+
+ private:
+  RunningMedian median_;
+  std::size_t window_;
+  double threshold_;
+  double min_sigma_;
+  std::uint64_t rejected_ = 0;
+};
+
+// An ordered chain of stages with per-stage timing for profiling.
+class FilterChain {
+ public:
+  struct StageCost {
+    std::string name;
+    std::uint64_t samples;
+    double total_ns;
+    double MeanNs() const { return samples ? total_ns / samples : 0; }
+  };
+
+  FilterChain() = default;
+
+  /**
+   * Builds a chain from a spec like "hampel:15:3,mean:10": comma-separated
+   * stages, each "mean:<window>", "median:<window>" or
+   * "hampel:<window>:<threshold>[:<min_sigma>]", applied left to right.
+   * min_sigma defaults to HampelFilter::kDefaultMinSigma. An empty spec or
+   * "none" gives a chain that passes samples through. Returns false, leaving
+   * the chain empty, if the spec is malformed or a window is outside
+   * 1..FilterStage::kMaxWindow.
+   */
+  bool Parse(const std::string& spec);
+
+  void Add(std::unique_ptr<FilterStage> stage);
+  void Clear();
+  void Reset();
+
+  double Process(double x);
+
+  bool Empty() const { return stages_.empty(); }
+  std::size_t Size() const { return stages_.size(); }
+  const FilterStage& Stage(std::size_t i) const { return *stages_[i].stage; }
+
+  // Timing every stage costs two clock reads each, so it is off by default.
+  void SetProfiling(bool enabled) { profiling_ = enabled; }
+  bool IsProfiling() const { return profiling_; }
+  std::vector<StageCost> Costs() const;
+
+ private:
+  struct Entry {
+    std::unique_ptr<FilterStage> stage;
+    std::uint64_t samples;
+    std::uint64_t total_ns;
+  };
+
+  std::vector<Entry> stages_;
+  bool profiling_ = false;
+};
+
+#endif // FILTERSTAGES_H
@@ -0,0 +1,166 @@
+#include "FlightModel.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kGravity = 9.80665;
+constexpr double kSeaLevelPressure = 101325.0;
+constexpr double kGlideOut = 30.0;  // s flown after the last air mass
+
+}  // namespace
+
+FlightModel::FlightModel(const FlightSettings& settings, std::vector<AirMass> script)
+  :settings_(settings),
+   script_(std::move(script)),
+   duration_(kGlideOut),
+   rng_(settings.seed),
+   altitude_(settings.start_altitude),
+   climb_(-settings.glider_sink)
+{
+  for (const AirMass& mass : script_)
+    duration_ = std::max(duration_, mass.start + mass.duration + kGlideOut);
+}
+
+std::vector<AirMass> FlightModel::DemoScript()
+{
+  return {
+    { 20,  60,  2.5, 20},   // Weak thermal, circling
+    {110,  40, -2.0,  0},   // Sink on the glide
+    {170, 120,  4.0, 18},   // Strong thermal
+    {320,  30, -3.0,  0},
+    {370,  90,  1.5, 22},
+  };
+}
+
+bool FlightModel::LoadScript(const std::string& path, std::vector<AirMass>& script)
+{
+  std::ifstream in(path);
+  if (!in)
+    return false;
+
+  script.clear();
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '#')
+      continue;
+    std::istringstream fields(line);
+    AirMass mass = {0, 0, 0, 0};
+    if (!(fields >> mass.start >> mass.duration >> mass.strength) || mass.duration <= 0)
+      continue;
+    fields >> mass.circle_period;
+    script.push_back(mass);
+  }
+  return !script.empty();
+}
+
+double FlightModel::AirSpeed(const double t) const
+{
+  double w = 0;
+  for (const AirMass& mass : script_) {
+    const double into = t - mass.start;
+    const double left = mass.start + mass.duration - t;
+    if (into <= 0 || left <= 0)
+      continue;
+
+    // Raised-cosine entry and exit
+    const double edge = std::min(into, left);
+    const double envelope = edge >= settings_.ramp ? 1.0
+        : 0.5 - 0.5 * std::cos(kPi * edge / settings_.ramp);
+
+    double turn = 1.0;
+    if (mass.circle_period > 0)
+      turn = 0.7 + 0.3 * std::cos(2 * kPi * into / mass.circle_period);
+    w += mass.strength * envelope * turn;
+  }
+  return w;
+}
+
+void FlightModel::Advance(double dt)
+{
+  const double tau = settings_.turbulence_time;
+  while (dt > 0) {
+    const double h = std::min(dt, kMaxStep);
+
+    // Gusts: an Ornstein-Uhlenbeck acceleration integrated into a slowly
+    // leaking vertical speed, so gusts have a realistic, finite spectrum.
+    gust_accel_ += -gust_accel_ / tau * h
+                   + settings_.turbulence * std::sqrt(2 * h / tau) * normal_(rng_);
+    gust_speed_ += (gust_accel_ - gust_speed_ / (4 * tau)) * h;
+
+    const double target = AirSpeed(t_) - settings_.glider_sink + gust_speed_;
+    accel_ = (target - climb_) / settings_.response_time;
+    altitude_ += climb_ * h + 0.5 * accel_ * h * h;
+    climb_ += accel_ * h;
+    t_ += h;
+    dt -= h;
+  }
+}
+
+double FlightModel::Pressure() const
+{
+  return kSeaLevelPressure * std::pow(1.0 - altitude_ / 44330.0, 1.0 / 0.19);
+}
+
+double FlightModel::Temperature() const
+{
+  return settings_.ground_temperature - 0.0065 * altitude_;
+}
+
+double FlightModel::SensorTemperature() const
+{
+  return Temperature() + settings_.sensor_warmup * (1.0 - std::exp(-t_ / settings_.warmup_time));
+}
+
+double FlightModel::Sensor(const double value, const double noise, const double resolution)
+{
+  const double reading = value + noise * normal_(rng_);
+  return resolution > 0 ? std::round(reading / resolution) * resolution : reading;
+}
+
+PressureSample FlightModel::ReadPressure(const std::uint64_t timestamp)
+{
+  PressureSample sample;
+  sample.timestamp = timestamp;
+  const double temperature = SensorTemperature();
+  const double drift = settings_.pressure_tempco * (temperature - settings_.ground_temperature);
+  sample.pressure = Sensor(Pressure() + drift, settings_.pressure_noise, settings_.pressure_resolution);
+  sample.temperature = Sensor(temperature, settings_.temperature_noise, settings_.temperature_resolution);
+  return sample;
+}
+
+AccelSample FlightModel::ReadAccel(const std::uint64_t timestamp)
+{
+  // Phone lying flat: z carries gravity, the device is level
+  AccelSample sample;
+  sample.timestamp = timestamp;
+  sample.x = Sensor(0, settings_.accel_noise, settings_.accel_resolution);
+  sample.y = Sensor(0, settings_.accel_noise, settings_.accel_resolution);
+  sample.z = Sensor(kGravity + accel_, settings_.accel_noise, settings_.accel_resolution);
+  sample.roll = 0;
+  sample.pitch = 0;
+  sample.vertical = sample.z - kGravity;
+  sample.qw = 1;
+  sample.qx = 0;
+  sample.qy = 0;
+  sample.qz = 0;
+  sample.heading = std::numeric_limits<double>::quiet_NaN();
+  return sample;
+}
+
+TemperatureSample FlightModel::ReadTemperature(const std::uint64_t timestamp)
+{
+  TemperatureSample sample;
+  sample.timestamp = timestamp;
+  sample.temperature = Sensor(Temperature(), settings_.temperature_noise, settings_.temperature_resolution);
+  return sample;
+}
+
+TruthSample FlightModel::Truth(const std::uint64_t timestamp) const
+{
+  return {timestamp, altitude_, climb_, accel_, AirSpeed(t_), Pressure()};
+}
@@ -0,0 +1,124 @@
+#ifndef FLIGHTMODEL_H
+#define FLIGHTMODEL_H
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include "SensorSamples.h"
+
+// One scripted air mass the glider flies through: a thermal (rising air) or
+// a sink area, entered and left over FlightSettings::ramp seconds.
+struct AirMass {
+  double start;           // s from the start of the flight
+  double duration;        // s
+  double strength;        // Vertical air speed at the core, m/s, negative for sink
+  double circle_period;   // s per turn when circling, 0 if not; the climb then
+                          // swings between 40% and 100% of strength with each turn
+};
+
+struct FlightSettings {
+  double start_altitude = 1000.0;   // m
+  double glider_sink = 1.1;         // Sink rate in still air, m/s
+  double response_time = 1.0;       // How fast the glider follows the air, s
+  double ramp = 5.0;                // Time to enter or leave an air mass, s
+  double turbulence = 0.5;          // Standard deviation of the gust acceleration, m/s^2
+  double turbulence_time = 0.5;     // Correlation time of the gusts, s
+  double ground_temperature = 20.0; // Celsius at sea level, standard lapse rate above
+
+  // Sensor rates in Hz and imperfections. Readings are truth plus white
+  // noise, rounded to the resolution (0 = no rounding).
+  double pressure_rate = 100.0;
+  double accel_rate = 200.0;
+  double temperature_rate = 1.0;
+  double pressure_noise = 2.0;          // Pa
+  double pressure_resolution = 1.0;     // Pa
+  double accel_noise = 0.05;            // m/s^2
+  double accel_resolution = 0.0024;     // m/s^2, about 1/4096 g
+  double temperature_noise = 0.05;      // Celsius
+  double temperature_resolution = 0.1;  // Celsius
+
+  // The phone warming the pressure sensor above the air temperature by
+  // sensor_warmup Celsius, approached with time constant warmup_time, and the
+  // sensor's pressure error per Celsius away from ground_temperature.
+  double sensor_warmup = 0.0;           // Celsius
+  double warmup_time = 300.0;           // s
+  double pressure_tempco = 0.0;         // Pa per Celsius
+
+  unsigned seed = 1;
+};
+
+// What the simulated glider really did at a sensor timestamp.
+struct TruthSample {
+  std::uint64_t timestamp;
+  double altitude;        // m
+  double climb;           // m/s
+  double vertical_accel;  // m/s^2
+  double air;             // Vertical speed of the air mass, m/s
+  double pressure;        // Pa, before noise and rounding
+};
+
+// Vertical motion of a glider flying through scripted thermals and sink with
+// turbulence, and the readings a barometer, accelerometer and thermometer
+// would give on board. The air speed drives the glider's climb through a
+// first-order lag, so acceleration stays continuous like in a real flight.
+// Pressure follows from altitude with the inverse of
+// VarioProcessor::PressureToAltitude(), so the truth and the app's altitude
+// scale agree exactly. The random sequence is fixed by the seed, so a flight
+// is repeatable.
+class FlightModel {
+ public:
+  FlightModel(const FlightSettings& settings, std::vector<AirMass> script);
+
+  // An 8 minute flight with three thermals and two sink areas.
+  static std::vector<AirMass> DemoScript();
+
+  /**
+   * Reads a script file, one air mass per line:
+   * "<start_s> <duration_s> <strength_ms> [<circle_period_s>]".
+   * Lines starting with '#' are ignored. Returns false if the file cannot be
+   * read or holds no air mass.
+   */
+  static bool LoadScript(const std::string& path, std::vector<AirMass>& script);
+
+  // Time until the end of the last air mass plus a glide-out, in s.
+  double Duration() const { return duration_; }
+
+  // Advances the flight by dt seconds.
+  void Advance(double dt);
+
+  double Time() const { return t_; }
+  double Altitude() const { return altitude_; }
+  double Climb() const { return climb_; }
+  double VerticalAcceleration() const { return accel_; }
+  double Pressure() const;       // Pa
+  double Temperature() const;    // Celsius
+  double SensorTemperature() const;  // Celsius, inside the pressure sensor
+  double AirSpeed(double t) const;
+
+  PressureSample ReadPressure(std::uint64_t timestamp);
+  AccelSample ReadAccel(std::uint64_t timestamp);
+  TemperatureSample ReadTemperature(std::uint64_t timestamp);
+  TruthSample Truth(std::uint64_t timestamp) const;
+
+ private:
+  static constexpr double kMaxStep = 1e-3;  // Integration step, s
+
+  double Sensor(double value, double noise, double resolution);
+
+  FlightSettings settings_;
+  std::vector<AirMass> script_;
+  double duration_;
+
+  std::mt19937 rng_;
+  std::normal_distribution<double> normal_;
+
+  double t_ = 0;
+  double altitude_;
+  double climb_;
+  double accel_ = 0;
+  double gust_accel_ = 0;
+  double gust_speed_ = 0;
+};
+
+#endif // FLIGHTMODEL_H
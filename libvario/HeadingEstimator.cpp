@@ -0,0 +1,64 @@
+#include "HeadingEstimator.h"
+#include <cmath>
+
+HeadingEstimator::HeadingEstimator(const double course_time_constant, const double min_speed)
+  :course_time_constant_(course_time_constant),
+   min_speed_(min_speed)
+{
+}
+
+void HeadingEstimator::Reset()
+{
+  magnetic_ = course_ = offset_ = 0;
+  has_magnetic_ = has_course_ = has_offset_ = false;
+}
+
+void HeadingEstimator::UpdateMagnetic(const double heading)
+{
+  has_magnetic_ = !std::isnan(heading);
+  if (has_magnetic_)
+    magnetic_ = Wrap(heading);
+}
+
+void HeadingEstimator::UpdateCourse(const double course, const double speed, const double dt)
+{
+  if (!(speed >= min_speed_) || std::isnan(course))
+    return;
+
+  course_ = Wrap(course);
+  has_course_ = true;
+  if (!has_magnetic_)
+    return;
+
+  // First course: take the offset as is, then follow it as a low-pass on the
+  // circle. The error is wrapped before scaling, so the offset never takes
+  // the long way round.
+  const double error = Difference(course_ - magnetic_, offset_);
+  if (!has_offset_) {
+    offset_ = Difference(course_, magnetic_);
+    has_offset_ = true;
+  } else if (dt > 0) {
+    offset_ = Difference(offset_ + error * dt / (course_time_constant_ + dt), 0);
+  }
+}
+
+double HeadingEstimator::Heading() const
+{
+  if (has_magnetic_)
+    return Wrap(magnetic_ + offset_);
+  return has_course_ ? course_ : 0;
+}
+
+double HeadingEstimator::Wrap(const double degrees)
+{
+  double wrapped = std::fmod(degrees, 360.0);
+  if (wrapped < 0)
+    wrapped += 360;
+  return wrapped < 360 ? wrapped : 0;   // -1e-20 + 360 rounds to 360
+}
+
+double HeadingEstimator::Difference(const double a, const double b)
+{
+  const double d = Wrap(a - b);
+  return d > 180 ? d - 360 : d;
+}
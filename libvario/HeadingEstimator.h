@@ -0,0 +1,61 @@
+#ifndef HEADINGESTIMATOR_H
+#define HEADINGESTIMATOR_H
+
+// One heading for the display, from two sources that disagree: the
+// tilt-compensated magnetic heading (fast, every IMU sample, but off by the
+// magnetic declination and by the wind's crab angle) and the GPS course over
+// ground (right on average, but only once a second and only while moving).
+//
+// The magnetic heading drives the output; the GPS course slowly trains an
+// offset added to it, so turns show up immediately and the straight-line
+// heading settles on the track. Without a magnetometer the course is used
+// directly. All angle arithmetic goes through Difference(), so 359 and 1
+// degrees average to 0, not 180.
+class HeadingEstimator {
+ public:
+  /**
+   * course_time_constant is how fast, in seconds, the offset follows the
+   * GPS course; courses at less than min_speed (km/h) are ignored because
+   * they are mostly position noise.
+   */
+  explicit HeadingEstimator(double course_time_constant = 10.0, double min_speed = 8.0);
+
+  void Reset();
+
+  // Tilt-compensated magnetic heading in degrees, NaN when there is none.
+  void UpdateMagnetic(double heading);
+
+  /**
+   * GPS course over ground in degrees with the ground speed in km/h; dt is
+   * the time since the previous fix in seconds. A fix without a course or
+   * speed (NaN) is ignored.
+   */
+  void UpdateCourse(double course, double speed, double dt);
+
+  bool IsValid() const { return has_magnetic_ || has_course_; }
+
+  // Degrees clockwise from north, 0-360: magnetic until the GPS course has
+  // trained the offset, true after. 0 until IsValid().
+  double Heading() const;
+
+  // Current magnetic-to-course offset in degrees.
+  double Offset() const { return offset_; }
+
+  // Angle in [0, 360).
+  static double Wrap(double degrees);
+
+  // Shortest signed rotation from b to a, in (-180, 180].
+  static double Difference(double a, double b);
+
+ private:
+  double course_time_constant_;
+  double min_speed_;
+  double magnetic_ = 0;
+  double course_ = 0;
+  double offset_ = 0;
+  bool has_magnetic_ = false;
+  bool has_course_ = false;
+  bool has_offset_ = false;
+};
+
+#endif // HEADINGESTIMATOR_H
@@ -0,0 +1,56 @@
+#include "InnovationNoiseEstimator.h"
+#include <algorithm>
+
+InnovationNoiseEstimator::InnovationNoiseEstimator(const std::size_t window,
+                                                   const double initial_variance,
+                                                   const double min_variance,
+                                                   const double max_variance)
+  :window_(std::max<std::size_t>(window, 2)),
+   initial_variance_(initial_variance),
+   min_variance_(min_variance),
+   max_variance_(max_variance)
+{
+  Reset();
+}
+
+void InnovationNoiseEstimator::Reset()
+{
+  next_ = 0;
+  count_ = 0;
+  since_resum_ = 0;
+  sum_y2_ = 0;
+  sum_hph_ = 0;
+  variance_ = initial_variance_;
+}
+
+void InnovationNoiseEstimator::Add(const double innovation, const double prior_variance)
+{
+  Entry& slot = window_[next_];
+  if (count_ == window_.size()) {
+    sum_y2_ -= slot.y2;
+    sum_hph_ -= slot.hph;
+  } else {
+    ++count_;
+  }
+  slot = {innovation * innovation, prior_variance};
+  sum_y2_ += slot.y2;
+  sum_hph_ += slot.hph;
+  next_ = (next_ + 1) % window_.size();
+
+  // Subtracting evicted samples slowly accumulates rounding error; rebuild
+  // the sums once per window, which keeps the cost amortized O(1).
+  if (++since_resum_ == window_.size()) {
+    since_resum_ = 0;
+    sum_y2_ = 0;
+    sum_hph_ = 0;
+    for (std::size_t i = 0; i < count_; ++i) {
+      sum_y2_ += window_[i].y2;
+      sum_hph_ += window_[i].hph;
+    }
+  }
+
+  if (IsSettled()) {
+    const double r = (sum_y2_ - sum_hph_) / count_;
+    variance_ = std::min(max_variance_, std::max(min_variance_, r));
+  }
+}
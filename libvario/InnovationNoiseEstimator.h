@@ -0,0 +1,56 @@
+#ifndef INNOVATIONNOISEESTIMATOR_H
+#define INNOVATIONNOISEESTIMATOR_H
+
+#include <cstddef>
+#include <vector>
+
+// Online estimate of a Kalman filter's measurement noise variance from its
+// innovations (Mehra's covariance matching). For a consistent filter the
+// innovation y = z - H x has variance H P H' + R, so over a sliding window
+//
+//   R ~= mean(y^2) - mean(H P H')
+//
+// Both means are kept as running sums over a ring buffer, so every sample
+// costs O(1) whatever the window length. The estimate is clamped to
+// [min_variance, max_variance] and falls back to the initial value until
+// the window has filled.
+class InnovationNoiseEstimator {
+  struct Entry {
+    double y2;
+    double hph;
+  };
+
+  std::vector<Entry> window_;
+  std::size_t next_;
+  std::size_t count_;
+  std::size_t since_resum_;
+  double sum_y2_;
+  double sum_hph_;
+
+  double initial_variance_;
+  double min_variance_;
+  double max_variance_;
+  double variance_;
+
+ public:
+  InnovationNoiseEstimator(std::size_t window, double initial_variance,
+                           double min_variance, double max_variance);
+
+  void Reset();
+
+  /**
+   * Adds the innovation of one measurement update and the predicted variance
+   * H P H' it was computed against, and refreshes the estimate.
+   */
+  void Add(double innovation, double prior_variance);
+
+  // Current measurement noise variance estimate.
+  double Variance() const { return variance_; }
+
+  // Mean squared innovation over the window, for instrumentation.
+  double InnovationPower() const { return count_ ? sum_y2_ / count_ : 0; }
+
+  bool IsSettled() const { return count_ == window_.size(); }
+};
+
+#endif // INNOVATIONNOISEESTIMATOR_H
@@ -22,6 +22,11 @@ class KalmanFilter {
   // per second squared.
   double var_x_accel_;
 
+  // The innovation of the last measurement and the predicted variance of x it
+  // was weighed against, kept for innovation-based noise estimation.
+  double y_;
+  double p_prior_abs_abs_;
+
  public:
   // Constructors: the first allows you to supply the variance of the
   // acceleration noise input to the system model in x units per second squared;
@@ -58,12 +63,31 @@ class KalmanFilter {
    */
   void Update(double z_abs, double var_z_abs, double dt);
 
+  /**
+   * Advances the state by dt seconds using a measured acceleration of x as a
+   * known control input, instead of assuming zero acceleration. With this
+   * form var_x_accel_ describes the noise of the acceleration input. Pair
+   * with Correct() whenever a measurement of x arrives.
+   */
+  void Predict(double accel, double dt);
+
+  /**
+   * Corrects the state with a direct sensor measurement of the absolute
+   * quantity x and its variance, without advancing time.
+   */
+  void Correct(double z_abs, double var_z_abs);
+
   // Getters for the state and its covariance.
   double GetXAbs() const { return x_abs_; }
   double GetXVel() const { return x_vel_; }
   double GetCovAbsAbs() const { return p_abs_abs_; }
   double GetCovAbsVel() const { return p_abs_vel_; }
   double GetCovVelVel() const { return p_vel_vel_; }
+
+  // Getters for the last measurement update: the innovation z - x and the
+  // predicted variance of x before the measurement was applied.
+  double GetInnovation() const { return y_; }
+  double GetPriorCovAbsAbs() const { return p_prior_abs_abs_; }
 };
 
 
@@ -0,0 +1,191 @@
+#include "KalmanFilterBank.h"
+#include <assert.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// Minimal wrappers around the vector instruction set we were compiled for.
+// The kernel below is written once against this interface; the Scalar flavour
+// handles both the non-SIMD fallback and the tail of every pass.
+struct Scalar {
+  using V = double;
+  static constexpr std::size_t kWidth = 1;
+  static V Load(const double* p) { return *p; }
+  static void Store(double* p, V v) { *p = v; }
+  static V Set(double a) { return a; }
+  static V Add(V a, V b) { return a + b; }
+  static V Sub(V a, V b) { return a - b; }
+  static V Mul(V a, V b) { return a * b; }
+  static V Div(V a, V b) { return a / b; }
+};
+
+#if defined(__AVX__)
+struct Simd {
+  using V = __m256d;
+  static constexpr std::size_t kWidth = 4;
+  static V Load(const double* p) { return _mm256_loadu_pd(p); }
+  static void Store(double* p, V v) { _mm256_storeu_pd(p, v); }
+  static V Set(double a) { return _mm256_set1_pd(a); }
+  static V Add(V a, V b) { return _mm256_add_pd(a, b); }
+  static V Sub(V a, V b) { return _mm256_sub_pd(a, b); }
+  static V Mul(V a, V b) { return _mm256_mul_pd(a, b); }
+  static V Div(V a, V b) { return _mm256_div_pd(a, b); }
+};
+#elif defined(__SSE2__) || defined(_M_X64)
+struct Simd {
+  using V = __m128d;
+  static constexpr std::size_t kWidth = 2;
+  static V Load(const double* p) { return _mm_loadu_pd(p); }
+  static void Store(double* p, V v) { _mm_storeu_pd(p, v); }
+  static V Set(double a) { return _mm_set1_pd(a); }
+  static V Add(V a, V b) { return _mm_add_pd(a, b); }
+  static V Sub(V a, V b) { return _mm_sub_pd(a, b); }
+  static V Mul(V a, V b) { return _mm_mul_pd(a, b); }
+  static V Div(V a, V b) { return _mm_div_pd(a, b); }
+};
+#elif defined(__aarch64__)
+struct Simd {
+  using V = float64x2_t;
+  static constexpr std::size_t kWidth = 2;
+  static V Load(const double* p) { return vld1q_f64(p); }
+  static void Store(double* p, V v) { vst1q_f64(p, v); }
+  static V Set(double a) { return vdupq_n_f64(a); }
+  static V Add(V a, V b) { return vaddq_f64(a, b); }
+  static V Sub(V a, V b) { return vsubq_f64(a, b); }
+  static V Mul(V a, V b) { return vmulq_f64(a, b); }
+  static V Div(V a, V b) { return vdivq_f64(a, b); }
+};
+#else
+using Simd = Scalar;
+#endif
+
+// Fetches one group of lanes from an input that is either an array or a
+// single value shared by all lanes.
+template<typename S, bool kShared>
+inline typename S::V LoadInput(const double* p, std::size_t i)
+{
+  return kShared ? S::Set(*p) : S::Load(p + i);
+}
+
+// Predict+update for lanes [begin, end) in groups of S::kWidth. Mirrors
+// KalmanFilter::Update() operation for operation; see the note in the header.
+template<typename S, bool kShared>
+std::size_t UpdateKernel(std::size_t begin, std::size_t end,
+                         double* x_abs, double* x_vel,
+                         double* p_abs_abs, double* p_abs_vel, double* p_vel_vel,
+                         const double* var_x_accel,
+                         const double* z_abs, const double* var_z_abs,
+                         const double* dt_in)
+{
+  const auto one = S::Set(1);
+  const auto two = S::Set(2);
+  const auto four = S::Set(4);
+
+  std::size_t i = begin;
+  for (; i + S::kWidth <= end; i += S::kWidth) {
+    const auto dt = LoadInput<S, kShared>(dt_in, i);
+    const auto var_a = S::Load(var_x_accel + i);
+    auto xa = S::Load(x_abs + i);
+    auto xv = S::Load(x_vel + i);
+    auto paa = S::Load(p_abs_abs + i);
+    auto pav = S::Load(p_abs_vel + i);
+    auto pvv = S::Load(p_vel_vel + i);
+
+    // Predict step.
+    xa = S::Add(xa, S::Mul(xv, dt));
+    const auto dt2 = S::Mul(dt, dt);
+    const auto dt3 = S::Mul(dt, dt2);
+    const auto dt4 = S::Mul(dt2, dt2);
+    paa = S::Add(paa, S::Add(S::Add(S::Mul(S::Mul(two, dt), pav),
+                                    S::Mul(dt2, pvv)),
+                             S::Div(S::Mul(var_a, dt4), four)));
+    pav = S::Add(pav, S::Add(S::Mul(dt, pvv),
+                             S::Div(S::Mul(var_a, dt3), two)));
+    pvv = S::Add(pvv, S::Mul(var_a, dt2));
+
+    // Update step.
+    const auto y = S::Sub(S::Load(z_abs + i), xa);
+    const auto s_inv = S::Div(one, S::Add(paa, LoadInput<S, kShared>(var_z_abs, i)));
+    const auto k_abs = S::Mul(paa, s_inv);
+    const auto k_vel = S::Mul(pav, s_inv);
+    xa = S::Add(xa, S::Mul(k_abs, y));
+    xv = S::Add(xv, S::Mul(k_vel, y));
+    pvv = S::Sub(pvv, S::Mul(pav, k_vel));
+    pav = S::Sub(pav, S::Mul(pav, k_abs));
+    paa = S::Sub(paa, S::Mul(paa, k_abs));
+
+    S::Store(x_abs + i, xa);
+    S::Store(x_vel + i, xv);
+    S::Store(p_abs_abs + i, paa);
+    S::Store(p_abs_vel + i, pav);
+    S::Store(p_vel_vel + i, pvv);
+  }
+  return i;
+}
+
+}  // namespace
+
+KalmanFilterBank::KalmanFilterBank(const std::size_t size, const double var_x_accel)
+  :x_abs_(size), x_vel_(size),
+   p_abs_abs_(size), p_abs_vel_(size), p_vel_vel_(size),
+   var_x_accel_(size, var_x_accel)
+{
+  ResetAll(0, 0);
+}
+
+void KalmanFilterBank::Reset(const std::size_t lane, const double x_abs_value,
+                             const double x_vel_value)
+{
+  x_abs_[lane] = x_abs_value;
+  x_vel_[lane] = x_vel_value;
+  p_abs_abs_[lane] = 1.e6;
+  p_abs_vel_[lane] = 0;
+  p_vel_vel_[lane] = var_x_accel_[lane];
+}
+
+void KalmanFilterBank::ResetAll(const double x_abs_value, const double x_vel_value)
+{
+  for (std::size_t lane = 0; lane < Size(); ++lane) {
+    Reset(lane, x_abs_value, x_vel_value);
+  }
+}
+
+template<bool kSharedInputs>
+void KalmanFilterBank::UpdateLanes(const double* z_abs, const double* var_z_abs,
+                                   const double* dt)
+{
+  const std::size_t n = Size();
+  std::size_t done = UpdateKernel<Simd, kSharedInputs>(
+      0, n, x_abs_.data(), x_vel_.data(),
+      p_abs_abs_.data(), p_abs_vel_.data(), p_vel_vel_.data(),
+      var_x_accel_.data(), z_abs, var_z_abs, dt);
+  UpdateKernel<Scalar, kSharedInputs>(
+      done, n, x_abs_.data(), x_vel_.data(),
+      p_abs_abs_.data(), p_abs_vel_.data(), p_vel_vel_.data(),
+      var_x_accel_.data(), z_abs, var_z_abs, dt);
+}
+
+void KalmanFilterBank::Update(const double* z_abs, const double* var_z_abs,
+                              const double* dt)
+{
+#ifndef NDEBUG
+  for (std::size_t lane = 0; lane < Size(); ++lane) {
+    assert(dt[lane] > 0);
+  }
+#endif
+  UpdateLanes<false>(z_abs, var_z_abs, dt);
+}
+
+void KalmanFilterBank::Update(const double* z_abs, const double var_z_abs,
+                              const double dt)
+{
+  assert(dt > 0);
+  UpdateLanes<true>(z_abs, &var_z_abs, &dt);
+}
@@ -0,0 +1,74 @@
+#ifndef KALMANFILTERBANK_H
+#define KALMANFILTERBANK_H
+
+#include <cstddef>
+#include <vector>
+
+// A bank of independent KalmanFilter instances stored as a structure of
+// arrays, so that predict+update for all of them runs as one vectorized pass
+// (AVX or SSE2 on x86, NEON on AArch64, plain scalar code elsewhere).
+//
+// Every lane follows exactly the same arithmetic as KalmanFilter::Update(), in
+// the same order. As long as the compiler does not contract multiply/add pairs
+// into FMA instructions differently for the two code paths (the default for
+// builds without -mfma), lane i is bit-identical to a KalmanFilter fed the same
+// inputs; otherwise the two agree to within a few ulps.
+class KalmanFilterBank {
+  // The state we are tracking, one entry per lane.
+  std::vector<double> x_abs_;
+  std::vector<double> x_vel_;
+
+  // Covariance matrix for the state, one entry per lane.
+  std::vector<double> p_abs_abs_;
+  std::vector<double> p_abs_vel_;
+  std::vector<double> p_vel_vel_;
+
+  // The variance of the acceleration noise input to the system model, per
+  // lane, so that different filter settings can be compared side by side.
+  std::vector<double> var_x_accel_;
+
+  template<bool kSharedInputs>
+  void UpdateLanes(const double* z_abs, const double* var_z_abs,
+                   const double* dt);
+
+ public:
+  // Creates "size" filters, all using the given acceleration variance and
+  // reset to zero.
+  explicit KalmanFilterBank(std::size_t size, double var_x_accel = 1);
+
+  std::size_t Size() const { return x_abs_.size(); }
+
+  // Same semantics as KalmanFilter::Reset(), for one lane or for all lanes.
+  void Reset(std::size_t lane, double x_abs_value, double x_vel_value = 0);
+  void ResetAll(double x_abs_value, double x_vel_value = 0);
+
+  void SetAccelerationVariance(std::size_t lane, double var_x_accel) {
+    var_x_accel_[lane] = var_x_accel;
+  }
+
+  /**
+   * Updates every lane with its own measurement, measurement variance and
+   * interval since the last measurement. Each array must hold Size()
+   * entries; all intervals must be greater than 0.
+   */
+  void Update(const double* z_abs, const double* var_z_abs, const double* dt);
+
+  /**
+   * Updates every lane with its own measurement while sharing one
+   * measurement variance and one interval across all lanes.
+   */
+  void Update(const double* z_abs, double var_z_abs, double dt);
+
+  // Getters for the state and its covariance of a single lane.
+  double GetXAbs(std::size_t lane) const { return x_abs_[lane]; }
+  double GetXVel(std::size_t lane) const { return x_vel_[lane]; }
+  double GetCovAbsAbs(std::size_t lane) const { return p_abs_abs_[lane]; }
+  double GetCovAbsVel(std::size_t lane) const { return p_abs_vel_[lane]; }
+  double GetCovVelVel(std::size_t lane) const { return p_vel_vel_[lane]; }
+
+  // Contiguous views of the whole bank, handy for bulk comparisons.
+  const double* XAbsData() const { return x_abs_.data(); }
+  const double* XVelData() const { return x_vel_.data(); }
+};
+
+#endif // KALMANFILTERBANK_H
@@ -0,0 +1,321 @@
+#ifndef KALMANFILTERN_H
+#define KALMANFILTERN_H
+
+// Compile-time sized linear Kalman filter.
+//
+// Everything here is header-only and allocation-free: state, covariance and
+// all intermediate matrices are fixed-size arrays whose dimensions are
+// template parameters, and every loop has constant bounds. The products are
+// generic, though, and multiply out every zero of F and H, so the 2-state
+// model costs about twice the hand-written filter (bench filter/n2 against
+// filter/2state); use ::KalmanFilter where that matters. The template lives in
+// its own namespace so that it can coexist with the hand-written 2-state
+// ::KalmanFilter.
+
+namespace kalman {
+
+template<typename T, int R, int C>
+struct Matrix {
+  T m[R][C];
+
+  constexpr T& operator()(int r, int c) { return m[r][c]; }
+  constexpr const T& operator()(int r, int c) const { return m[r][c]; }
+
+  static constexpr Matrix Zero() {
+    Matrix z{};
+    return z;
+  }
+
+  static constexpr Matrix Identity() {
+    Matrix id{};
+    for (int i = 0; i < R && i < C; ++i)
+      id.m[i][i] = T(1);
+    return id;
+  }
+};
+
+template<typename T, int N>
+using Vector = Matrix<T, N, 1>;
+
+template<typename T, int R, int K, int C>
+constexpr Matrix<T, R, C> operator*(const Matrix<T, R, K>& a, const Matrix<T, K, C>& b)
+{
+  Matrix<T, R, C> out{};
+  for (int r = 0; r < R; ++r)
+    for (int c = 0; c < C; ++c) {
+      T sum = 0;
+      for (int k = 0; k < K; ++k)
+        sum += a.m[r][k] * b.m[k][c];
+      out.m[r][c] = sum;
+    }
+  return out;
+}
+
+template<typename T, int R, int C>
+constexpr Matrix<T, R, C> operator+(const Matrix<T, R, C>& a, const Matrix<T, R, C>& b)
+{
+  Matrix<T, R, C> out{};
+  for (int r = 0; r < R; ++r)
+    for (int c = 0; c < C; ++c)
+      out.m[r][c] = a.m[r][c] + b.m[r][c];
+  return out;
+}
+
+template<typename T, int R, int C>
+constexpr Matrix<T, R, C> operator-(const Matrix<T, R, C>& a, const Matrix<T, R, C>& b)
+{
+  Matrix<T, R, C> out{};
+  for (int r = 0; r < R; ++r)
+    for (int c = 0; c < C; ++c)
+      out.m[r][c] = a.m[r][c] - b.m[r][c];
+  return out;
+}
+
+template<typename T, int R, int C>
+constexpr Matrix<T, C, R> Transpose(const Matrix<T, R, C>& a)
+{
+  Matrix<T, C, R> out{};
+  for (int r = 0; r < R; ++r)
+    for (int c = 0; c < C; ++c)
+      out.m[c][r] = a.m[r][c];
+  return out;
+}
+
+// Inverse of a small square matrix by Gauss-Jordan elimination with partial
+// pivoting. The innovation covariance we invert is symmetric positive
+// definite, so a zero pivot means the caller passed garbage.
+template<typename T, int N>
+constexpr Matrix<T, N, N> Inverse(Matrix<T, N, N> a)
+{
+  if constexpr (N == 1) {
+    Matrix<T, 1, 1> out{};
+    out.m[0][0] = T(1) / a.m[0][0];
+    return out;
+  } else {
+    auto inv = Matrix<T, N, N>::Identity();
+    for (int col = 0; col < N; ++col) {
+      int pivot = col;
+      for (int r = col + 1; r < N; ++r) {
+        const T cand = a.m[r][col] < 0 ? -a.m[r][col] : a.m[r][col];
+        const T best = a.m[pivot][col] < 0 ? -a.m[pivot][col] : a.m[pivot][col];
+        if (cand > best)
+          pivot = r;
+      }
+      if (pivot != col) {
+        for (int c = 0; c < N; ++c) {
+          T t = a.m[col][c]; a.m[col][c] = a.m[pivot][c]; a.m[pivot][c] = t;
+          t = inv.m[col][c]; inv.m[col][c] = inv.m[pivot][c]; inv.m[pivot][c] = t;
+        }
+      }
+      const T d = T(1) / a.m[col][col];
+      for (int c = 0; c < N; ++c) {
+        a.m[col][c] *= d;
+        inv.m[col][c] *= d;
+      }
+      for (int r = 0; r < N; ++r) {
+        if (r == col)
+          continue;
+        const T f = a.m[r][col];
+        for (int c = 0; c < N; ++c) {
+          a.m[r][c] -= f * a.m[col][c];
+          inv.m[r][c] -= f * inv.m[col][c];
+        }
+      }
+    }
+    return inv;
+  }
+}
+
+// Generic linear Kalman filter with NStates states and NMeas measurements.
+// The model matrices are passed in on every step, which keeps the template
+// free of policy; see ConstantVelocityFilter and ConstantAccelerationFilter
+// below for ready-made altitude models.
+template<typename T, int NStates, int NMeas>
+class KalmanFilter {
+ public:
+  using StateVector = Vector<T, NStates>;
+  using StateMatrix = Matrix<T, NStates, NStates>;
+  using MeasVector = Vector<T, NMeas>;
+  using MeasMatrix = Matrix<T, NMeas, NStates>;
+  using MeasCovariance = Matrix<T, NMeas, NMeas>;
+
+  static constexpr int kStates = NStates;
+  static constexpr int kMeasurements = NMeas;
+
+  constexpr KalmanFilter() : x_(StateVector::Zero()), p_(StateMatrix::Identity()) {}
+
+  constexpr void Reset(const StateVector& x, const StateMatrix& p) {
+    x_ = x;
+    p_ = p;
+  }
+
+  // x = F x, P = F P F' + Q.
+  constexpr void Predict(const StateMatrix& f, const StateMatrix& q) {
+    x_ = f * x_;
+    p_ = f * p_ * Transpose(f) + q;
+  }
+
+  // Standard measurement update with measurement z, model H and noise R.
+  constexpr void Update(const MeasVector& z, const MeasMatrix& h,
+                        const MeasCovariance& r) {
+    const auto ht = Transpose(h);
+    const auto pht = p_ * ht;
+    hpht_ = h * pht;
+    y_ = z - h * x_;
+    const auto s_inv = Inverse(hpht_ + r);  // Innovation precision.
+    const auto k = pht * s_inv;             // Kalman gain.
+    x_ = x_ + k * y_;
+    p_ = p_ - k * (h * p_);
+  }
+
+  constexpr const StateVector& State() const { return x_; }
+  constexpr const StateMatrix& Covariance() const { return p_; }
+
+  // Innovation of the last update and its predicted covariance H P H'
+  // (without the measurement noise).
+  constexpr const MeasVector& Innovation() const { return y_; }
+  constexpr const MeasCovariance& PriorMeasCovariance() const { return hpht_; }
+
+ private:
+  StateVector x_;
+  StateMatrix p_;
+  MeasVector y_{};
+  MeasCovariance hpht_{};
+};
+
+// Altitude/vertical-speed model driven by piecewise-constant white
+// acceleration noise. Mathematically identical to ::KalmanFilter and exposes
+// the same interface so the two can be swapped freely.
+template<typename T>
+class ConstantVelocityFilter {
+  using Filter = KalmanFilter<T, 2, 1>;
+  using StateVector = typename Filter::StateVector;
+  using StateMatrix = typename Filter::StateMatrix;
+
+ public:
+  explicit ConstantVelocityFilter(T var_x_accel = 1) : var_x_accel_(var_x_accel) {
+    Reset();
+  }
+
+  void Reset(T x_abs_value = 0, T x_vel_value = 0) {
+    StateVector x{};
+    x(0, 0) = x_abs_value;
+    x(1, 0) = x_vel_value;
+    auto p = StateMatrix::Zero();
+    p(0, 0) = T(1.e6);
+    p(1, 1) = var_x_accel_;
+    filter_.Reset(x, p);
+  }
+
+  void SetAccelerationVariance(T var_x_accel) { var_x_accel_ = var_x_accel; }
+
+  void Update(T z_abs, T var_z_abs, T dt) {
+    auto f = StateMatrix::Identity();
+    f(0, 1) = dt;
+    Vector<T, 2> g{};
+    g(0, 0) = dt * dt / 2;
+    g(1, 0) = dt;
+    Matrix<T, 1, 1> var{};
+    var(0, 0) = var_x_accel_;
+    filter_.Predict(f, g * var * Transpose(g));
+
+    typename Filter::MeasVector z{};
+    z(0, 0) = z_abs;
+    typename Filter::MeasMatrix h{};
+    h(0, 0) = 1;
+    typename Filter::MeasCovariance r{};
+    r(0, 0) = var_z_abs;
+    filter_.Update(z, h, r);
+  }
+
+  T GetXAbs() const { return filter_.State()(0, 0); }
+  T GetXVel() const { return filter_.State()(1, 0); }
+  T GetInnovation() const { return filter_.Innovation()(0, 0); }
+  T GetPriorCovAbsAbs() const { return filter_.PriorMeasCovariance()(0, 0); }
+
+ private:
+  Filter filter_;
+  T var_x_accel_;
+};
+
+// Altitude/vertical-speed/vertical-acceleration model driven by
+// piecewise-constant white jerk noise. Tracking acceleration lets the
+// velocity estimate start moving as soon as the climb starts to build,
+// instead of waiting for the altitude error to accumulate, so the vario
+// reacts sooner to the onset of lift.
+template<typename T>
+class ConstantAccelerationFilter {
+  using Filter = KalmanFilter<T, 3, 1>;
+  using StateVector = typename Filter::StateVector;
+  using StateMatrix = typename Filter::StateMatrix;
+
+ public:
+  // Initial variances of the velocity, in (x units per second)^2, and of the
+  // acceleration, in (x units per second squared)^2: a vario's range of
+  // +-10 m/s and a glider's +-3 m/s^2 when x is in metres.
+  static constexpr T kInitialVelocityVariance = 100;
+  static constexpr T kInitialAccelerationVariance = 10;
+
+  // var_x_jerk is the variance of the jerk noise input to the system model,
+  // in x units per second cubed, squared. var_x_vel and var_x_accel are the
+  // variances Reset() gives velocity and acceleration.
+  explicit ConstantAccelerationFilter(T var_x_jerk = 1,
+                                      T var_x_vel = kInitialVelocityVariance,
+                                      T var_x_accel = kInitialAccelerationVariance)
+    : var_x_jerk_(var_x_jerk), var_x_vel_(var_x_vel), var_x_accel_(var_x_accel) {
+    Reset();
+  }
+
+  void Reset(T x_abs_value = 0, T x_vel_value = 0, T x_accel_value = 0) {
+    StateVector x{};
+    x(0, 0) = x_abs_value;
+    x(1, 0) = x_vel_value;
+    x(2, 0) = x_accel_value;
+    auto p = StateMatrix::Zero();
+    p(0, 0) = T(1.e6);
+    p(1, 1) = var_x_vel_;
+    p(2, 2) = var_x_accel_;
+    filter_.Reset(x, p);
+  }
+
+  void SetAccelerationVariance(T var_x_jerk) { var_x_jerk_ = var_x_jerk; }
+
+  void Update(T z_abs, T var_z_abs, T dt) {
+    const T dt2 = dt * dt;
+    auto f = StateMatrix::Identity();
+    f(0, 1) = dt;
+    f(0, 2) = dt2 / 2;
+    f(1, 2) = dt;
+    Vector<T, 3> g{};
+    g(0, 0) = dt2 * dt / 6;
+    g(1, 0) = dt2 / 2;
+    g(2, 0) = dt;
+    Matrix<T, 1, 1> var{};
+    var(0, 0) = var_x_jerk_;
+    filter_.Predict(f, g * var * Transpose(g));
+
+    typename Filter::MeasVector z{};
+    z(0, 0) = z_abs;
+    typename Filter::MeasMatrix h{};
+    h(0, 0) = 1;
+    typename Filter::MeasCovariance r{};
+    r(0, 0) = var_z_abs;
+    filter_.Update(z, h, r);
+  }
+
+  T GetXAbs() const { return filter_.State()(0, 0); }
+  T GetXVel() const { return filter_.State()(1, 0); }
+  T GetInnovation() const { return filter_.Innovation()(0, 0); }
+  T GetPriorCovAbsAbs() const { return filter_.PriorMeasCovariance()(0, 0); }
+  T GetXAccel() const { return filter_.State()(2, 0); }
+
+ private:
+  Filter filter_;
+  T var_x_jerk_;
+  T var_x_vel_;
+  T var_x_accel_;
+};
+
+}  // namespace kalman
+
+#endif // KALMANFILTERN_H
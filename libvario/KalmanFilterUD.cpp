@@ -0,0 +1,82 @@
+#include "KalmanFilterUD.h"
+#include <assert.h>
+
+// Once the float offset from the origin exceeds this, it is folded into the
+// origin so that x_abs_ keeps its full relative precision.
+static constexpr float kMaxOffset = 1024;
+
+KalmanFilterUD::KalmanFilterUD(const float var_x_accel)
+  :var_x_accel_(var_x_accel)
+{
+  Reset();
+}
+
+KalmanFilterUD::KalmanFilterUD()
+  :var_x_accel_(1)
+{
+  Reset();
+}
+
+void KalmanFilterUD::Reset()
+{
+  Reset(0, 0);
+}
+
+void KalmanFilterUD::Reset(const double x_abs_value)
+{
+  Reset(x_abs_value, 0);
+}
+
+void KalmanFilterUD::Reset(const double x_abs_value, const float x_vel_value)
+{
+  origin_ = x_abs_value;
+  x_abs_ = 0;
+  x_vel_ = x_vel_value;
+  u_ = 0;
+  d_abs_ = 1.e6f;
+  d_vel_ = var_x_accel_;
+}
+
+void KalmanFilterUD::Update(const double z_abs, const float var_z_abs, const float dt)
+{
+  // Validity checks.
+  assert(dt > 0);
+  assert(var_z_abs > 0);
+
+  // Predict step.
+  // Update state estimate.
+  x_abs_ += x_vel_ * dt;
+  // Update the factors of F P F' + Q. With W = [F U | G] and weights
+  // diag(d_abs_, d_vel_, var_x_accel_), where G = [dt^2/2, dt]' is the
+  // acceleration noise input, orthogonalize the rows of W bottom-up.
+  const float dt2_2 = dt * dt / 2;
+  const float w_abs_vel = u_ + dt;  // Row 0 of W is [1, u + dt, dt^2/2].
+  const float d_vel = d_vel_ + var_x_accel_ * dt * dt;  // Row 1 is [0, 1, dt].
+  const float u = (d_vel_ * w_abs_vel + var_x_accel_ * dt * dt2_2) / d_vel;
+  const float v_vel = w_abs_vel - u;
+  const float v_noise = dt2_2 - u * dt;
+  d_abs_ += d_vel_ * v_vel * v_vel + var_x_accel_ * v_noise * v_noise;
+  d_vel_ = d_vel;
+  u_ = u;
+
+  // Update step (Bierman). For H = [1 0]: f = U'H' = [1, u], v = D f.
+  const auto y = static_cast<float>(z_abs - origin_) - x_abs_;  // Innovation.
+  const float alpha_abs = var_z_abs + d_abs_;
+  const float alpha = alpha_abs + d_vel_ * u_ * u_;  // Innovation variance.
+  const float alpha_inv = 1 / alpha;
+  const float k_abs = (d_abs_ + d_vel_ * u_ * u_) * alpha_inv;  // Kalman gain
+  const float k_vel = d_vel_ * u_ * alpha_inv;
+  // Update state estimate.
+  x_abs_ += k_abs * y;
+  x_vel_ += k_vel * y;
+  // Update state covariance factors.
+  const float alpha_abs_inv = 1 / alpha_abs;
+  d_vel_ *= alpha_abs * alpha_inv;
+  u_ *= var_z_abs * alpha_abs_inv;
+  d_abs_ *= var_z_abs * alpha_abs_inv;
+
+  if (x_abs_ > kMaxOffset || x_abs_ < -kMaxOffset) {
+    origin_ += x_abs_;
+    x_abs_ = 0;
+  }
+}
@@ -0,0 +1,64 @@
+#ifndef KALMANFILTERUD_H
+#define KALMANFILTERUD_H
+
+// Single-precision version of KalmanFilter that keeps the covariance in U-D
+// factorized form, P = U D U', with U unit upper triangular and D diagonal.
+//
+// A naive float port of KalmanFilter::Update() breaks down because the
+// covariance update subtracts nearly equal numbers: right after Reset()
+// p_abs_abs_ is 1e6 and must drop to roughly the measurement variance in one
+// step, which leaves no significant bits in float. In U-D form the predict
+// step (Thornton's modified weighted Gram-Schmidt, using the fact that the
+// process noise is rank one) and the measurement step (Bierman's update) only
+// ever add non-negative terms or scale by ratios, so D stays positive and the
+// filter stays stable at high update rates.
+//
+// Float also cannot resolve small steps of a large absolute value (pressure
+// in Pa is ~1e5), so the absolute quantity is tracked relative to an origin
+// held in double that is moved whenever the float offset grows large.
+class KalmanFilterUD {
+  // The state we are tracking, x_abs_ being relative to origin_.
+  double origin_;
+  float x_abs_;
+  float x_vel_;
+
+  // Factors of the state covariance.
+  float u_;      // Upper off-diagonal element of U.
+  float d_abs_;  // Diagonal of D.
+  float d_vel_;
+
+  // The variance of the acceleration noise input to the system model, in units
+  // per second squared.
+  float var_x_accel_;
+
+ public:
+  KalmanFilterUD(float var_x_accel);
+  KalmanFilterUD();
+
+  // Same semantics as the KalmanFilter methods of the same name.
+  void Reset();
+  void Reset(double x_abs_value);
+  void Reset(double x_abs_value, float x_vel_value);
+
+  void SetAccelerationVariance(float var_x_accel) {
+    var_x_accel_ = var_x_accel;
+  }
+
+  /**
+   * Updates state given a direct sensor measurement of the absolute
+   * quantity x, the variance of that measurement, and the interval
+   * since the last measurement in seconds. This interval must be
+   * greater than 0; for the first measurement after a Reset(), it's
+   * safe to use 1.0.
+   */
+  void Update(double z_abs, float var_z_abs, float dt);
+
+  // Getters for the state and its covariance.
+  double GetXAbs() const { return origin_ + x_abs_; }
+  float GetXVel() const { return x_vel_; }
+  float GetCovAbsAbs() const { return d_abs_ + u_ * u_ * d_vel_; }
+  float GetCovAbsVel() const { return u_ * d_vel_; }
+  float GetCovVelVel() const { return d_vel_; }
+};
+
+#endif // KALMANFILTERUD_H
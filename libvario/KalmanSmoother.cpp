@@ -0,0 +1,115 @@
+#include "KalmanSmoother.h"
+#include <assert.h>
+
+KalmanSmoother::KalmanSmoother(const double var_x_accel, const double var_z_abs,
+                               const std::size_t chunk_size)
+  :var_x_accel_(var_x_accel), var_z_abs_(var_z_abs),
+   chunk_size_(chunk_size > 0 ? chunk_size : 1)
+{
+}
+
+void KalmanSmoother::Smooth(const double* z_abs, const std::size_t n, const double dt,
+                            double* x_abs_out, double* x_vel_out)
+{
+  assert(dt > 0);
+  Run(z_abs, n, nullptr, dt, x_abs_out, x_vel_out);
+}
+
+void KalmanSmoother::Smooth(const double* z_abs, const std::size_t n, const double* dt,
+                            double* x_abs_out, double* x_vel_out)
+{
+  Run(z_abs, n, dt, 0, x_abs_out, x_vel_out);
+}
+
+void KalmanSmoother::Run(const double* z_abs, const std::size_t n,
+                         const double* dt_array, const double dt,
+                         double* x_abs_out, double* x_vel_out)
+{
+  if (n == 0)
+    return;
+
+  // The first interval only feeds a prediction that the huge initial
+  // variance wipes out again, so any positive value will do.
+  auto interval = [&](std::size_t k) {
+    return dt_array ? (k > 0 ? dt_array[k] : 1.0) : dt;
+  };
+
+  // Forward pass: filter everything, keeping a checkpoint of the filter just
+  // before the first sample of every chunk.
+  const std::size_t chunks = (n + chunk_size_ - 1) / chunk_size_;
+  checkpoints_.clear();
+  checkpoints_.reserve(chunks);
+
+  KalmanFilter filter(var_x_accel_);
+  filter.Reset(z_abs[0]);
+  for (std::size_t k = 0; k < n; ++k) {
+    if (k % chunk_size_ == 0)
+      checkpoints_.push_back(filter);
+    filter.Update(z_abs[k], var_z_abs_, interval(k));
+  }
+
+  chunk_.resize(chunk_size_);
+
+  // Backward pass, one chunk at a time from the end of the series.
+  double next_abs = 0;  // Smoothed state of sample k + 1.
+  double next_vel = 0;
+  for (std::size_t c = chunks; c-- > 0;) {
+    const std::size_t begin = c * chunk_size_;
+    const std::size_t end = begin + chunk_size_ < n ? begin + chunk_size_ : n;
+
+    // Replay the chunk from its checkpoint to recover the filtered states.
+    filter = checkpoints_[c];
+    for (std::size_t k = begin; k < end; ++k) {
+      filter.Update(z_abs[k], var_z_abs_, interval(k));
+      chunk_[k - begin] = {filter.GetXAbs(), filter.GetXVel(),
+                           filter.GetCovAbsAbs(), filter.GetCovAbsVel(),
+                           filter.GetCovVelVel()};
+    }
+
+    for (std::size_t k = end; k-- > begin;) {
+      const Filtered& f = chunk_[k - begin];
+      double s_abs = f.x_abs;
+      double s_vel = f.x_vel;
+
+      if (k + 1 < n) {
+        // Predict k -> k + 1 exactly as KalmanFilter::Update() does.
+        const double t = interval(k + 1);
+        const double t2 = Square(t);
+        const double t3 = t * t2;
+        const double t4 = Square(t2);
+        const double xp_abs = f.x_abs + f.x_vel * t;
+        const double xp_vel = f.x_vel;
+        const double pp_aa = f.p_abs_abs + 2 * t * f.p_abs_vel + t2 * f.p_vel_vel
+                             + var_x_accel_ * t4 / 4;
+        const double pp_av = f.p_abs_vel + t * f.p_vel_vel + var_x_accel_ * t3 / 2;
+        const double pp_vv = f.p_vel_vel + var_x_accel_ * t2;
+
+        // Smoother gain C = P F' Pp^-1.
+        const double pf_aa = f.p_abs_abs + t * f.p_abs_vel;  // P F'
+        const double pf_av = f.p_abs_vel;
+        const double pf_va = f.p_abs_vel + t * f.p_vel_vel;
+        const double pf_vv = f.p_vel_vel;
+        const double det_inv = 1 / (pp_aa * pp_vv - Square(pp_av));
+        const double i_aa = pp_vv * det_inv;
+        const double i_av = -pp_av * det_inv;
+        const double i_vv = pp_aa * det_inv;
+        const double c_aa = pf_aa * i_aa + pf_av * i_av;
+        const double c_av = pf_aa * i_av + pf_av * i_vv;
+        const double c_va = pf_va * i_aa + pf_vv * i_av;
+        const double c_vv = pf_va * i_av + pf_vv * i_vv;
+
+        const double d_abs = next_abs - xp_abs;
+        const double d_vel = next_vel - xp_vel;
+        s_abs += c_aa * d_abs + c_av * d_vel;
+        s_vel += c_va * d_abs + c_vv * d_vel;
+      }
+
+      if (x_abs_out)
+        x_abs_out[k] = s_abs;
+      if (x_vel_out)
+        x_vel_out[k] = s_vel;
+      next_abs = s_abs;
+      next_vel = s_vel;
+    }
+  }
+}
@@ -0,0 +1,65 @@
+#ifndef KALMANSMOOTHER_H
+#define KALMANSMOOTHER_H
+
+#include <cstddef>
+#include <vector>
+#include "KalmanFilter.h"
+
+// Offline Rauch-Tung-Striebel smoother for recorded pressure or altitude
+// series, built on the same 2-state model as KalmanFilter.
+//
+// A plain RTS smoother keeps the filtered state and covariance of every
+// sample for its backward pass. To keep memory bounded on long recordings we
+// only store a KalmanFilter checkpoint every chunk_size samples during the
+// forward pass. The backward pass then walks the chunks from last to first,
+// replays each one forward from its checkpoint into a chunk-sized buffer and
+// smooths it backwards, carrying the smoothed state across chunk boundaries.
+// Working memory is O(n / chunk_size + chunk_size) and the cost is two
+// forward passes plus one backward pass, all linear in n.
+//
+// The smoothed rate has no lag, which makes it a reference climb-rate curve
+// for judging and tuning the real-time filter.
+class KalmanSmoother {
+  // Filtered state and covariance of one sample, as held in the chunk buffer.
+  struct Filtered {
+    double x_abs;
+    double x_vel;
+    double p_abs_abs;
+    double p_abs_vel;
+    double p_vel_vel;
+  };
+
+  double var_x_accel_;
+  double var_z_abs_;
+  std::size_t chunk_size_;
+
+  std::vector<KalmanFilter> checkpoints_;
+  std::vector<Filtered> chunk_;
+
+  void Run(const double* z_abs, std::size_t n, const double* dt_array,
+           double dt, double* x_abs_out, double* x_vel_out);
+
+ public:
+  // var_x_accel and var_z_abs have the same meaning as for KalmanFilter;
+  // chunk_size trades memory for nothing but cache locality, so the default
+  // is fine for anything from a minute to a day of data.
+  KalmanSmoother(double var_x_accel, double var_z_abs,
+                 std::size_t chunk_size = 4096);
+
+  /**
+   * Smooths n measurements taken every dt seconds. The smoothed absolute
+   * quantity and its rate are written to x_abs_out and x_vel_out, each of
+   * which may be null and otherwise must hold n entries.
+   */
+  void Smooth(const double* z_abs, std::size_t n, double dt,
+              double* x_abs_out, double* x_vel_out);
+
+  /**
+   * Same as above for irregularly sampled series: dt[k] is the interval in
+   * seconds between measurements k-1 and k (dt[0] is ignored).
+   */
+  void Smooth(const double* z_abs, std::size_t n, const double* dt,
+              double* x_abs_out, double* x_vel_out);
+};
+
+#endif // KALMANSMOOTHER_H
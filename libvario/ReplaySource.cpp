@@ -0,0 +1,41 @@
+#include "ReplaySource.h"
+
+ReplaySource::ReplaySource(SensorBus* bus)
+  :SampleSource(bus)
+{
+}
+
+ReplaySource::~ReplaySource()
+{
+  Stop();
+}
+
+bool ReplaySource::Open(const std::string& path)
+{
+  return reader_.Open(path);
+}
+
+void ReplaySource::Run()
+{
+  CaptureRecord record;
+  bool ok = true;
+  while (ok && !StopRequested() && reader_.Next(record)) {
+    switch (record.type) {
+      case capture::kPressure:
+        Pace(record.pressure.timestamp);
+        ok = Push(bus_->pressure, record.pressure);
+        break;
+      case capture::kAccel:
+        Pace(record.accel.timestamp);
+        ok = Push(bus_->accel, record.accel);
+        break;
+      case capture::kTemperature:
+        Pace(record.temperature.timestamp);
+        ok = Push(bus_->temperature, record.temperature);
+        break;
+      case capture::kGps:
+        ok = Push(bus_->gps, record.gps);
+        break;
+    }
+  }
+}
@@ -0,0 +1,26 @@
+#ifndef REPLAYSOURCE_H
+#define REPLAYSOURCE_H
+
+#include <string>
+#include "CaptureReader.h"
+#include "SampleSource.h"
+
+// Plays a capture file back into a SensorBus, standing in for SensorManager
+// and ReadGps, so the rest of the app runs exactly as it would in flight.
+// Pacing and speed are those of SampleSource; GPS fix times use a different
+// clock, so fixes do not pace the replay and are released in recorded order.
+class ReplaySource : public SampleSource {
+ public:
+  explicit ReplaySource(SensorBus* bus);
+  ~ReplaySource() override;
+
+  bool Open(const std::string& path);
+
+ protected:
+  void Run() override;
+
+ private:
+  CaptureReader reader_;
+};
+
+#endif // REPLAYSOURCE_H
@@ -0,0 +1,63 @@
+#include "SampleSource.h"
+
+SampleSource::SampleSource(SensorBus* bus)
+  :bus_(bus)
+{
+}
+
+SampleSource::~SampleSource()
+{
+  Stop();
+}
+
+void SampleSource::Start(const double speed)
+{
+  Stop();
+  speed_ = speed > 0 ? speed : 0;
+  stop_.store(false);
+  finished_.store(false);
+  samples_.store(0);
+  recorded_us_.store(0);
+  elapsed_us_.store(0);
+  clock_started_ = false;
+  last_timestamp_ = 0;
+  thread_ = std::thread(&SampleSource::Main, this);
+}
+
+void SampleSource::Stop()
+{
+  stop_.store(true);
+  if (thread_.joinable())
+    thread_.join();
+}
+
+void SampleSource::Pace(const std::uint64_t timestamp)
+{
+  // The virtual clock advances by the gaps between sensor timestamps. A clock
+  // that went backwards (e.g. a capture spanning a reboot) just does not
+  // advance it, rather than stalling playback.
+  if (!clock_started_) {
+    wall_origin_ = std::chrono::steady_clock::now();
+    clock_started_ = true;
+  } else if (timestamp > last_timestamp_) {
+    recorded_us_.fetch_add(timestamp - last_timestamp_, std::memory_order_relaxed);
+  }
+  last_timestamp_ = timestamp;
+
+  if (speed_ > 0) {
+    const auto due = std::chrono::microseconds(
+        static_cast<std::int64_t>(recorded_us_.load(std::memory_order_relaxed) / speed_));
+    std::this_thread::sleep_until(wall_origin_ + due);
+  }
+}
+
+void SampleSource::Main()
+{
+  Run();
+
+  if (clock_started_) {
+    elapsed_us_.store(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - wall_origin_).count(), std::memory_order_relaxed);
+  }
+  finished_.store(true, std::memory_order_release);
+}
@@ -0,0 +1,88 @@
+#ifndef SAMPLESOURCE_H
+#define SAMPLESOURCE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include "SensorSamples.h"
+
+// Base of the sources that stand in for the real sensors (capture replay,
+// simulated flight): a background thread producing samples into a SensorBus
+// on a virtual clock.
+//
+// Samples carry their own timestamps, so the filters see the intended dt
+// whatever the playback speed. The virtual clock, paced by the sensor
+// timestamps, decides when each sample is released: speed 1 is real time, N
+// is N times faster, and 0 releases samples as fast as the consumer takes
+// them. Unlike a live sensor, an injected source never drops samples: when a
+// ring is full the producer waits for the consumer.
+class SampleSource {
+ public:
+  explicit SampleSource(SensorBus* bus);
+
+  // Derived classes must call Stop() in their destructor, before the members
+  // Run() uses are destroyed.
+  virtual ~SampleSource();
+
+  SampleSource(const SampleSource&) = delete;
+  SampleSource& operator=(const SampleSource&) = delete;
+
+  /**
+   * Starts producing on a background thread. speed is the multiple of real
+   * time, or 0 for as fast as possible.
+   */
+  void Start(double speed);
+  void Stop();
+
+  bool IsFinished() const { return finished_.load(std::memory_order_acquire); }
+  std::uint64_t Samples() const { return samples_.load(std::memory_order_relaxed); }
+
+  // Sensor time produced so far, and the wall time production took once
+  // finished, in seconds.
+  double RecordedSeconds() const { return recorded_us_.load(std::memory_order_relaxed) * 1e-6; }
+  double ElapsedSeconds() const { return elapsed_us_.load(std::memory_order_relaxed) * 1e-6; }
+
+ protected:
+  // Produces samples until done or StopRequested(); runs on the source thread.
+  virtual void Run() = 0;
+
+  bool StopRequested() const { return stop_.load(std::memory_order_relaxed); }
+
+  // Advances the virtual clock to a sensor timestamp, sleeping as needed.
+  void Pace(std::uint64_t timestamp);
+
+  template<typename T, std::size_t N>
+  bool Push(SpscRing<T, N>& ring, const T& sample) {
+    // Only this thread adds to the ring, so once there is room the push succeeds.
+    while (ring.Size() == N) {
+      if (StopRequested())
+        return false;
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    ring.Push(sample);
+    samples_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  SensorBus* bus_;
+
+ private:
+  void Main();
+
+  double speed_ = 1.0;
+  std::thread thread_;
+  std::atomic<bool> stop_{false};
+  std::atomic<bool> finished_{false};
+  std::atomic<std::uint64_t> samples_{0};
+
+  // Virtual clock: sensor time since the first sample, and the wall time at
+  // which that sample was released.
+  bool clock_started_ = false;
+  std::uint64_t last_timestamp_ = 0;
+  std::chrono::steady_clock::time_point wall_origin_;
+  std::atomic<std::uint64_t> recorded_us_{0};
+  std::atomic<std::int64_t> elapsed_us_{0};
+};
+
+#endif // SAMPLESOURCE_H
@@ -0,0 +1,77 @@
+#include "SampleStatistics.h"
+#include <algorithm>
+#include <cmath>
+
+SampleStatistics::SampleStatistics(const double bin_width, const double dropout_factor)
+  :bin_width_(bin_width),
+   dropout_factor_(dropout_factor)
+{
+  Reset();
+}
+
+void SampleStatistics::Reset()
+{
+  started_ = false;
+  last_ = 0;
+  NewWindow();
+}
+
+void SampleStatistics::NewWindow()
+{
+  samples_ = 0;
+  duplicates_ = 0;
+  backwards_ = 0;
+  dropouts_ = 0;
+  missed_ = 0;
+  intervals_ = 0;
+  mean_ = 0;
+  m2_ = 0;
+  min_ = 0;
+  max_ = 0;
+  std::fill(histogram_, histogram_ + kHistogramBins, 0);
+}
+
+double SampleStatistics::Add(const std::uint64_t timestamp)
+{
+  if (started_ && timestamp == last_) {
+    ++duplicates_;
+    return 0;
+  }
+  if (started_ && timestamp < last_) {
+    ++backwards_;
+    last_ = timestamp;
+    return 0;
+  }
+
+  ++samples_;
+  const bool first = !started_;
+  const double interval = static_cast<double>(timestamp - last_);
+  started_ = true;
+  last_ = timestamp;
+  if (first)
+    return 0;
+
+  const std::size_t bin = static_cast<std::size_t>(interval / bin_width_);
+  ++histogram_[std::min(bin, kHistogramBins - 1)];
+
+  // A gap is not part of the sensor's regular timing, so keep it out of the
+  // mean and jitter; otherwise a single stall would mask the next ones.
+  if (intervals_ >= kSettleIntervals && interval > dropout_factor_ * mean_) {
+    ++dropouts_;
+    missed_ += static_cast<std::uint64_t>(std::lround(interval / mean_)) - 1;
+  } else {
+    ++intervals_;
+    const double delta = interval - mean_;
+    mean_ += delta / intervals_;
+    m2_ += delta * (interval - mean_);
+    min_ = intervals_ == 1 ? interval : std::min(min_, interval);
+    max_ = intervals_ == 1 ? interval : std::max(max_, interval);
+  }
+
+  return interval * 1e-6;
+}
+
+double SampleStatistics::Jitter() const
+{
+  return intervals_ > 1 ? std::sqrt(m2_ / (intervals_ - 1)) : 0;
+}
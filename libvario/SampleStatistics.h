@@ -0,0 +1,89 @@
+#ifndef SAMPLESTATISTICS_H
+#define SAMPLESTATISTICS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Timing health of one sensor stream, fed with the sample timestamps in
+// microseconds. Tracks the inter-sample interval histogram, the mean and
+// jitter (standard deviation) of the interval, duplicated timestamps, and
+// dropouts: gaps long enough that samples must have been lost on the way.
+//
+// Add() also returns the interval to the previous sample, which is the dt
+// the filters should use; it comes from the sensor clock, so queueing delay
+// and UI stalls between the sensor and the consumer do not leak into it.
+//
+// NewWindow() starts the figures over without losing the previous timestamp,
+// so periodic reports can show current behaviour: after a lasting change of
+// the rate, the mean follows within one window instead of counting every
+// interval of the new rate as a dropout for the rest of the session.
+class SampleStatistics {
+ public:
+  static constexpr std::size_t kHistogramBins = 64;
+
+  /**
+   * bin_width is the histogram resolution in microseconds; the last bin
+   * collects every longer interval. A gap of more than dropout_factor times
+   * the mean interval counts as a dropout.
+   */
+  explicit SampleStatistics(double bin_width = 1000.0, double dropout_factor = 1.8);
+
+  void Reset();
+
+  // Clears every figure but keeps the last timestamp, so the next Add()
+  // still returns its interval.
+  void NewWindow();
+
+  /**
+   * Records a sample and returns the time since the previous one in seconds.
+   * Returns 0 for the first sample, a duplicate, or a timestamp that went
+   * backwards; the latter restarts the interval measurement.
+   */
+  double Add(std::uint64_t timestamp);
+
+  bool Started() const { return started_; }   // Any sample since Reset()
+  std::uint64_t Samples() const { return samples_; }
+  std::uint64_t Last() const { return last_; }  // Latest timestamp, 0 before the first
+  std::uint64_t Duplicates() const { return duplicates_; }
+  std::uint64_t Backwards() const { return backwards_; }
+
+  // Number of gaps, and the estimated number of samples lost in them.
+  std::uint64_t Dropouts() const { return dropouts_; }
+  std::uint64_t MissedSamples() const { return missed_; }
+
+  // Interval statistics in microseconds, over the regular (non-dropout) intervals.
+  double MeanInterval() const { return mean_; }
+  double Jitter() const;
+  double MinInterval() const { return intervals_ ? min_ : 0; }
+  double MaxInterval() const { return intervals_ ? max_ : 0; }
+  double Rate() const { return mean_ > 0 ? 1e6 / mean_ : 0; }  // Hz
+
+  double BinWidth() const { return bin_width_; }
+  std::uint64_t Histogram(std::size_t bin) const { return histogram_[bin]; }
+
+ private:
+  // Intervals needed before the mean is trusted to detect dropouts.
+  static constexpr std::uint64_t kSettleIntervals = 10;
+
+  double bin_width_;
+  double dropout_factor_;
+
+  bool started_;
+  std::uint64_t last_;
+  std::uint64_t samples_;
+  std::uint64_t duplicates_;
+  std::uint64_t backwards_;
+  std::uint64_t dropouts_;
+  std::uint64_t missed_;
+
+  // Welford's running mean and sum of squared deviations.
+  std::uint64_t intervals_;
+  double mean_;
+  double m2_;
+  double min_;
+  double max_;
+
+  std::uint64_t histogram_[kHistogramBins];
+};
+
+#endif // SAMPLESTATISTICS_H
@@ -0,0 +1,57 @@
+#ifndef SENSORSAMPLES_H
+#define SENSORSAMPLES_H
+
+#include <cstdint>
+#include "SpscRing.h"
+
+// Plain sample types passed from the sensor sources to the consumers. They
+// are trivially copyable so they can travel through the lock-free rings below
+// without allocation or metatype marshaling. Timestamps are in microseconds,
+// as reported by QSensorReading::timestamp() or derived from the GPS fix time.
+
+struct PressureSample {
+  std::uint64_t timestamp;
+  double pressure;      // Pa
+  double temperature;   // Celsius, from the pressure sensor
+};
+
+struct AccelSample {
+  std::uint64_t timestamp;
+  double x;             // Raw device-frame acceleration, m/s^2
+  double y;
+  double z;
+  double roll;          // Degrees, from the attitude estimate
+  double pitch;
+  double vertical;      // Earth-frame vertical acceleration with gravity removed, m/s^2
+  double qw;            // Device-to-earth attitude quaternion (AttitudeEstimator)
+  double qx;
+  double qy;
+  double qz;
+  double heading;       // Tilt-compensated magnetic heading in degrees, NaN without a magnetometer
+};
+
+struct TemperatureSample {
+  std::uint64_t timestamp;
+  double temperature;   // Celsius, from the ambient temperature sensor
+};
+
+struct GpsFix {
+  std::uint64_t timestamp;
+  double latitude;      // Degrees
+  double longitude;
+  double altitude;      // m
+  double heading;       // Course over ground in degrees, NaN if unknown
+  double speed;         // Ground speed in km/h, NaN if unknown
+};
+
+// One ring per sample type. The sensor thread produces pressure,
+// acceleration and temperature, the GPS source produces fixes, and a single
+// consumer drains all of them in batches.
+struct SensorBus {
+  SpscRing<PressureSample, 256> pressure;
+  SpscRing<AccelSample, 256> accel;
+  SpscRing<TemperatureSample, 16> temperature;
+  SpscRing<GpsFix, 16> gps;
+};
+
+#endif // SENSORSAMPLES_H
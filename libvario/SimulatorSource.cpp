@@ -0,0 +1,61 @@
+#include "SimulatorSource.h"
+#include <algorithm>
+#include <cmath>
+
+SimulatorSource::SimulatorSource(SensorBus* bus, const FlightSettings& settings,
+                                 std::vector<AirMass> script)
+  :SampleSource(bus),
+   settings_(settings),
+   model_(settings, std::move(script))
+{
+}
+
+SimulatorSource::~SimulatorSource()
+{
+  Stop();
+}
+
+void SimulatorSource::Run()
+{
+  // Sensor periods in us; a rate of 0 switches that sensor off
+  auto period = [](double rate) {
+    return rate > 0 ? static_cast<std::uint64_t>(std::llround(1e6 / rate)) : UINT64_MAX;
+  };
+  const std::uint64_t pressure_period = period(settings_.pressure_rate);
+  const std::uint64_t accel_period = period(settings_.accel_rate);
+  const std::uint64_t temperature_period = period(settings_.temperature_rate);
+
+  const std::uint64_t end = kStartTimestamp + static_cast<std::uint64_t>(model_.Duration() * 1e6);
+  auto first = [](std::uint64_t period) {
+    return period == UINT64_MAX ? UINT64_MAX : kStartTimestamp;
+  };
+  std::uint64_t now = kStartTimestamp;
+  std::uint64_t next_pressure = first(pressure_period);
+  std::uint64_t next_accel = first(accel_period);
+  std::uint64_t next_temperature = first(temperature_period);
+
+  bool ok = true;
+  while (ok && !StopRequested()) {
+    const std::uint64_t due = std::min({next_pressure, next_accel, next_temperature});
+    if (due > end)
+      break;
+
+    model_.Advance((due - now) * 1e-6);
+    now = due;
+    Pace(now);
+
+    if (next_accel == now) {
+      ok = Push(bus_->accel, model_.ReadAccel(now));
+      next_accel += accel_period;
+    }
+    if (ok && next_pressure == now) {
+      ok = Push(bus_->pressure, model_.ReadPressure(now));
+      truth_.Push(model_.Truth(now));
+      next_pressure += pressure_period;
+    }
+    if (ok && next_temperature == now) {
+      ok = Push(bus_->temperature, model_.ReadTemperature(now));
+      next_temperature += temperature_period;
+    }
+  }
+}
@@ -0,0 +1,36 @@
+#ifndef SIMULATORSOURCE_H
+#define SIMULATORSOURCE_H
+
+#include <vector>
+#include "FlightModel.h"
+#include "SampleSource.h"
+
+// Feeds a SensorBus with the readings of a simulated flight (see
+// FlightModel), standing in for SensorManager on machines without sensors
+// and as a repeatable load generator: at speed 0 it produces samples as fast
+// as the app can take them.
+//
+// Each sensor ticks at its own rate from FlightSettings. Alongside every
+// pressure sample the true state of the flight goes into Truth(); that ring
+// is optional to read, when nobody drains it the truth is simply dropped.
+class SimulatorSource : public SampleSource {
+ public:
+  SimulatorSource(SensorBus* bus, const FlightSettings& settings, std::vector<AirMass> script);
+  ~SimulatorSource() override;
+
+  SpscRing<TruthSample, 256>& Truth() { return truth_; }
+
+  double Duration() const { return model_.Duration(); }
+
+ protected:
+  void Run() override;
+
+ private:
+  static constexpr std::uint64_t kStartTimestamp = 1000000;  // us
+
+  FlightSettings settings_;
+  FlightModel model_;
+  SpscRing<TruthSample, 256> truth_;
+};
+
+#endif // SIMULATORSOURCE_H
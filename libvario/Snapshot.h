@@ -0,0 +1,70 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Latest value of a trivially copyable T, published by one writer thread and
+// read by any number of reader threads without locks (a seqlock). The writer
+// never waits, so a stalled reader cannot hold up the producer; a reader that
+// races a publication simply copies again. Unlike SpscRing it keeps no
+// history: readers that only care about the current state (a display, an
+// audio tone) skip whatever they were too slow to see.
+//
+// The value is stored in relaxed atomic words, so a torn copy is discarded
+// without ever being a data race.
+template<typename T>
+class Snapshot {
+  static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
+  static constexpr std::size_t kWords = (sizeof(T) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+
+  // Odd while a publication is in progress; twice the version otherwise.
+  alignas(64) std::atomic<std::uint64_t> sequence_{0};
+  std::atomic<std::uint64_t> words_[kWords] = {};
+
+ public:
+  // Writer side.
+  void Publish(const T& value) {
+    std::uint64_t words[kWords] = {};
+    std::memcpy(words, &value, sizeof(T));
+
+    const std::uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (std::size_t i = 0; i < kWords; ++i)
+      words_[i].store(words[i], std::memory_order_relaxed);
+    sequence_.store(sequence + 2, std::memory_order_release);
+  }
+
+  /**
+   * Reader side: copies the latest value into value and returns its version,
+   * the number of publications so far. Returns 0, leaving value untouched,
+   * if nothing has been published yet.
+   */
+  std::uint64_t Read(T& value) const {
+    std::uint64_t words[kWords];
+    for (;;) {
+      const std::uint64_t before = sequence_.load(std::memory_order_acquire);
+      if (before == 0)
+        return 0;
+      if (before & 1)
+        continue;
+      for (std::size_t i = 0; i < kWords; ++i)
+        words[i] = words_[i].load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence_.load(std::memory_order_relaxed) == before) {
+        std::memcpy(&value, words, sizeof(T));
+        return before / 2;
+      }
+    }
+  }
+
+  // Number of publications so far, to check for news without copying.
+  std::uint64_t Version() const {
+    return sequence_.load(std::memory_order_acquire) / 2;
+  }
+};
+
+#endif // SNAPSHOT_H
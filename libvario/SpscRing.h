@@ -0,0 +1,84 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Fixed-capacity lock-free ring buffer for exactly one producer thread and
+// one consumer thread. Storage is part of the object, so pushing and popping
+// never allocate. When the ring is full new samples are dropped and counted
+// rather than overwriting ones the consumer may be reading.
+template<typename T, std::size_t Capacity>
+class SpscRing {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two");
+  static constexpr std::size_t kMask = Capacity - 1;
+
+  // Producer and consumer indices live on separate cache lines so the two
+  // threads do not keep invalidating each other's line.
+  alignas(64) std::atomic<std::size_t> head_{0};  // Next slot to write.
+  alignas(64) std::atomic<std::size_t> tail_{0};  // Next slot to read.
+  alignas(64) std::atomic<std::uint64_t> dropped_{0};
+  T slots_[Capacity];
+
+ public:
+  static constexpr std::size_t kCapacity = Capacity;
+
+  // Producer side. Returns false (and counts a drop) if the ring is full.
+  bool Push(const T& value) {
+    const std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) == Capacity) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    slots_[head & kMask] = value;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side: oldest element, or null when empty. Valid until Pop().
+  const T* Front() const {
+    const std::size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire))
+      return nullptr;
+    return &slots_[tail & kMask];
+  }
+
+  // Consumer side: newest element, or null when empty. The producer never
+  // writes a slot the consumer has not released, so it stays valid until Pop().
+  const T* Back() const {
+    const std::size_t head = head_.load(std::memory_order_acquire);
+    if (tail_.load(std::memory_order_relaxed) == head)
+      return nullptr;
+    return &slots_[(head - 1) & kMask];
+  }
+
+  // Consumer side: discards the element returned by Front().
+  void Pop() {
+    tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  // Consumer side: hands every queued element to f in order, in one batch.
+  template<typename F>
+  std::size_t Drain(F&& f) {
+    std::size_t tail = tail_.load(std::memory_order_relaxed);
+    const std::size_t head = head_.load(std::memory_order_acquire);
+    const std::size_t count = head - tail;
+    for (; tail != head; ++tail)
+      f(slots_[tail & kMask]);
+    tail_.store(tail, std::memory_order_release);
+    return count;
+  }
+
+  std::size_t Size() const {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+  }
+
+  bool Empty() const { return Size() == 0; }
+
+  // Number of samples rejected because the consumer fell behind.
+  std::uint64_t Dropped() const { return dropped_.load(std::memory_order_relaxed); }
+};
+
+#endif // SPSCRING_H
@@ -0,0 +1,119 @@
+#include "TemperatureCompensator.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Prior variances of the fit: the offset is unknown, the coefficient is
+// trusted to a few Pa per Celsius when it came from calibration.
+constexpr double kOffsetVariance = 1e4;          // Pa^2
+constexpr double kCalibratedVariance = 1.0;      // (Pa/C)^2
+constexpr double kUncalibratedVariance = 100.0;
+
+}  // namespace
+
+TemperatureCompensator::TemperatureCompensator(const double coefficient, const double reference,
+                                               const bool learn, const double time_constant)
+  :initial_coefficient_(coefficient),
+   initial_reference_(reference),
+   learn_(learn),
+   time_constant_(time_constant)
+{
+  Reset();
+}
+
+void TemperatureCompensator::Reset()
+{
+  coefficient_ = initial_coefficient_;
+  reference_ = initial_reference_;
+  has_temperature_ = false;
+  correction_ = 0;
+  stationary_time_ = 0;
+  has_spread_ = false;
+  pressure_mean_ = 0;
+  pressure_var_ = 0;
+  ground_speed_ = 0;
+  ground_speed_age_ = kGroundSpeedMaxAge;
+  has_base_ = false;
+  offset_ = 0;
+  p00_ = kOffsetVariance;
+  p01_ = 0;
+  p11_ = initial_coefficient_ != 0 ? kCalibratedVariance : kUncalibratedVariance;
+  learned_ = 0;
+}
+
+void TemperatureCompensator::SetTemperature(const double celsius)
+{
+  if (std::isnan(celsius))
+    return;
+  if (!has_temperature_) {
+    if (std::isnan(reference_))
+      reference_ = celsius;
+    correction_ = coefficient_ * (celsius - reference_);
+    has_temperature_ = true;
+  } else {
+    correction_ += coefficient_ * (celsius - temperature_);
+  }
+  temperature_ = celsius;
+}
+
+void TemperatureCompensator::SetGroundSpeed(const double speed)
+{
+  ground_speed_ = speed;
+  ground_speed_age_ = 0;
+}
+
+double TemperatureCompensator::Correct(const double pressure, const double vario, const double dt)
+{
+  if (!has_temperature_)
+    return pressure;
+
+  if (learn_) {
+    // The spread is of the raw pressure: the drift is far too slow to show
+    // in it, while flying at zero sink the altitude still wanders by metres.
+    const double alpha = std::min(1.0, dt / kStationaryWindow);
+    const double deviation = has_spread_ ? pressure - pressure_mean_ : 0;
+    pressure_mean_ = has_spread_ ? pressure_mean_ + alpha * deviation : pressure;
+    pressure_var_ = (1 - alpha) * (pressure_var_ + alpha * deviation * deviation);
+    has_spread_ = true;
+
+    ground_speed_age_ += dt;
+    const bool moving = ground_speed_age_ < kGroundSpeedMaxAge && ground_speed_ > kStationarySpeed;
+    const bool stationary = std::fabs(vario) < kStationaryVario && !moving &&
+        pressure_var_ < kStationaryDeviation * kStationaryDeviation;
+    stationary_time_ = stationary ? stationary_time_ + dt : 0;
+    if (stationary_time_ >= kStationaryHold)
+      Learn(pressure, dt);
+  }
+  return pressure - correction_;
+}
+
+void TemperatureCompensator::Learn(const double pressure, const double dt)
+{
+  // Relative to the first learned sample, so the fit works on small numbers
+  if (!has_base_) {
+    base_ = pressure;
+    has_base_ = true;
+  }
+  const double x = temperature_ - reference_;
+  const double error = pressure - base_ - offset_ - coefficient_ * x;
+
+  // Forget only while the coefficient is better known than its prior, which
+  // needs the temperature to have moved; otherwise p11_ would grow without
+  // bound through a long constant-temperature stretch.
+  const double initial_p11 = initial_coefficient_ != 0 ? kCalibratedVariance : kUncalibratedVariance;
+  const double lambda = p11_ < initial_p11 ? 1.0 - dt / time_constant_ : 1.0;
+
+  const double g0 = p00_ + p01_ * x;     // P * [1, x]
+  const double g1 = p01_ + p11_ * x;
+  const double denominator = lambda + g0 + g1 * x;
+  const double k0 = g0 / denominator;
+  const double k1 = g1 / denominator;
+
+  offset_ += k0 * error;
+  coefficient_ = std::clamp(coefficient_ + k1 * error, -kMaxCoefficient, kMaxCoefficient);
+  p00_ = (p00_ - k0 * g0) / lambda;
+  p01_ = (p01_ - k0 * g1) / lambda;
+  p11_ = (p11_ - k1 * g1) / lambda;
+  ++learned_;
+}
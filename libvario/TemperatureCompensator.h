@@ -0,0 +1,99 @@
+#ifndef TEMPERATURECOMPENSATOR_H
+#define TEMPERATURECOMPENSATOR_H
+
+#include <cstdint>
+
+// Removes the temperature dependence of a barometer's reading. A phone that
+// warms up in the sun or in a pocket shifts the sensor's pressure output by
+// a few Pa per degree; over a warm-up of 10-20 degrees that is several metres
+// of altitude, and while it happens a slow false climb or sink. The model is
+// linear in the sensor's own temperature:
+//
+//   corrected = pressure - coefficient * (temperature - reference)
+//
+// applied incrementally: each temperature change adds the current
+// coefficient times that change to the correction. A coefficient that is
+// still being learned therefore only shapes the correction from then on and
+// never makes it jump, which the vario would show as a spike.
+//
+// The coefficient comes from calibration, and can be refined online by a
+// two-parameter recursive least squares fit of pressure against temperature
+// (plus an offset that absorbs the actual pressure). That fit is only fed
+// with the phone at rest on the ground: in flight the altitude changes would
+// be taken for drift. A vario near zero alone does not tell rest from flying
+// at zero sink, so for a while the pressure must also have stayed within a
+// few Pa of its short-term mean, as only sensor noise leaves it, and the GPS,
+// when it has a recent fix, must report the phone standing still.
+// A forgetting factor lets it follow an ageing sensor, but only while new
+// temperatures keep arriving, so a long stable stretch cannot wind the fit's
+// covariance up. Every sample costs O(1), a dozen multiply-adds when learning.
+class TemperatureCompensator {
+ public:
+  static constexpr double kStationaryVario = 0.3;   // m/s
+  static constexpr double kStationaryHold = 30.0;   // s all stationarity tests must pass
+  static constexpr double kStationaryDeviation = 5.0;   // Pa, pressure spread around its mean
+  static constexpr double kStationaryWindow = 10.0;     // s the spread is measured over
+  static constexpr double kStationarySpeed = 3.0;       // km/h of GPS ground speed
+  static constexpr double kGroundSpeedMaxAge = 5.0;     // s a ground speed stays valid
+  static constexpr double kMaxCoefficient = 50.0;   // Pa per Celsius, far beyond any real sensor
+
+  /**
+   * coefficient is in Pa per Celsius; a NaN reference means the first
+   * temperature seen. time_constant (s) is the fit's memory when learning.
+   */
+  TemperatureCompensator(double coefficient, double reference, bool learn,
+                         double time_constant = 600.0);
+
+  void Reset();
+
+  // Latest sensor temperature in Celsius; pressure passes unchanged until
+  // the first one arrives.
+  void SetTemperature(double celsius);
+
+  // Latest GPS ground speed in km/h, NaN if the fix has none; it takes part
+  // in the stationarity test for kGroundSpeedMaxAge seconds of samples.
+  void SetGroundSpeed(double speed);
+
+  /**
+   * Returns the corrected pressure (Pa) of a sample taken dt seconds after
+   * the previous one; vario is the current vertical speed, which decides
+   * whether the sample is used for learning.
+   */
+  double Correct(double pressure, double vario, double dt);
+
+  double Coefficient() const { return coefficient_; }
+  double Reference() const { return reference_; }
+  double Correction() const { return correction_; }   // Pa
+  bool HasTemperature() const { return has_temperature_; }
+  std::uint64_t LearnedSamples() const { return learned_; }
+
+ private:
+  void Learn(double pressure, double dt);
+
+  double initial_coefficient_;
+  double initial_reference_;
+  bool learn_;
+  double time_constant_;
+
+  double coefficient_;
+  double reference_;
+  double temperature_ = 0;
+  bool has_temperature_ = false;
+  double correction_ = 0;       // Pa subtracted from the pressure
+  double stationary_time_ = 0;
+  bool has_spread_ = false;
+  double pressure_mean_ = 0;    // Pa, exponential over kStationaryWindow
+  double pressure_var_ = 0;     // Pa^2, around pressure_mean_
+  double ground_speed_ = 0;     // km/h
+  double ground_speed_age_ = kGroundSpeedMaxAge;   // s since SetGroundSpeed()
+
+  // Fit state: pressure relative to base_ ~ offset_ + coefficient_ * dT,
+  // with covariance [p00_ p01_; p01_ p11_].
+  double base_ = 0;
+  bool has_base_ = false;
+  double offset_ = 0;
+  double p00_, p01_, p11_;
+  std::uint64_t learned_ = 0;
+};
+
+#endif // TEMPERATURECOMPENSATOR_H
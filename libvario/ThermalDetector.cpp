@@ -0,0 +1,225 @@
+#include "ThermalDetector.h"
+#include <cmath>
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kMetresPerDegree = 111195.0;   // Along a meridian
+
+double CourseDifference(const double a, const double b)
+{
+  double d = std::fmod(a - b, 360.0);
+  if (d > 180)
+    d -= 360;
+  else if (d <= -180)
+    d += 360;
+  return d;
+}
+
+}  // namespace
+
+ThermalDetector::ThermalDetector()
+{
+  Reset();
+}
+
+void ThermalDetector::Reset()
+{
+  vario_ = altitude_ = vario_sum_ = 0;
+  vario_count_ = 0;
+  has_fix_ = false;
+  last_time_ = 0;
+  last_course_ = turn_rate_ = 0;
+  circling_ = false;
+  state_time_ = 0;
+  candidate_time_ = now_ = 0;
+  candidate_altitude_ = 0;
+  current_ = last_ = ThermalStats();
+  has_last_ = false;
+  slot_ = slot_count_ = 0;
+  sum_weight_ = sum_x_ = sum_y_ = sum_t_ = 0;
+  time_ = turned_ = x_ = y_ = 0;
+  drift_x_ = drift_y_ = 0;
+}
+
+void ThermalDetector::UpdateVario(const double vario, const double altitude)
+{
+  vario_ = vario;
+  altitude_ = altitude;
+  vario_sum_ += vario;
+  ++vario_count_;
+}
+
+void ThermalDetector::UpdateFix(const std::uint64_t timestamp, const double latitude,
+                                const double longitude, const double course, const double speed)
+{
+  if (!std::isfinite(course) || !std::isfinite(speed))
+    return;
+
+  const double climb = vario_count_ > 0 ? vario_sum_ / vario_count_ : vario_;
+  vario_sum_ = 0;
+  vario_count_ = 0;
+
+  const double dt = has_fix_ && timestamp > last_time_ ? (timestamp - last_time_) * 1e-6 : 0;
+  const bool moving = speed >= kMinSpeed;
+  if (has_fix_ && (dt <= 0 || dt > kMaxFixGap)) {
+    // Out of order or after a gap: the course change means nothing
+    turn_rate_ = 0;
+  } else if (dt > 0) {
+    const double turn = moving ? CourseDifference(course, last_course_) : 0;
+    turned_ += turn;
+    turn_rate_ += (turn / dt - turn_rate_) * dt / (kTurnRateTime + dt);
+  }
+  has_fix_ = true;
+  last_time_ = timestamp;
+  if (moving)
+    last_course_ = course;
+  now_ = timestamp;
+
+  // Hysteresis: a change of state needs its condition to hold for a while,
+  // and then dates back to where the condition started.
+  const bool turning = std::fabs(turn_rate_) >= kCirclingTurnRate;
+  if (turning != circling_) {
+    if (state_time_ == 0) {
+      candidate_time_ = timestamp;
+      candidate_altitude_ = altitude_;
+    }
+    state_time_ += dt;
+    if (!circling_ && state_time_ >= kEnterTime) {
+      StartThermal();
+    } else if (circling_ && state_time_ >= kExitTime) {
+      EndThermal();
+    }
+  } else {
+    state_time_ = 0;
+  }
+
+  if (circling_) {
+    AddToCore(latitude, longitude, climb, dt);
+    UpdateStats(current_);
+  }
+}
+
+void ThermalDetector::StartThermal()
+{
+  circling_ = true;
+  state_time_ = 0;
+  current_ = ThermalStats();
+  current_.entry_time = candidate_time_;
+  current_.entry_altitude = candidate_altitude_;
+  current_.direction = turn_rate_ > 0 ? 1 : -1;
+
+  slot_ = slot_count_ = 0;
+  sum_weight_ = sum_x_ = sum_y_ = sum_t_ = 0;
+  time_ = turned_ = 0;
+  drift_x_ = drift_y_ = 0;
+  metres_per_degree_longitude_ = 0;   // Reference taken with the next position
+}
+
+void ThermalDetector::EndThermal()
+{
+  // The thermal ended where the turning stopped, not kExitTime later
+  circling_ = false;
+  state_time_ = 0;
+  last_ = current_;
+  last_.duration = (candidate_time_ - current_.entry_time) * 1e-6;
+  last_.gain = candidate_altitude_ - current_.entry_altitude;
+  last_.average_climb = last_.duration > 0 ? last_.gain / last_.duration : 0;
+  has_last_ = true;
+}
+
+void ThermalDetector::UpdateStats(ThermalStats& stats) const
+{
+  stats.duration = (now_ - stats.entry_time) * 1e-6;
+  stats.gain = altitude_ - stats.entry_altitude;
+  stats.average_climb = stats.duration > 0 ? stats.gain / stats.duration : 0;
+}
+
+void ThermalDetector::AddToCore(const double latitude, const double longitude,
+                                const double climb, const double dt)
+{
+  if (metres_per_degree_longitude_ == 0) {
+    reference_latitude_ = latitude;
+    reference_longitude_ = longitude;
+    metres_per_degree_longitude_ = kMetresPerDegree * std::cos(latitude * kPi / 180);
+  }
+
+  // Only lift says where the core is; sink weighs nothing
+  const double weight = climb > 0 ? climb * dt : 0;
+  time_ += dt;
+  x_ = (longitude - reference_longitude_) * metres_per_degree_longitude_;
+  y_ = (latitude - reference_latitude_) * kMetresPerDegree;
+
+  // Move on to a new slot once the current one is full; a full ring drops
+  // its oldest slot
+  if (slot_count_ == 0 || time_ - slots_[slot_].start_time >= kSlotSeconds) {
+    if (slot_count_ == kCoreSlots)
+      DropOldestSlot();
+    if (slot_count_ > 0)
+      slot_ = (slot_ + 1) % kCoreSlots;
+    ++slot_count_;
+    slots_[slot_] = {0, 0, 0, 0, x_, y_, time_, turned_};
+  }
+
+  Slot& slot = slots_[slot_];
+  slot.weight += weight;
+  slot.x += weight * x_;
+  slot.y += weight * y_;
+  slot.t += weight * time_;
+  sum_weight_ += weight;
+  sum_x_ += weight * x_;
+  sum_y_ += weight * y_;
+  sum_t_ += weight * time_;
+
+  // Keep just over one full circle: drop the oldest slot while the next one
+  // still reaches 360 degrees back. Each slot is dropped once, so this stays
+  // O(1) per fix on average.
+  while (slot_count_ > 1) {
+    const Slot& next = slots_[(slot_ + kCoreSlots - slot_count_ + 2) % kCoreSlots];
+    if (std::fabs(turned_ - next.start_turn) < 360)
+      break;
+    DropOldestSlot();
+  }
+  UpdateDrift();
+}
+
+void ThermalDetector::DropOldestSlot()
+{
+  const Slot& oldest = slots_[(slot_ + kCoreSlots - slot_count_ + 1) % kCoreSlots];
+  sum_weight_ -= oldest.weight;
+  sum_x_ -= oldest.x;
+  sum_y_ -= oldest.y;
+  sum_t_ -= oldest.t;
+  --slot_count_;
+}
+
+void ThermalDetector::UpdateDrift()
+{
+  // Over a whole circle the airspeed cancels out of the displacement. Course
+  // noise can make the window look a degree short now and then; the last
+  // drift then stays.
+  const Slot& oldest = slots_[(slot_ + kCoreSlots - slot_count_ + 1) % kCoreSlots];
+  const double span = time_ - oldest.start_time;
+  if (span <= 0 || std::fabs(turned_ - oldest.start_turn) < 360)
+    return;
+  drift_x_ = (x_ - oldest.start_x) / span;
+  drift_y_ = (y_ - oldest.start_y) / span;
+}
+
+bool ThermalDetector::HasCore() const
+{
+  // Subtracting old slots leaves rounding dust rather than an exact 0
+  return circling_ && sum_weight_ > 1e-6;
+}
+
+double ThermalDetector::CoreLatitude() const
+{
+  const double age = time_ - sum_t_ / sum_weight_;
+  return reference_latitude_ + (sum_y_ / sum_weight_ + drift_y_ * age) / kMetresPerDegree;
+}
+
+double ThermalDetector::CoreLongitude() const
+{
+  const double age = time_ - sum_t_ / sum_weight_;
+  return reference_longitude_ + (sum_x_ / sum_weight_ + drift_x_ * age) / metres_per_degree_longitude_;
+}
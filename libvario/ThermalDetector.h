@@ -0,0 +1,133 @@
+#ifndef THERMALDETECTOR_H
+#define THERMALDETECTOR_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Statistics of one thermal, from the start of the circling that found it.
+struct ThermalStats {
+  std::uint64_t entry_time = 0;   // GPS timestamp of the first turn, us
+  double entry_altitude = 0;      // m
+  double duration = 0;            // s
+  double gain = 0;                // Height gained since entry, m
+  double average_climb = 0;       // gain / duration, m/s
+  int direction = 0;              // 1 circling right, -1 left
+};
+
+// Finds circling flight in the GPS course and keeps statistics of the
+// thermal being worked, plus an estimate of where its core is.
+//
+// Circling is a smoothed turn rate above kCirclingTurnRate for kEnterTime,
+// and ends after kExitTime below it, so an S-turn or a single 360 on the
+// glide does not count. Times are measured on the GPS clock; the vario
+// samples in between only have to be in order, so the two clocks never
+// need to agree.
+//
+// The core is the climb-weighted centroid of the positions flown during the
+// last full circle (360 degrees of course change), kept as running sums over
+// a fixed ring of time slots. Older slots fall out of the sums as new ones
+// come in. A thermal drifts with the wind, and so does the circle; over one
+// full turn the track's displacement is that drift alone, so the centroid,
+// which describes where the core was on average, is moved on by the drift
+// since. Every fix and every vario sample is O(1) amortized work and nothing
+// allocates, whatever the GPS rate.
+class ThermalDetector {
+ public:
+  static constexpr double kCirclingTurnRate = 5.0;   // deg/s
+  static constexpr double kTurnRateTime = 2.0;       // s, smoothing of the turn rate
+  static constexpr double kEnterTime = 8.0;          // s
+  static constexpr double kExitTime = 10.0;          // s
+  static constexpr double kMinSpeed = 10.0;          // km/h, below it the course is noise
+  static constexpr double kMaxFixGap = 5.0;          // s, longer gaps restart the turn rate
+  static constexpr std::size_t kCoreSlots = 64;
+  static constexpr double kSlotSeconds = 0.5;
+
+  ThermalDetector();
+
+  void Reset();
+
+  // Filtered vario (m/s) and barometric altitude (m), at any rate.
+  void UpdateVario(double vario, double altitude);
+
+  /**
+   * A GPS fix: timestamp in us, position in degrees, course over ground in
+   * degrees and ground speed in km/h. A fix without a course or speed (NaN)
+   * is skipped; the vario samples carry over to the next one.
+   */
+  void UpdateFix(std::uint64_t timestamp, double latitude, double longitude,
+                 double course, double speed);
+
+  bool IsCircling() const { return circling_; }
+  double TurnRate() const { return turn_rate_; }     // deg/s, positive to the right
+
+  // The thermal being circled in, valid while IsCircling().
+  const ThermalStats& Current() const { return current_; }
+
+  // The last thermal that was left; has_last is false until there is one.
+  const ThermalStats& Last() const { return last_; }
+  bool HasLast() const { return has_last_; }
+
+  // Estimated core position in degrees, valid while HasCore().
+  bool HasCore() const;
+  double CoreLatitude() const;
+  double CoreLongitude() const;
+
+ private:
+  struct Slot {
+    double weight;    // Climb (m/s) times the time spent, m
+    double x;         // Weighted east offset from the reference, m * m
+    double y;         // Weighted north offset, m * m
+    double t;         // Weighted time since the thermal started, m * s
+    double start_x;   // Position and time of the slot's first fix
+    double start_y;
+    double start_time;
+    double start_turn;
+  };
+
+  void StartThermal();
+  void EndThermal();
+  void AddToCore(double latitude, double longitude, double climb, double dt);
+  void DropOldestSlot();
+  void UpdateDrift();
+  void UpdateStats(ThermalStats& stats) const;
+
+  double vario_ = 0;
+  double altitude_ = 0;
+  double vario_sum_ = 0;          // Since the last fix
+  std::size_t vario_count_ = 0;
+
+  bool has_fix_ = false;
+  std::uint64_t last_time_ = 0;
+  double last_course_ = 0;
+  double turn_rate_ = 0;
+
+  bool circling_ = false;
+  double state_time_ = 0;         // s the turn rate has disagreed with circling_
+  std::uint64_t candidate_time_ = 0;   // Where that disagreement began
+  double candidate_altitude_ = 0;
+  std::uint64_t now_ = 0;
+
+  ThermalStats current_;
+  ThermalStats last_;
+  bool has_last_ = false;
+
+  // Core ring: each slot covers kSlotSeconds; sums over the live slots.
+  Slot slots_[kCoreSlots];
+  std::size_t slot_ = 0;          // Slot being filled
+  std::size_t slot_count_ = 0;
+  double sum_weight_ = 0;
+  double sum_x_ = 0;
+  double sum_y_ = 0;
+  double sum_t_ = 0;
+  double time_ = 0;               // s since the thermal started
+  double turned_ = 0;             // Course change since then, deg, unwrapped
+  double x_ = 0;                  // Latest position, m from the reference
+  double y_ = 0;
+  double drift_x_ = 0;            // m/s of the circle over the ground, from
+  double drift_y_ = 0;            // the last window that spanned a full circle
+  double reference_latitude_ = 0;
+  double reference_longitude_ = 0;
+  double metres_per_degree_longitude_ = 0;
+};
+
+#endif // THERMALDETECTOR_H
@@ -0,0 +1,123 @@
+#include "VarioProcessor.h"
+#include <algorithm>
+#include <cmath>
+
+#ifdef KF_THREE_STATE_MODEL
+#define KF_PROCESS_VARIANCE(settings) (settings).var_jerk
+#else
+#define KF_PROCESS_VARIANCE(settings) (settings).var_accel
+#endif
+
+VarioProcessor::VarioProcessor(const VarioSettings& settings)
+  :settings_(settings),
+   compensator_(settings.temperature_coefficient, settings.temperature_reference,
+                settings.learn_temperature),
+   decimator_(settings.decimation, std::max<std::size_t>(settings.decimation_taps, 1)),
+   altimeter_(settings.qnh),
+   pressure_filter_(KF_PROCESS_VARIANCE(settings)),
+   altitude_filter_(KF_PROCESS_VARIANCE(settings)),
+   imu_filter_(settings.var_accel_input),
+   altitude_noise_(settings.adaptive_window, settings.var_measurement,
+                   settings.min_var_measurement, settings.max_var_measurement),
+   var_altitude_(settings.var_measurement)
+{
+  if (!prefilter_.Parse(settings.prefilter))
+    prefilter_.Parse(VarioSettings().prefilter);
+  prefilter_.SetProfiling(settings.profile_prefilter);
+  Reset();
+}
+
+void VarioProcessor::Reset(const double altitude)
+{
+  compensator_.Reset();
+  decimator_.Reset();
+  decimated_dt_ = 0;
+  pressure_filter_.Reset(kSeaLevelPressure);
+  altitude_filter_.Reset(altitude);
+  imu_filter_.Reset(altitude);
+  imu_aided_ = false;
+  altitude_noise_.Reset();
+  altitude_updates_ = 0;
+  var_altitude_ = settings_.var_measurement;
+  prefilter_.Reset();
+  pressure_ = kSeaLevelPressureHpa;
+  altitude_ = altitude;
+  vario_ = 0;
+}
+
+double VarioProcessor::PressureToAltitude(const double pressure_hpa, const double qnh)
+{
+  return AltitudeTable::Exact(pressure_hpa, qnh);
+}
+
+bool VarioProcessor::UpdatePressure(double pressure, double dt)
+{
+  // Before anything averages it: a drift removed here never reaches the
+  // filters' state
+  pressure = compensator_.Correct(pressure, vario_, dt);
+
+  if (settings_.decimation > 1) {
+    decimated_dt_ += dt;
+    if (!decimator_.Add(pressure))
+      return false;
+    pressure = decimator_.Output();
+    dt = decimated_dt_;
+    decimated_dt_ = 0;
+  }
+
+  // The IMU-aided filter gets the unsmoothed altitude: the acceleration
+  // input already carries the fast part of the signal, so it needs no lag.
+  const double raw_altitude = altimeter_.Altitude(pressure * 0.01);
+
+  // Update pressure with Kalman filter
+  pressure_filter_.Update(prefilter_.Process(pressure), settings_.var_measurement, dt);
+  pressure_ = pressure_filter_.GetXAbs() * 0.01;  // Convert to hPa
+
+  // Calculate and filter barometric altitude. The adapted variance describes
+  // the noise of raw_altitude, so in adaptive mode the altitude filter
+  // measures that directly: after the pre-filter and the pressure filter
+  // successive innovations are correlated, which breaks the covariance
+  // matching and biases the estimate low.
+  var_altitude_ = settings_.adaptive_measurement ? altitude_noise_.Variance()
+                                                 : settings_.var_measurement;
+  const double baro_altitude = settings_.adaptive_measurement
+      ? raw_altitude : altimeter_.Altitude(pressure_);
+  altitude_filter_.Update(baro_altitude, var_altitude_, dt);
+
+  if (imu_aided_) {
+    imu_filter_.Correct(raw_altitude, var_altitude_);
+    altitude_ = imu_filter_.GetXAbs();
+    vario_ = imu_filter_.GetXVel();
+  } else {
+    // Baro only: keep the IMU filter locked onto the altitude and vario so
+    // it can take over as soon as vertical acceleration becomes available,
+    // without the vario snapping to zero.
+    imu_filter_.Reset(raw_altitude, altitude_filter_.GetXVel());
+    altitude_ = altitude_filter_.GetXAbs();
+    vario_ = altitude_filter_.GetXVel();
+  }
+
+  // Learn from the filter whose output is used. The first window of
+  // innovations after a Reset(), or after the IMU filter takes over, still
+  // carries the huge initial variance, so only learn once it has settled.
+  if (settings_.adaptive_measurement && ++altitude_updates_ > settings_.adaptive_window) {
+    if (imu_aided_)
+      altitude_noise_.Add(imu_filter_.GetInnovation(), imu_filter_.GetPriorCovAbsAbs());
+    else
+      altitude_noise_.Add(altitude_filter_.GetInnovation(),
+                          altitude_filter_.GetPriorCovAbsAbs());
+  }
+  return true;
+}
+
+void VarioProcessor::UpdateAcceleration(const double accel, const double dt)
+{
+  // Propagate the altitude with the measured vertical acceleration so the
+  // vario reacts on this sample instead of waiting for the baro to catch up.
+  imu_filter_.Predict(accel, dt);
+  if (!imu_aided_) {
+    imu_aided_ = true;
+    altitude_updates_ = 0;
+  }
+  vario_ = imu_filter_.GetXVel();
+}
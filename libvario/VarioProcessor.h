@@ -0,0 +1,162 @@
+#ifndef VARIOPROCESSOR_H
+#define VARIOPROCESSOR_H
+
+#include <cstddef>
+#include <limits>
+#include <string>
+#include "KalmanFilter.h"
+#include "KalmanFilterN.h"
+#include "InnovationNoiseEstimator.h"
+#include "Decimator.h"
+#include "AltitudeTable.h"
+#include "FilterStages.h"
+#include "TemperatureCompensator.h"
+
+// Uncomment to run the pressure and altitude filters on the 3-state
+// altitude/velocity/acceleration model, which reacts sooner to the onset of lift.
+//#define KF_THREE_STATE_MODEL
+
+#ifdef KF_THREE_STATE_MODEL
+using VarioKalmanFilter = kalman::ConstantAccelerationFilter<double>;
+#else
+using VarioKalmanFilter = KalmanFilter;
+#endif
+
+// Filter parameters. The defaults are what the app used to hard-code; at
+// startup they are overridden from the config file written by kftune.
+struct VarioSettings {
+  double var_accel = 0.75;        // Process noise (acceleration variance)
+  double var_measurement = 0.25;  // Measurement noise variance
+  double var_jerk = 0.75;         // Process noise (jerk variance) of the 3-state model
+  double var_accel_input = 0.1;   // Noise variance of the measured vertical acceleration
+
+  // Estimate the measurement variance of the raw baro altitude online from
+  // the innovations of the filter that produces the output (the IMU-aided
+  // one once acceleration arrives) instead of using var_measurement, so the
+  // filter runs with little lag while the sensor is quiet and smooths harder
+  // in turbulence. The baro-only altitude filter then measures the raw
+  // altitude rather than the pre-filtered one.
+  bool adaptive_measurement = false;
+  std::size_t adaptive_window = 100;       // Innovations in the sliding window
+  double min_var_measurement = 1e-4;       // Clamp of the adapted variance, m^2
+  double max_var_measurement = 25.0;
+
+  // Low-pass and downsample oversampled pressure by this ratio before the
+  // filters (1 = off), through a FIR of decimation_taps taps. With the
+  // quieter input var_measurement can be lowered for less lag.
+  std::size_t decimation = 1;
+  std::size_t decimation_taps = 32;
+
+  // Pre-filter chain between the (decimated) pressure and the pressure
+  // Kalman filter, in FilterChain::Parse() syntax, e.g. "hampel:15:3,mean:10"
+  // to drop spikes before averaging. The default is the 10-sample moving
+  // average the app always had; an invalid spec falls back to it.
+  std::string prefilter = "mean:10";
+
+  // Time every pre-filter stage, see FilterChain::SetProfiling(). Costs two
+  // clock reads per stage and sample, so it is off unless asked for.
+  bool profile_prefilter = false;
+
+  // Sea level pressure in hPa that altitudes refer to. The standard
+  // atmosphere gives the pressure altitude; the local QNH gives the
+  // altitude above sea level.
+  double qnh = AltitudeTable::kStandardQnh;
+
+  // Correct the baro altitude, QNH error and drift included, towards the GPS
+  // altitude, see AltitudeFusion. Turn off where the GPS reports heights
+  // above the ellipsoid rather than above sea level.
+  bool gps_altitude = true;
+
+  // Pressure sensor temperature drift, see TemperatureCompensator: pressure
+  // is corrected by temperature_coefficient Pa per Celsius of sensor
+  // temperature above temperature_reference (NaN: the first temperature
+  // seen). With learn_temperature the coefficient is refined online while
+  // the vario rests on the ground, starting from the configured one.
+  double temperature_coefficient = 0;
+  double temperature_reference = std::numeric_limits<double>::quiet_NaN();
+  bool learn_temperature = false;
+};
+
+// The barometric signal chain of the vario, free of any UI or sensor code so
+// that offline tools can replay recorded data through exactly the same math:
+// temperature compensation, pressure smoothing, the pressure Kalman filter,
+// conversion to altitude, and the altitude filter (baro only, or aided by
+// vertical acceleration).
+class VarioProcessor {
+ public:
+  static constexpr double kSeaLevelPressure = 101325.0;    // Pa
+  static constexpr double kSeaLevelPressureHpa = 1013.25;  // hPa
+
+  explicit VarioProcessor(const VarioSettings& settings = VarioSettings());
+
+  void Reset(double altitude = 0);
+
+  /**
+   * Feeds a raw pressure sample in Pa, taken dt seconds after the previous
+   * one. dt must be greater than 0. Returns whether the filters were updated,
+   * which with decimation only happens every settings.decimation samples.
+   */
+  bool UpdatePressure(double pressure, double dt);
+
+  /**
+   * Feeds an earth-frame vertical acceleration in m/s^2, taken dt seconds
+   * after the previous one. Once this has been called the altitude and vario
+   * come from the IMU-aided filter.
+   */
+  void UpdateAcceleration(double accel, double dt);
+
+  // Sensor temperature in Celsius for the drift compensation of the
+  // following pressure samples; call it whenever the sensor reports one.
+  void UpdateTemperature(double celsius) { compensator_.SetTemperature(celsius); }
+
+  // GPS ground speed in km/h (NaN if unknown), which keeps the drift
+  // compensation from learning while the phone moves.
+  void UpdateGroundSpeed(double speed) { compensator_.SetGroundSpeed(speed); }
+
+  const VarioSettings& Settings() const { return settings_; }
+
+  double GetPressure() const { return pressure_; }  // Filtered pressure in hPa
+  double GetAltitude() const { return altitude_; }  // Filtered altitude in m
+  double GetVario() const { return vario_; }        // Vertical speed in m/s
+  bool IsImuAided() const { return imu_aided_; }
+
+  // Measurement variance of the last altitude correction: the
+  // adapted one in adaptive mode, var_measurement otherwise.
+  double GetMeasurementVariance() const { return var_altitude_; }
+  const InnovationNoiseEstimator& AltitudeNoise() const { return altitude_noise_; }
+
+  // The pressure pre-filter, e.g. to turn on its per-stage profiling.
+  FilterChain& Prefilter() { return prefilter_; }
+  const FilterChain& Prefilter() const { return prefilter_; }
+
+  const TemperatureCompensator& Compensator() const { return compensator_; }
+
+  // Exact barometric formula; the processor itself uses the faster
+  // AltitudeTable with settings.qnh.
+  static double PressureToAltitude(double pressure_hpa, double qnh = kSeaLevelPressureHpa);
+
+ private:
+  VarioSettings settings_;
+
+  TemperatureCompensator compensator_;
+  Decimator decimator_;
+  double decimated_dt_ = 0;
+
+  AltitudeTable altimeter_;
+  FilterChain prefilter_;
+
+  VarioKalmanFilter pressure_filter_;  // Filter for pressure readings
+  VarioKalmanFilter altitude_filter_;  // Filter for altitude calculations
+  KalmanFilter imu_filter_;            // Baro altitude aided by vertical acceleration
+  bool imu_aided_ = false;
+
+  InnovationNoiseEstimator altitude_noise_;
+  std::size_t altitude_updates_ = 0;
+  double var_altitude_;
+
+  double pressure_ = kSeaLevelPressureHpa;
+  double altitude_ = 0;
+  double vario_ = 0;
+};
+
+#endif // VARIOPROCESSOR_H
@@ -0,0 +1,40 @@
+#include "VarioTone.h"
+#include <algorithm>
+
+VarioTone::VarioTone(const float climb_threshold, const float sink_threshold)
+  :climb_threshold_(climb_threshold),
+   sink_threshold_(sink_threshold)
+{
+}
+
+Tone VarioTone::Characteristics(const double vario) const
+{
+  if (vario >= climb_threshold_) {
+    const float climb = static_cast<float>(vario) / 5.0f;
+    const float frequency = std::min(2200.0f, std::max(750.0f, 750.0f + 1450.0f * climb));
+    // Beeps stop getting shorter at 5 m/s instead of going negative
+    const float duration_range = 400.0f - 50.0f;
+    const int duration = static_cast<int>(400.0f - duration_range * std::min(climb, 1.0f));
+    return {true, frequency, duration, 1.0f};
+  }
+  if (vario <= sink_threshold_)
+    return {true, 440.0f, 800, 1.0f};
+  return {false, 0.0f, 50, 0.0f};
+}
+
+Tone VarioTone::Next(const double vario)
+{
+  Tone tone = Characteristics(vario);
+
+  if (vario >= climb_threshold_) {
+    // The gap after a beep lasts as long as the beep itself
+    if (!beeping_) {
+      tone.audible = false;
+      tone.volume = 0.0f;
+    }
+    beeping_ = !beeping_;
+  } else if (vario > sink_threshold_) {
+    beeping_ = false;
+  }
+  return tone;
+}
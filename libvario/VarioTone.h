@@ -0,0 +1,45 @@
+#ifndef VARIOTONE_H
+#define VARIOTONE_H
+
+// One segment of the vario sound: a tone, or a silence of the given length.
+struct Tone {
+  bool audible;
+  float frequency;   // Hz, 0 when silent
+  int duration_ms;
+  float volume;      // 0..1
+};
+
+// Decides what the vario sounds like for a given climb rate, independent of
+// any audio output:
+//
+//   climb >= climb_threshold: beeps from 750 Hz up to 2200 Hz at 5 m/s,
+//                             shorter and faster the stronger the climb
+//   sink <= sink_threshold:   a continuous 440 Hz tone
+//   in between:               silence
+//
+// Next() is called whenever the previous segment has finished playing and
+// returns the following one; in climb it alternates tone and gap.
+class VarioTone {
+ public:
+  explicit VarioTone(float climb_threshold = 0.1f, float sink_threshold = -1.0f);
+
+  void Reset() { beeping_ = false; }
+
+  Tone Next(double vario);
+
+  /**
+   * Frequency, length and volume of the tone for a climb rate, without the
+   * beep/gap alternation. Silent between the thresholds.
+   */
+  Tone Characteristics(double vario) const;
+
+  float ClimbThreshold() const { return climb_threshold_; }
+  float SinkThreshold() const { return sink_threshold_; }
+
+ private:
+  float climb_threshold_;
+  float sink_threshold_;
+  bool beeping_ = false;
+};
+
+#endif // VARIOTONE_H
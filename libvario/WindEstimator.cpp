@@ -0,0 +1,137 @@
+#include "WindEstimator.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kKmhPerMs = 3.6;
+
+double CourseDifference(const double a, const double b)
+{
+  double d = std::fmod(a - b, 360.0);
+  if (d > 180)
+    d -= 360;
+  else if (d <= -180)
+    d += 360;
+  return d;
+}
+
+}  // namespace
+
+void WindEstimator::Sums::Add(const Sample& s, const double sign)
+{
+  const double z = s.x * s.x + s.y * s.y;
+  n += sign;
+  x += sign * s.x;
+  y += sign * s.y;
+  xx += sign * s.x * s.x;
+  xy += sign * s.x * s.y;
+  yy += sign * s.y * s.y;
+  this->z += sign * z;
+  xz += sign * s.x * z;
+  yz += sign * s.y * z;
+  zz += sign * z * z;
+}
+
+WindEstimator::WindEstimator()
+{
+  Reset();
+}
+
+void WindEstimator::Reset()
+{
+  next_ = count_ = since_resum_ = 0;
+  sums_ = Sums();
+  has_sample_ = false;
+  last_time_ = 0;
+  last_course_ = turn_ = 0;
+  valid_ = false;
+  speed_ = direction_ = airspeed_ = residual_ = coverage_ = quality_ = 0;
+}
+
+void WindEstimator::UpdateFix(const std::uint64_t timestamp, const double course, const double speed)
+{
+  if (!std::isfinite(course) || !(speed >= kMinSpeed))
+    return;
+  if (has_sample_ && timestamp < last_time_ + static_cast<std::uint64_t>(kSampleInterval * 1e6))
+    return;
+
+  const double radians = course * kPi / 180;
+  const double v = speed / kKmhPerMs;
+  if (has_sample_)
+    turn_ += CourseDifference(course, last_course_);
+  has_sample_ = true;
+  last_time_ = timestamp;
+  last_course_ = course;
+
+  const Sample sample = {v * std::sin(radians), v * std::cos(radians), turn_};
+  if (count_ == kWindow)
+    sums_.Add(samples_[next_], -1);
+  else
+    ++count_;
+  samples_[next_] = sample;
+  next_ = (next_ + 1) % kWindow;
+  sums_.Add(sample, 1);
+
+  if (++since_resum_ == kWindow) {
+    since_resum_ = 0;
+    sums_ = Sums();
+    for (std::size_t i = 0; i < count_; ++i)
+      sums_.Add(samples_[i], 1);
+  }
+
+  Solve();
+}
+
+void WindEstimator::Solve()
+{
+  const Sample& oldest = samples_[count_ < kWindow ? 0 : next_];
+  const Sample& newest = samples_[(next_ + kWindow - 1) % kWindow];
+  coverage_ = std::min(std::fabs(newest.turn - oldest.turn), 360.0);
+
+  valid_ = false;
+  if (count_ < kMinSamples || coverage_ < kMinCoverage)
+    return;
+
+  // Normal equations of min sum (z + D x + E y + F)^2, by Cramer's rule
+  const Sums& s = sums_;
+  const double a11 = s.xx, a12 = s.xy, a13 = s.x;
+  const double a22 = s.yy, a23 = s.y, a33 = s.n;
+  const double b1 = -s.xz, b2 = -s.yz, b3 = -s.z;
+
+  const double c11 = a22 * a33 - a23 * a23;
+  const double c12 = a13 * a23 - a12 * a33;
+  const double c13 = a12 * a23 - a13 * a22;
+  const double det = a11 * c11 + a12 * c12 + a13 * c13;
+  if (std::fabs(det) < 1e-9)
+    return;
+
+  const double c22 = a11 * a33 - a13 * a13;
+  const double c23 = a12 * a13 - a11 * a23;
+  const double c33 = a11 * a22 - a12 * a12;
+  const double d = (c11 * b1 + c12 * b2 + c13 * b3) / det;
+  const double e = (c12 * b1 + c22 * b2 + c23 * b3) / det;
+  const double f = (c13 * b1 + c23 * b2 + c33 * b3) / det;
+
+  const double cx = -0.5 * d;
+  const double cy = -0.5 * e;
+  const double r2 = cx * cx + cy * cy - f;
+  if (r2 <= 0)
+    return;
+  const double radius = std::sqrt(r2);
+
+  // Algebraic residual z + D x + E y + F, expanded over the sums; near the
+  // circle it is about 2 R times the radial distance
+  const double algebraic = s.zz + d * d * s.xx + e * e * s.yy + f * f * s.n
+                           + 2 * (d * s.xz + e * s.yz + f * s.z
+                                  + d * e * s.xy + d * f * s.x + e * f * s.y);
+  const double radial = std::sqrt(std::max(algebraic, 0.0) / s.n) / (2 * radius);
+
+  valid_ = true;
+  speed_ = std::hypot(cx, cy) * kKmhPerMs;
+  direction_ = std::fmod(std::atan2(-cx, -cy) * 180 / kPi + 360, 360);
+  airspeed_ = radius * kKmhPerMs;
+  residual_ = radial * kKmhPerMs;
+  quality_ = coverage_ / 360 * std::exp(-radial / kResidualScale);
+}
@@ -0,0 +1,97 @@
+#ifndef WINDESTIMATOR_H
+#define WINDESTIMATOR_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Wind from the GPS ground velocity while circling. Flying circles at a
+// constant airspeed, the ground velocity vectors lie on a circle whose centre
+// is the wind vector and whose radius is the airspeed, so a circle fit to
+// them gives the wind without any air data.
+//
+// The fit is Kasa's algebraic least squares, x^2 + y^2 + D x + E y + F = 0,
+// whose normal equations need only sums of products of the samples. Those
+// are kept as running sums over a sliding window held in a fixed ring:
+// each new sample adds its products and the one it pushes out subtracts
+// its own, and the 3x3 system is solved in closed form, so a fix costs the
+// same whatever the window and nothing allocates. The sums are recomputed
+// from the ring once per pass to keep rounding from building up.
+//
+// Fixes closer than kSampleInterval to the last sample taken are skipped,
+// so the window spans the same time at any GPS rate, and so are fixes
+// without a course or speed or slower than kMinSpeed, whose course is
+// position noise.
+class WindEstimator {
+ public:
+  static constexpr std::size_t kWindow = 64;       // Samples, half a minute at the sample interval
+  static constexpr double kSampleInterval = 0.5;   // s
+  static constexpr double kMinSpeed = 5.0;         // km/h
+  static constexpr std::size_t kMinSamples = 8;
+  static constexpr double kMinCoverage = 180.0;    // deg of course change for a usable fit
+  static constexpr double kResidualScale = 1.0;    // m/s, see Quality()
+
+  WindEstimator();
+
+  void Reset();
+
+  /**
+   * A GPS fix: timestamp in us, course over ground in degrees and ground
+   * speed in km/h, NaN when the fix has none.
+   */
+  void UpdateFix(std::uint64_t timestamp, double course, double speed);
+
+  // Whether the window covers enough of a circle to give a wind.
+  bool IsValid() const { return valid_; }
+
+  double Speed() const { return speed_; }          // km/h
+  double Direction() const { return direction_; }  // deg the wind blows from, 0-360
+  double Airspeed() const { return airspeed_; }    // km/h, the fitted radius
+
+  // RMS distance of the samples from the fitted circle, km/h.
+  double Residual() const { return residual_; }
+
+  // Course change covered by the window, degrees (capped at 360).
+  double Coverage() const { return coverage_; }
+
+  /**
+   * 0 to 1: the share of a full circle covered, times
+   * exp(-Residual / kResidualScale) in m/s. A clean full circle is close
+   * to 1; a partial or ragged one (gusts, speed changes) drops quickly.
+   */
+  double Quality() const { return quality_; }
+
+ private:
+  struct Sample {
+    double x;       // East ground speed, m/s
+    double y;       // North ground speed, m/s
+    double turn;    // Cumulative course change, deg
+  };
+
+  struct Sums {
+    double n, x, y, xx, xy, yy, z, xz, yz, zz;
+    void Add(const Sample& s, double sign);
+  };
+
+  void Solve();
+
+  Sample samples_[kWindow];
+  std::size_t next_ = 0;
+  std::size_t count_ = 0;
+  std::size_t since_resum_ = 0;
+  Sums sums_;
+
+  bool has_sample_ = false;
+  std::uint64_t last_time_ = 0;
+  double last_course_ = 0;
+  double turn_ = 0;
+
+  bool valid_ = false;
+  double speed_ = 0;
+  double direction_ = 0;
+  double airspeed_ = 0;
+  double residual_ = 0;
+  double coverage_ = 0;
+  double quality_ = 0;
+};
+
+#endif // WINDESTIMATOR_H
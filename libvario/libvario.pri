@@ -0,0 +1,64 @@
+# Headless vario core: sample types, filters, altitude conversion, tone
+# decision, capture and replay. No Qt dependency, so the app, the command line
+# tools and CI all build the very same code. Include this file from a .pro to
+# compile it in, or build libvario.pro for a static library.
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+CONFIG += c++17 thread
+
+SOURCES += \
+    $$PWD/AltitudeFusion.cpp \
+    $$PWD/AltitudeTable.cpp \
+    $$PWD/AttitudeEstimator.cpp \
+    $$PWD/CaptureReader.cpp \
+    $$PWD/CaptureWriter.cpp \
+    $$PWD/Decimator.cpp \
+    $$PWD/FilterStages.cpp \
+    $$PWD/FlightModel.cpp \
+    $$PWD/HeadingEstimator.cpp \
+    $$PWD/InnovationNoiseEstimator.cpp \
+    $$PWD/KalmanFilter.cpp \
+    $$PWD/KalmanFilterBank.cpp \
+    $$PWD/KalmanFilterUD.cpp \
+    $$PWD/KalmanSmoother.cpp \
+    $$PWD/ReplaySource.cpp \
+    $$PWD/SampleSource.cpp \
+    $$PWD/SampleStatistics.cpp \
+    $$PWD/SimulatorSource.cpp \
+    $$PWD/TemperatureCompensator.cpp \
+    $$PWD/ThermalDetector.cpp \
+    $$PWD/VarioProcessor.cpp \
+    $$PWD/VarioTone.cpp \
+    $$PWD/WindEstimator.cpp
+
+HEADERS += \
+    $$PWD/AltitudeFusion.h \
+    $$PWD/AltitudeTable.h \
+    $$PWD/AttitudeEstimator.h \
+    $$PWD/CaptureFormat.h \
+    $$PWD/CaptureReader.h \
+    $$PWD/CaptureWriter.h \
+    $$PWD/Decimator.h \
+    $$PWD/FilterStages.h \
+    $$PWD/FlightModel.h \
+    $$PWD/HeadingEstimator.h \
+    $$PWD/InnovationNoiseEstimator.h \
+    $$PWD/KalmanFilter.h \
+    $$PWD/KalmanFilterBank.h \
+    $$PWD/KalmanFilterN.h \
+    $$PWD/KalmanFilterUD.h \
+    $$PWD/KalmanSmoother.h \
+    $$PWD/ReplaySource.h \
+    $$PWD/SampleSource.h \
+    $$PWD/SampleStatistics.h \
+    $$PWD/SensorSamples.h \
+    $$PWD/SimulatorSource.h \
+    $$PWD/Snapshot.h \
+    $$PWD/SpscRing.h \
+    $$PWD/TemperatureCompensator.h \
+    $$PWD/ThermalDetector.h \
+    $$PWD/VarioProcessor.h \
+    $$PWD/VarioTone.h \
+    $$PWD/WindEstimator.h
@@ -0,0 +1,10 @@
+# Static library build of the vario core, e.g. for CI on machines without Qt
+# Widgets, sensors or a display.
+
+TEMPLATE = lib
+TARGET = vario
+
+CONFIG += staticlib
+CONFIG -= qt
+
+include(libvario.pri)
@@ -1,6 +1,7 @@
 #include "mainwindow.h"
 #include <QApplication>
 #include <QStyleFactory>
+#include <QCommandLineParser>
 
 int main(int argc, char *argv[])
 {
@@ -10,7 +11,46 @@ int main(int argc, char *argv[])
     QPalette p (QColor(4, 50, 60));
     a.setPalette(p);
 
-    MainWindow w;
+    // Desktop debugging: play a recorded capture or a simulated flight
+    // instead of reading the sensors
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption replayOption("replay", "Replay a sensor capture (.vcap) instead of live sensors.", "file");
+    QCommandLineOption simulateOption("simulate", "Fly a simulated flight instead of live sensors.");
+    QCommandLineOption scriptOption("script", "Air mass script for --simulate, built-in demo if omitted.", "file");
+    QCommandLineOption speedOption("speed", "Replay or simulation speed as a multiple of real time, or \"max\".", "factor", "1");
+    QCommandLineOption nmeaOption("nmea", "Read GPS fixes from an NMEA log (replayed at its own pace) or a serial device or pty.", "file|device");
+    QCommandLineOption gpsRateOption("gps-rate", "Highest GPS fix rate to pass on, 0 for every fix the source delivers.", "Hz", "1");
+    parser.addOption(replayOption);
+    parser.addOption(simulateOption);
+    parser.addOption(scriptOption);
+    parser.addOption(speedOption);
+    parser.addOption(nmeaOption);
+    parser.addOption(gpsRateOption);
+    parser.process(a);
+
+    SampleSourceOptions source;
+    source.replayFile = parser.value(replayOption);
+    source.simulate = parser.isSet(simulateOption) || parser.isSet(scriptOption);
+    source.simulationScript = parser.value(scriptOption);
+    source.speed = 0.0;
+    if (parser.value(speedOption) != "max") {
+        bool ok = false;
+        source.speed = parser.value(speedOption).toDouble(&ok);
+        if (!ok || source.speed <= 0) {
+            qWarning() << "Invalid speed" << parser.value(speedOption) << "- using 1";
+            source.speed = 1.0;
+        }
+    }
+    source.nmeaSource = parser.value(nmeaOption);
+    bool ok = false;
+    source.gpsRate = parser.value(gpsRateOption).toDouble(&ok);
+    if (!ok || source.gpsRate < 0) {
+        qWarning() << "Invalid GPS rate" << parser.value(gpsRateOption) << "- using 1";
+        source.gpsRate = 1.0;
+    }
+
+    MainWindow w(source);
     w.show();
     return a.exec();
 }
@@ -1,8 +1,14 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include <QtMath>
+#include <QtNumeric>
 #include <QString>
 #include <QDebug>
+#include <QFile>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QDir>
+#include <QDateTime>
 
 // Color constants for avionic display
 namespace DisplayColors {
@@ -104,15 +110,12 @@ void MainWindow::keepScreenOn()
 
 #endif
 
-MainWindow::MainWindow(QWidget *parent)
+MainWindow::MainWindow(const SampleSourceOptions &sourceOptions, QWidget *parent)
     : QMainWindow(parent)
-    , accelVariance(KF_VAR_ACCEL)
-    , measurementVariance(KF_VAR_MEASUREMENT)
-    , pressure(SEA_LEVEL_PRESSURE)
-    , baroaltitude(0.0)
-    , gpsaltitude(0.0)
+    , sourceOptions(sourceOptions)
+    , pressure(SEA_LEVEL_PRESSURE_HPA)
+    , altitude(0.0)
     , vario(0.0)
-    , stopReading(false)
     , ui(new Ui::MainWindow)
 {
     try {
@@ -128,12 +131,10 @@ MainWindow::MainWindow(QWidget *parent)
         requestIOSLocationPermission();
 #endif
 
-        initializeFilters();
+        loadFilterSettings();
+        initializeSound();
         initializeSensors();
 
-        varioSound = new VarioSound(this);
-        varioSound->start();
-
         QTimer *simTimer = new QTimer(this);
         bool increasing = true;
 
@@ -202,6 +203,7 @@ void MainWindow::setupUi()
     label_vario = new QLabel("0.0 m/s", this);
     label_altitude = new QLabel("0.0 m", this);
     label_speed = new QLabel("0 km/s", this);
+    label_thermal = new QLabel("--", this);
     label_pressure = new QLabel("0.0 kPa", this);
 
     pushExit = new QPushButton("EXIT", this);
@@ -211,6 +213,7 @@ void MainWindow::setupUi()
     gridLayout->addWidget(label_vario, row++, 0, 1, 3);
     gridLayout->addWidget(label_altitude, row++, 0, 1, 3);
     gridLayout->addWidget(label_speed, row++, 0, 1, 3);
+    gridLayout->addWidget(label_thermal, row++, 0, 1, 3);
     gridLayout->addWidget(label_pressure, row++, 0, 1, 3);
 
     // Add a spacer for the empty space above the Exit button
@@ -276,6 +279,7 @@ void MainWindow::setupStyles()
     QString commonLabelStyle = "background-color: #022136; qproperty-alignment: AlignCenter;";
     label_altitude->setStyleSheet(commonLabelStyle);
     label_speed->setStyleSheet(commonLabelStyle);
+    label_thermal->setStyleSheet(commonLabelStyle);
     label_pressure->setStyleSheet(commonLabelStyle);
 }
 
@@ -298,129 +302,241 @@ void MainWindow::updateDisplays()
                              .arg(DisplayColors::BACKGROUND);
 
 
-    if(varioSound)
-        varioSound->updateVario(vario);
-
-    if(varioWidget)
+    if(varioWidget) {
         varioWidget->setVerticalSpeed(vario);
+        varioWidget->setHeading(m_heading);
+    }
 
-    if(gpsaltitude == 0)
-        label_altitude->setText(QString("%1 m").arg(QString::number(baroaltitude, 'f', 1)));
+    label_altitude->setText(QString("%1 m").arg(QString::number(altitude, 'f', 1)));
 
     label_vario->setStyleSheet(varioStyle);
     label_vario->setText(varioString);
     label_pressure->setText(QString("%1 hPa").arg(QString::number(pressure, 'f', 1)));
 }
 
-void MainWindow::initializeFilters()
+void MainWindow::updateThermalDisplay(const VarioState &state)
 {
-    // Initialize Kalman filters with default parameters
-    pressure_filter = std::make_shared<KalmanFilter>(accelVariance);
-    altitude_filter = std::make_shared<KalmanFilter>(accelVariance);
-    // Set initial states
-    pressure_filter->Reset(SEA_LEVEL_PRESSURE);
-    altitude_filter->Reset(baroaltitude);
-    // Initialize timing
-    p_start = QDateTime::currentDateTime();
-    p_end = p_start;
-}
+    if (!state.hasThermal)
+        return;
 
-void MainWindow::initializeSensors()
-{
-    // Initialize sensor manager
-    sensorManager = new SensorManager(this);
-    connect(sensorManager, &SensorManager::sendPressureInfo, this, &MainWindow::getPressureInfo);
-    connect(sensorManager, &SensorManager::sendAccInfo, this, &MainWindow::getAccInfo);
-    connect(sensorManager, &SensorManager::sendGyroInfo, this, &MainWindow::getGyroInfo);
-    connect(sensorManager, &SensorManager::sendCompassInfo, this, &MainWindow::getCompassInfo);
-    sensorManager->start();
-
-    readGps = new ReadGps(this);
-    connect(readGps, &ReadGps::sendInfo, this, &MainWindow::getGpsInfo);
+    // Average climb and height gain of the thermal being circled, or of the
+    // last one once back on the glide
+    QString text = QString("%1%2 m/s  %3 m")
+                       .arg(state.circling ? "" : "Last ")
+                       .arg(QString::number(state.thermal.average_climb, 'f', 1))
+                       .arg(QString::number(state.thermal.gain, 'f', 0));
+    if (text != label_thermal->text())
+        label_thermal->setText(text);
 }
 
-void MainWindow::processPressureData(const QList<qreal>& info)
-{    
-    pressure = info.at(0);
-    temperature = info.at(1);
-
-    quint64 timestamp = static_cast<quint64>(info.at(2));
+void MainWindow::loadFilterSettings()
+{
+    QString path = QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation)
+                   + "/" + KF_CONFIG_FILE;
 
-    if (lastPressTimestamp > 0) {
-        updatePressureAndAltitude();
+    if (!QFile::exists(path)) {
+        qDebug() << "No filter config at" << path << "- using defaults";
+        return;
     }
 
-    lastPressTimestamp = timestamp;
+    QSettings config(path, QSettings::IniFormat);
+    config.beginGroup("kalman");
+    filterSettings.var_accel = config.value("var_accel", filterSettings.var_accel).toDouble();
+    filterSettings.var_measurement = config.value("var_measurement", filterSettings.var_measurement).toDouble();
+    filterSettings.var_jerk = config.value("var_jerk", filterSettings.var_jerk).toDouble();
+    filterSettings.var_accel_input = config.value("var_accel_input", filterSettings.var_accel_input).toDouble();
+    filterSettings.adaptive_measurement = config.value("adaptive_measurement", filterSettings.adaptive_measurement).toBool();
+    filterSettings.adaptive_window = config.value("adaptive_window", static_cast<qulonglong>(filterSettings.adaptive_window)).toULongLong();
+    filterSettings.decimation = config.value("decimation", static_cast<qulonglong>(filterSettings.decimation)).toULongLong();
+    filterSettings.decimation_taps = config.value("decimation_taps", static_cast<qulonglong>(filterSettings.decimation_taps)).toULongLong();
+    // An unquoted spec with commas reads back as a list
+    QString prefilter = config.value("prefilter", QString::fromStdString(filterSettings.prefilter)).toStringList().join(',');
+    if (FilterChain().Parse(prefilter.toStdString())) {
+        filterSettings.prefilter = prefilter.toStdString();
+    } else {
+        qDebug() << "Invalid prefilter" << prefilter << "- using" << QString::fromStdString(filterSettings.prefilter);
+    }
+    config.endGroup();
+
+    // Sensor data rates in Hz, 0 asks for the fastest rate the sensor offers
+    config.beginGroup("sensors");
+    pressureRate = config.value("pressure_rate", pressureRate).toInt();
+    accRate = config.value("accel_rate", accRate).toInt();
+    // Per-stage pre-filter timing in the statistics report
+    filterSettings.profile_prefilter = config.value("profile", filterSettings.profile_prefilter).toBool();
+    config.endGroup();
+
+    // Local sea level pressure in hPa; the standard 1013.25 gives pressure altitude
+    config.beginGroup("altimeter");
+    filterSettings.qnh = config.value("qnh", filterSettings.qnh).toDouble();
+    filterSettings.gps_altitude = config.value("gps_correction", filterSettings.gps_altitude).toBool();
+    config.endGroup();
+
+    // Pressure sensor drift in Pa per Celsius, e.g. from a vario-cli run over
+    // a log of the phone warming up on the ground
+    config.beginGroup("temperature");
+    filterSettings.temperature_coefficient = config.value("coefficient", filterSettings.temperature_coefficient).toDouble();
+    filterSettings.temperature_reference = config.value("reference", filterSettings.temperature_reference).toDouble();
+    filterSettings.learn_temperature = config.value("learn", filterSettings.learn_temperature).toBool();
+    config.endGroup();
+
+    config.beginGroup("capture");
+    captureEnabled = config.value("enabled", captureEnabled).toBool();
+    config.endGroup();
+
+    qDebug() << "Filter config loaded from" << path
+             << "var_accel:" << filterSettings.var_accel
+             << "var_measurement:" << filterSettings.var_measurement;
 }
 
-void MainWindow::updatePressureAndAltitude()
+void MainWindow::initializeSound()
 {
-    p_end = QDateTime::currentDateTime();
-    qint64 elapsedTimeMillis = p_start.msecsTo(p_end);
+    // The tone runs on its own thread, so a slow repaint cannot stretch a
+    // beep; it is deleted there once the thread finishes
+    audioThread = new QThread(this);
+    varioSound = new VarioSound();
+    varioSound->moveToThread(audioThread);
+    connect(audioThread, &QThread::finished, varioSound, &QObject::deleteLater);
+    audioThread->start(QThread::HighPriority);
+    QMetaObject::invokeMethod(varioSound, &VarioSound::start, Qt::QueuedConnection);
+}
 
-    if (pressure == 0 || elapsedTimeMillis <= 0) {
-        return;
+void MainWindow::initializeSensors()
+{
+    sensorBus = std::make_shared<SensorBus>();
+    int pollInterval = BUS_POLL_INTERVAL_MS;
+
+    if (!sourceOptions.replayFile.isEmpty() || sourceOptions.simulate) {
+        if (startSampleSource()) {
+            // Drain often enough to keep up with the accelerated clock
+            double speed = sourceOptions.speed;
+            pollInterval = speed > 0 ? qMax(0, qRound(BUS_POLL_INTERVAL_MS / speed)) : 0;
+        }
+    } else {
+        // Initialize sensor manager
+        sensorManager = new SensorManager(sensorBus.get(), this);
+        sensorManager->setRequestedRate(QPressureSensor::sensorType, pressureRate);
+        sensorManager->setRequestedRate(QAccelerometer::sensorType, accRate);
+        connect(sensorManager, &SensorManager::sendRateReport, this, &MainWindow::printInfo);
+        sensorManager->start();
+
+        int gpsInterval = sourceOptions.gpsRate > 0 ? qRound(1000 / sourceOptions.gpsRate) : 0;
+        readGps = new ReadGps(sensorBus.get(), sourceOptions.nmeaSource, gpsInterval, this);
     }
 
-    p_dt = elapsedTimeMillis / 1000.0;
-
-    smoothPressure(pressure);
-
-    // Update pressure with Kalman filter
-    pressure_filter->Update(pressure, KF_VAR_MEASUREMENT, p_dt);
-    pressure = pressure_filter->GetXAbs() * 0.01; // Convert to hPa
-
-    // Calculate and filter barometric altitude
-    baroaltitude = 44330.0 * (1.0 - std::pow(pressure / SEA_LEVEL_PRESSURE_HPA, 0.19));
+    // A replay is already a capture, so do not record it again
+    if (captureEnabled && sourceOptions.replayFile.isEmpty()) {
+        startCapture();
+    }
 
-    altitude_filter->Update(baroaltitude, measurementVariance, p_dt);
-    baroaltitude = altitude_filter->GetXAbs();
+    // Filtering, capture and the tone are driven from the engine's thread
+    varioEngine = new VarioEngine(sensorBus.get(), filterSettings, this);
+    varioEngine->setPollInterval(pollInterval);
+    varioEngine->setSampleSource(sampleSource, simulator);
+    varioEngine->setCaptureWriter(captureWriter);
+    varioEngine->setVarioSound(varioSound);
+    varioEngine->start(QThread::HighestPriority);
+
+    displayTimer = new QTimer(this);
+    connect(displayTimer, &QTimer::timeout, this, &MainWindow::refreshDisplays);
+    displayTimer->start(DISPLAY_INTERVAL_MS);
+}
 
-    // Calculate vertical speed
-    vario = altitude_filter->GetXVel();
+bool MainWindow::startSampleSource()
+{
+    if (!sourceOptions.replayFile.isEmpty()) {
+        auto replay = std::make_shared<ReplaySource>(sensorBus.get());
+        if (!replay->Open(sourceOptions.replayFile.toStdString())) {
+            qWarning() << "Cannot open capture file" << sourceOptions.replayFile;
+            return false;
+        }
+        qDebug() << "Replaying" << sourceOptions.replayFile << "at" << sourceOptions.speed << "x";
+        sampleSource = replay;
+    } else {
+        std::vector<AirMass> script = FlightModel::DemoScript();
+        if (!sourceOptions.simulationScript.isEmpty()
+            && !FlightModel::LoadScript(sourceOptions.simulationScript.toStdString(), script)) {
+            qWarning() << "Cannot read flight script" << sourceOptions.simulationScript;
+            return false;
+        }
 
-    updateDisplays();
+        FlightSettings flight;
+        if (pressureRate > 0)
+            flight.pressure_rate = pressureRate;
+        if (accRate > 0)
+            flight.accel_rate = accRate;
+        simulator = std::make_shared<SimulatorSource>(sensorBus.get(), flight, script);
+        qDebug() << "Simulating a" << simulator->Duration() << "s flight at" << sourceOptions.speed << "x";
+        sampleSource = simulator;
+    }
 
-    p_start = p_end;
+    sampleSource->Start(sourceOptions.speed);
+    return true;
 }
 
-void MainWindow::smoothPressure(qreal newPressure)
+void MainWindow::startCapture()
 {
-    static QList<qreal> pressureBuffer;
-    static const int minWindow = 3;
-    static const int maxWindow = 10;
-
-    qreal pressureChangeRate = qAbs(newPressure - pressure);
-    int smoothingWindow = qBound(minWindow, maxWindow - static_cast<int>(pressureChangeRate * 5), maxWindow);
-
-    pressureBuffer.append(newPressure);
-    if (pressureBuffer.size() > smoothingWindow) {
-        pressureBuffer.removeFirst();
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)
+                  + "/" + CAPTURE_DIR;
+    QDir().mkpath(dir);
+    QString path = dir + "/" + QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss") + ".vcap";
+
+    captureWriter = std::make_shared<CaptureWriter>();
+    if (captureWriter->Open(path.toStdString())) {
+        qDebug() << "Capturing sensor data to" << path;
+    } else {
+        qWarning() << "Cannot create capture file" << path;
+        captureWriter.reset();
     }
-
-    pressure = std::accumulate(pressureBuffer.begin(), pressureBuffer.end(), 0.0) / pressureBuffer.size();
 }
 
-void MainWindow::getGpsInfo(QList<qreal> info)
+void MainWindow::refreshDisplays()
 {
-    if (info.size() < 4) {
-        qWarning() << "Invalid GPS data received";
-        return;
+    // The display only observes: it shows the newest published state, if
+    // any arrived since the last refresh, and never touches the filters.
+    VarioState state;
+    quint64 version = varioEngine->state().Read(state);
+    if (version != stateVersion) {
+        stateVersion = version;
+        pressure = state.pressure;
+        temperature = state.temperature;
+        ambientTemperature = state.ambientTemperature;
+        altitude = state.fusedAltitude;
+        vario = state.vario;
+        verticalAcc = state.verticalAcc;
+        m_roll = state.roll;
+        m_pitch = state.pitch;
+        if (state.headingValid)
+            m_heading = state.heading;
+        updateDisplays();
+        updateThermalDisplay(state);
+        hasWind = state.hasWind;
+        windSpeed = state.windSpeed;
+        windDirection = state.windDirection;
     }
 
-    // Update GPS data
-    gpsaltitude = info.at(0);
-    m_heading = info.at(1);
-    latitude = info.at(2);
-    longitude = info.at(3);
-    groundSpeed = static_cast<int>(info.at(4));
+    GpsFix fix;
+    version = varioEngine->gps().Read(fix);
+    if (version != gpsVersion) {
+        gpsVersion = version;
+        getGpsInfo(fix);
+    }
+}
 
-    varioWidget->setHeading(m_heading);
+void MainWindow::getGpsInfo(const GpsFix &fix)
+{
+    // Update GPS data
+    latitude = fix.latitude;
+    longitude = fix.longitude;
+    groundSpeed = qIsFinite(fix.speed) ? static_cast<int>(fix.speed) : 0;
 
     // Update displays - Fixed ambiguous arg() calls
-    if(gpsaltitude != 0)
-        label_altitude->setText(QString("Gps: %1 m").arg(QString::number(gpsaltitude, 'f', 0)));
-    label_speed->setText(QString("%1 km/h").arg(QString::number(groundSpeed, 'f', 1)));
+    QString speedText = QString("%1 km/h").arg(QString::number(groundSpeed, 'f', 1));
+    if (hasWind)
+        speedText += QString("  wind %1 km/h %2°")
+                         .arg(QString::number(windSpeed, 'f', 0))
+                         .arg(QString::number(windDirection, 'f', 0));
+    label_speed->setText(speedText);
 
     // Update status display - Fixed ambiguous arg() calls
     QString gpsStatus = QString("%1° - %2°")
@@ -429,54 +545,23 @@ void MainWindow::getGpsInfo(QList<qreal> info)
     printInfo(gpsStatus);
 }
 
-void MainWindow::getPressureInfo(QList<qreal> info)
+void MainWindow::handleExit()
 {
-    if (stopReading || info.size() < 3) {
-        return;
-    }
-
-    try {
-        processPressureData(info);
-    }
-    catch (const std::exception& e) {
-        qWarning() << "Error processing sensor data:" << e.what();
-    }
+    QCoreApplication::exit(0);
 }
 
-void MainWindow::getAccInfo(QList<qreal> info)
+MainWindow::~MainWindow()
 {
-    if (stopReading || info.size() < 2) {
-        return;
+    if (displayTimer) {
+        displayTimer->stop();
     }
 
-    m_roll = info.at(0);
-    m_pitch = info.at(1);
-}
-
-void MainWindow::getGyroInfo(QList<qreal> info)
-{
-    if (stopReading || info.size() < 3) {
-        return;
+    // Stop the consumer first; it writes the capture and feeds the sound
+    if (varioEngine) {
+        varioEngine->setStop();
+        varioEngine->wait();
     }
-}
 
-void MainWindow::getCompassInfo(QList<qreal> info)
-{
-    if (stopReading || info.size() < 1) {
-        return;
-    }
-
-    m_heading = info.at(0);
-    varioWidget->setHeading(m_heading);
-}
-
-void MainWindow::handleExit()
-{
-    QCoreApplication::exit(0);
-}
-
-MainWindow::~MainWindow()
-{
     if (sensorManager) {
         sensorManager->setStop();
         sensorManager->quit();
@@ -484,13 +569,21 @@ MainWindow::~MainWindow()
         delete sensorManager;
     }
 
+    if (sampleSource) {
+        sampleSource->Stop();
+    }
+
+    if (captureWriter) {
+        captureWriter->Close();
+    }
+
     if (readGps) {
         delete readGps;
     }
 
-    if (varioSound) {
-        varioSound->stop();
-        delete varioSound;
+    if (audioThread) {
+        audioThread->quit();
+        audioThread->wait();
     }
 
     delete ui;
@@ -9,18 +9,22 @@
 #include <QPushButton>
 #include <QSlider>
 #include <QTextBrowser>
-#include <QDateTime>
 #include <QString>
 #include <QList>
 #include <QThread>
 #include <QDebug>
+#include <QTimer>
 #include <QtMath>
 #include <memory>
 
 // Custom component includes
 #include "sensormanager.h"
 #include "readgps.h"
-#include "kalmanfilter.h"
+#include "VarioProcessor.h"
+#include "CaptureWriter.h"
+#include "ReplaySource.h"
+#include "SimulatorSource.h"
+#include "varioengine.h"
 #include "variosound.h"
 #include "variowidget.h"
 
@@ -28,8 +32,22 @@
 #define SEA_LEVEL_PRESSURE 101325.0f        // Standard sea level pressure in Pascals
 #define SEA_LEVEL_PRESSURE_HPA 1013.25f     // Standard sea level pressure in hPa
 
-#define KF_VAR_ACCEL 0.75f                  // Process noise (acceleration variance)
-#define KF_VAR_MEASUREMENT 0.25f           // Measurement noise variance
+// Filter settings written by kftune; missing keys keep the VarioSettings defaults
+#define KF_CONFIG_FILE "kalman.ini"
+
+#define DISPLAY_INTERVAL_MS 50              // How often the display looks for new filter output
+#define CAPTURE_DIR "captures"              // Raw sensor captures, under the app data location
+
+// Where sensor samples come from: the live sensors, unless the command line
+// asks for a capture replay or a simulated flight.
+struct SampleSourceOptions {
+    QString replayFile;                     // Play back this capture
+    bool simulate{false};                   // Fly the synthetic flight model
+    QString simulationScript;               // Air mass script for it, built-in demo if empty
+    double speed{1.0};                      // Multiple of real time, 0 = as fast as possible
+    QString nmeaSource;                     // NMEA log or device instead of the platform GPS
+    double gpsRate{1.0};                    // Highest fix rate in Hz, 0 = every fix
+};
 
 // Display color constants
 namespace DisplayColors {
@@ -53,27 +71,26 @@ class MainWindow : public QMainWindow {
 
 public:
 
-    explicit MainWindow(QWidget *parent = nullptr);
+    explicit MainWindow(const SampleSourceOptions &sourceOptions = SampleSourceOptions(),
+                        QWidget *parent = nullptr);
     ~MainWindow();
 
 private slots:
 
     void handleExit();
-    void getGpsInfo(QList<qreal> info);
-    void getPressureInfo(QList<qreal> info);
-    void getAccInfo(QList<qreal> info);
-    void getGyroInfo(QList<qreal> info);
-    void getCompassInfo(QList<qreal> info);
+    void refreshDisplays();
 
 private:
     void initializeUI();
     void setupStyles();
-    void initializeFilters();
     void initializeSensors();
-    void processPressureData(const QList<qreal>& info);
-    void updatePressureAndAltitude();
+    void initializeSound();
     void updateDisplays();
-    void smoothPressure(qreal newPressure);
+    void updateThermalDisplay(const VarioState &state);
+    void getGpsInfo(const GpsFix &fix);
+    void loadFilterSettings();
+    void startCapture();
+    bool startSampleSource();
 
     void printInfo(QString info);
 #ifdef Q_OS_ANDROID
@@ -90,49 +107,55 @@ private:
     QLabel *label_pressure;
     QLabel *label_altitude;
     QLabel *label_speed;
+    QLabel *label_thermal;
     QLabel *label_vario;
     QPushButton *pushExit;
 
     VarioWidget *varioWidget{nullptr};
 
     // Device managers
+    std::shared_ptr<SensorBus> sensorBus;    // Lock-free rings from the sensor sources
+    std::shared_ptr<CaptureWriter> captureWriter;  // Records every drained sample when enabled
+    SampleSourceOptions sourceOptions;
+    std::shared_ptr<SampleSource> sampleSource;     // Replay or simulation standing in for the sensors
+    std::shared_ptr<SimulatorSource> simulator;     // Same object as sampleSource when simulating
     SensorManager* sensorManager{nullptr};   // Pressure and temperature sensor manager
     ReadGps* readGps{nullptr};               // GPS data manager    
-    VarioSound* varioSound{nullptr};         // Audio feedback manager
-
-    // Kalman filters
-    std::shared_ptr<KalmanFilter> pressure_filter;    // Filter for pressure readings
-    std::shared_ptr<KalmanFilter> altitude_filter;    // Filter for altitude calculations
-
-    // Timing variables
-    qreal p_dt{0.0};                        // Time delta for calculations
-    quint64 lastPressTimestamp{0};          // Timestamp of last pressure reading
+    VarioSound* varioSound{nullptr};         // Audio feedback manager, runs on audioThread
+    QThread* audioThread{nullptr};
 
-    QDateTime p_end;                        // End time for calculations
-    QDateTime p_start;
+    // Filters on their own thread; the display only reads its snapshots
+    VarioEngine* varioEngine{nullptr};
+    QTimer* displayTimer{nullptr};
+    quint64 stateVersion{0};                 // Last snapshot versions shown
+    quint64 gpsVersion{0};
 
 
     // Kalman filter parameters
-    qreal accelVariance{0};             // Acceleration variance
-    qreal measurementVariance{0}; // Measurement variance
+    VarioSettings filterSettings;
+    int pressureRate{0};                    // Requested sensor rates in Hz, 0 = sensor maximum
+    int accRate{0};
+    bool captureEnabled{false};
 
     // GPS data
     qreal latitude{0.0};                    // Current latitude in degrees
     qreal longitude{0.0};                   // Current longitude in degrees
     int groundSpeed{0};                     // Ground speed in km/h
+    bool hasWind{false};
+    qreal windSpeed{0.0};                   // km/h
+    qreal windDirection{0.0};               // Degrees the wind blows from
 
     // Sensor data
-    qreal pressure{SEA_LEVEL_PRESSURE};     // Current pressure in Pa
+    qreal pressure{SEA_LEVEL_PRESSURE_HPA}; // Filtered pressure in hPa
     qreal temperature{0.0};                 // Current temperature in Celsius
-    qreal baroaltitude{0.0};               // Barometric altitude in meters
-    qreal gpsaltitude{0.0};
+    qreal ambientTemperature{0.0};          // From the ambient temperature sensor, if any
+    qreal altitude{0.0};                   // Baro altitude, corrected by the GPS once it has a fix
     qreal vario{0.0};                      // Vertical speed in m/s
+    qreal verticalAcc{0.0};                // Earth-frame vertical acceleration in m/s^2
     qreal m_roll = 0.0;
     qreal m_pitch = 0.0;
     qreal m_heading = 0.0;
 
-    // Control flags
-    bool stopReading{false};                // Flag to control sensor reading
     // UI
     Ui::MainWindow* ui;                     // User interface pointer
 };
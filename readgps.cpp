@@ -1,8 +1,19 @@
 #include "readgps.h"
-
-ReadGps::ReadGps(QObject *parent)
+#include <QFile>
+#include <QFileInfo>
+#include <QNmeaPositionInfoSource>
+#include <QtNumeric>
+#ifdef HAVE_SERIALPORT
+#include <QSerialPort>
+#endif
+
+ReadGps::ReadGps(SensorBus *bus, const QString &nmeaSource, int updateInterval, QObject *parent)
     : QObject(parent)
     , source(nullptr)
+    , nmeaDevice(nullptr)
+    , bus(bus)
+    , nmeaSource(nmeaSource)
+    , updateInterval(updateInterval)
     , retryTimer(nullptr)
     , retryCount(0)
     , updatesStarted(false)
@@ -23,7 +34,8 @@ void ReadGps::checkPermissionAndInitialize()
         cleanupGPS();
     }
 
-    source = QGeoPositionInfoSource::createDefaultSource(this);
+    source = nmeaSource.isEmpty() ? QGeoPositionInfoSource::createDefaultSource(this)
+                                  : createNmeaSource();
 
     if (source) {
         connect(source, &QGeoPositionInfoSource::positionUpdated,
@@ -33,15 +45,56 @@ void ReadGps::checkPermissionAndInitialize()
 
         // Set high accuracy mode
         source->setPreferredPositioningMethods(QGeoPositionInfoSource::AllPositioningMethods);
-        source->setUpdateInterval(NORMAL_TIMEOUT);
+        source->setUpdateInterval(updateInterval);
 
         // Start with a single update request
         requestSingleUpdate();
+    } else if (!nmeaSource.isEmpty()) {
+        // The device may not be plugged in, or the pty not opened, yet
+        QTimer::singleShot(RETRY_INTERVAL, this, &ReadGps::checkPermissionAndInitialize);
     } else {
         qDebug() << "Error: Could not create position source. Verify location permissions in Info.plist";
     }
 }
 
+QGeoPositionInfoSource *ReadGps::createNmeaSource()
+{
+    // A log is replayed at the pace of its timestamps; a device has no end
+    // and delivers its sentences when they are sent
+    const bool isFile = QFileInfo(nmeaSource).isFile();
+    QIODevice *device = nullptr;
+
+    if (isFile) {
+        device = new QFile(nmeaSource);
+    } else {
+#ifdef HAVE_SERIALPORT
+        // A pty ignores the baud rate; a real receiver is usually at 9600
+        // or faster, set up with stty beforehand
+        device = new QSerialPort(nmeaSource);
+#else
+        qDebug() << "Error: NMEA device" << nmeaSource << "needs Qt Serial Port";
+        return nullptr;
+#endif
+    }
+
+    if (!device->open(QIODevice::ReadOnly)) {
+        qDebug() << "Error: Could not open NMEA source" << nmeaSource << "-" << device->errorString();
+        delete device;
+        return nullptr;
+    }
+
+    auto nmea = new QNmeaPositionInfoSource(isFile ? QNmeaPositionInfoSource::SimulationMode
+                                                   : QNmeaPositionInfoSource::RealTimeMode,
+                                            this);
+    device->setParent(nmea);
+    nmea->setDevice(device);
+    nmeaDevice = device;
+
+    qDebug() << "Reading NMEA from" << nmeaSource << (isFile ? "(replay)" : "(live)")
+             << "every" << updateInterval << "ms";
+    return nmea;
+}
+
 void ReadGps::requestSingleUpdate()
 {
     if (!source) return;
@@ -103,6 +156,7 @@ void ReadGps::cleanupGPS()
         source->stopUpdates();
         delete source;
         source = nullptr;
+        nmeaDevice = nullptr;
     }
     updatesStarted = false;
     isWaitingForFix = false;
@@ -118,30 +172,30 @@ void ReadGps::stopRetryTimer()
     }
 }
 
-QList<qreal> ReadGps::captureGpsData()
+bool ReadGps::captureGpsData(GpsFix &fix)
 {
-    QList<qreal> temp;
-
     if (!positionInfo.isValid()) {
-        return temp;
+        return false;
     }
 
-    temp.append(positionInfo.coordinate().altitude());
+    fix.timestamp = static_cast<quint64>(positionInfo.timestamp().toMSecsSinceEpoch()) * 1000;
+    fix.altitude = positionInfo.coordinate().altitude();
 
-    qreal heading = positionInfo.hasAttribute(QGeoPositionInfo::Direction)
-                        ? positionInfo.attribute(QGeoPositionInfo::Direction)
-                        : 0.0;
-    temp.append(heading);
+    // A fix without course or speed (e.g. GGA-only NMEA) must not read as
+    // flying north at 0 km/h, so the unknown ones are NaN
+    fix.heading = positionInfo.hasAttribute(QGeoPositionInfo::Direction)
+                      ? positionInfo.attribute(QGeoPositionInfo::Direction)
+                      : qQNaN();
 
-    temp.append(positionInfo.coordinate().latitude());
-    temp.append(positionInfo.coordinate().longitude());
+    fix.latitude = positionInfo.coordinate().latitude();
+    fix.longitude = positionInfo.coordinate().longitude();
 
-    qreal speed = positionInfo.hasAttribute(QGeoPositionInfo::GroundSpeed)
-                      ? positionInfo.attribute(QGeoPositionInfo::GroundSpeed) * 3.75
-                      : 0.0;
-    temp.append(speed);
+    // m/s to km/h
+    fix.speed = positionInfo.hasAttribute(QGeoPositionInfo::GroundSpeed)
+                    ? positionInfo.attribute(QGeoPositionInfo::GroundSpeed) * 3.6
+                    : qQNaN();
 
-    return temp;
+    return true;
 }
 
 void ReadGps::positionUpdated(const QGeoPositionInfo &info)
@@ -151,7 +205,10 @@ void ReadGps::positionUpdated(const QGeoPositionInfo &info)
     retryCount = 0;
 
     positionInfo = info;
-    emit sendInfo(captureGpsData());
+
+    GpsFix fix;
+    if (captureGpsData(fix))
+        bus->gps.Push(fix);
 
     // Start continuous updates if we haven't already
     if (!updatesStarted) {
@@ -172,6 +229,12 @@ void ReadGps::handleError()
         break;
 
     case QGeoPositionInfoSource::UpdateTimeoutError:
+        // A replayed log that has run out will not deliver again
+        if (nmeaDevice && !nmeaDevice->isSequential() && nmeaDevice->atEnd()) {
+            qDebug() << "NMEA replay of" << nmeaSource << "finished";
+            cleanupGPS();
+            break;
+        }
         if (!retryTimer || !retryTimer->isActive()) {
             retryUpdate();
         }
@@ -4,19 +4,31 @@
 #include <QObject>
 #include <QGeoPositionInfoSource>
 #include <QGeoPositionInfo>
+#include <QIODevice>
 #include <QDebug>
 #include <QTimer>
+#include "SensorSamples.h"
 
+// Pushes position fixes onto the sensor bus. They come from the platform's
+// position source, or from NMEA sentences: a log file is replayed with the
+// timing of its own timestamps, and a serial port or pseudo-terminal is read
+// as it arrives, e.g. from a GPS on USB or a test feeding a pty at 20 Hz or
+// more. Either way the same timeout and restart logic applies.
 class ReadGps : public QObject
 {
     Q_OBJECT
 public:
-    explicit ReadGps(QObject *parent = nullptr);
+    /**
+     * nmeaSource is an NMEA log file or a serial device, empty for the
+     * platform source. updateInterval is the shortest time between fixes in
+     * ms; 0 passes on every fix the source delivers.
+     */
+    explicit ReadGps(SensorBus *bus, const QString &nmeaSource = QString(),
+                     int updateInterval = NORMAL_TIMEOUT, QObject *parent = nullptr);
     ~ReadGps();
-    QList<qreal> captureGpsData();
+    bool captureGpsData(GpsFix &fix);
 
 signals:
-    void sendInfo(QList<qreal>);
     void permissionDenied();
     void gpsTimeout();
 
@@ -28,6 +40,10 @@ private slots:
 
 private:
     QGeoPositionInfoSource *source;
+    QIODevice *nmeaDevice;                       // Owned by source, if it reads NMEA
+    SensorBus *bus;
+    QString nmeaSource;
+    int updateInterval;
     QGeoPositionInfo positionInfo;
     QTimer *retryTimer;
     int retryCount;
@@ -39,6 +55,7 @@ private:
     static const int NORMAL_TIMEOUT = 1000;      // 1 second for updates
     static const int RETRY_INTERVAL = 5000;      // 5 seconds between retries
 
+    QGeoPositionInfoSource *createNmeaSource();
     void initializeGPS();
     void cleanupGPS();
     void stopRetryTimer();
@@ -1,34 +1,17 @@
 #include "sensormanager.h"
+#include <QTimer>
+#include <limits>
 
-SensorManager::SensorManager(QObject *parent) :
-    QThread(parent), m_stop(false)
+SensorManager::SensorManager(SensorBus *bus, QObject *parent) :
+    QThread(parent), m_bus(bus)
 {
     findSensors();
-    startSensors();
 }
 
 SensorManager::~SensorManager()
 {
-    m_stop = true;
-    wait(); // Wait for thread to finish
-
-    // Stop all sensors
-    if (sensorPressure) {
-        sensorPressure->stop();
-        delete sensorPressure;
-    }
-    if (sensorAcc) {
-        sensorAcc->stop();
-        delete sensorAcc;
-    }
-    if (sensorGyro) {
-        sensorGyro->stop();
-        delete sensorGyro;
-    }
-    if (sensorCompass) {
-        sensorCompass->stop();
-        delete sensorCompass;
-    }
+    setStop();
+    wait(); // Wait for thread to finish, it stops and deletes the sensors
 
     // Clean up sensor list
     qDeleteAll(mySensorList);
@@ -57,6 +40,7 @@ void SensorManager::startSensors()
     bool hasAccelerometerSensor = false;
     bool hasGyroscopeSensor = false;
     bool hasCompassSensor = false;
+    bool hasMagnetometerSensor = false;
     bool hasTemperatureSensor = false;
 
     for (QSensor* sensor : mySensorList) {
@@ -72,15 +56,26 @@ void SensorManager::startSensors()
         else if (sensor->type() == QCompass::sensorType) {
             hasCompassSensor = true;
         }
+        else if (sensor->type() == QMagnetometer::sensorType) {
+            hasMagnetometerSensor = true;
+        }
         else if (sensor->type() == QAmbientTemperatureSensor::sensorType) {
             hasTemperatureSensor = true;
         }
     }
 
+    // Called from run(): the sensors get no parent so they live in this
+    // thread, and readingChanged is delivered here rather than to the GUI
+    // thread that owns the SensorManager object itself.
     if (hasPressureSensor) {
-        sensorPressure = new QPressureSensor(this);
-        if (sensorPressure->start())
-            qDebug() << "QPressureSensor started.";
+        sensorPressure = new QPressureSensor();
+        configureDataRate(sensorPressure, m_pressureRate);
+        connect(sensorPressure, &QSensor::readingChanged,
+                this, &SensorManager::pressureReadingChanged, Qt::DirectConnection);
+        if (sensorPressure->start()) {
+            m_pressureRate.reported = sensorPressure->dataRate();
+            qDebug() << "QPressureSensor started at" << m_pressureRate.reported << "Hz.";
+        }
         else
             qDebug() << "Failed to start QPressureSensor.";
     } else {
@@ -88,9 +83,14 @@ void SensorManager::startSensors()
     }
 
     if (hasAccelerometerSensor) {
-        sensorAcc = new QAccelerometer(this);
-        if (sensorAcc->start())
-            qDebug() << "QAccelerometer started.";
+        sensorAcc = new QAccelerometer();
+        configureDataRate(sensorAcc, m_accRate);
+        connect(sensorAcc, &QSensor::readingChanged,
+                this, &SensorManager::accReadingChanged, Qt::DirectConnection);
+        if (sensorAcc->start()) {
+            m_accRate.reported = sensorAcc->dataRate();
+            qDebug() << "QAccelerometer started at" << m_accRate.reported << "Hz.";
+        }
         else
             qDebug() << "Failed to start QAccelerometer.";
     } else {
@@ -98,24 +98,45 @@ void SensorManager::startSensors()
     }
 
     if (hasTemperatureSensor) {
-        sensorTemperature = new QAmbientTemperatureSensor(this);
+        sensorTemperature = new QAmbientTemperatureSensor();
+        connect(sensorTemperature, &QSensor::readingChanged,
+                this, &SensorManager::temperatureReadingChanged, Qt::DirectConnection);
         if (sensorTemperature->start())
             qDebug() << "QAmbientTemperatureSensor started.";
         else
-            qDebug() << "Failed to start QAccelerometer.";
+            qDebug() << "Failed to start QAmbientTemperatureSensor.";
     } else {
         qDebug() << "QAmbientTemperatureSensor not found in SensorList.";
     }
 
-    // if (hasGyroscopeSensor) {
-    //     sensorGyro = new QGyroscope(this);
-    //     if (sensorGyro->start())
-    //         qDebug() << "QGyroscope started.";
-    //     else
-    //         qDebug() << "Failed to start QGyroscope.";
-    // } else {
-    //     qDebug() << "QGyroscope not found in SensorList.";
-    // }
+    // The gyro drives the attitude estimator at its native rate
+    if (hasGyroscopeSensor) {
+        sensorGyro = new QGyroscope();
+        configureDataRate(sensorGyro, m_gyroRate);
+        connect(sensorGyro, &QSensor::readingChanged,
+                this, &SensorManager::gyroReadingChanged, Qt::DirectConnection);
+        if (sensorGyro->start()) {
+            m_gyroRate.reported = sensorGyro->dataRate();
+            qDebug() << "QGyroscope started at" << m_gyroRate.reported << "Hz.";
+        }
+        else
+            qDebug() << "Failed to start QGyroscope.";
+    } else {
+        qDebug() << "QGyroscope not found in SensorList, attitude from the accelerometer only.";
+    }
+
+    if (hasMagnetometerSensor) {
+        sensorMag = new QMagnetometer();
+        sensorMag->setReturnGeoValues(false);   // Raw field; only its direction is used
+        connect(sensorMag, &QSensor::readingChanged,
+                this, &SensorManager::magReadingChanged, Qt::DirectConnection);
+        if (sensorMag->start())
+            qDebug() << "QMagnetometer started.";
+        else
+            qDebug() << "Failed to start QMagnetometer.";
+    } else {
+        qDebug() << "QMagnetometer not found in SensorList.";
+    }
 
     // if (hasCompassSensor) {
     //     sensorCompass = new QCompass(this);
@@ -128,32 +149,225 @@ void SensorManager::startSensors()
     // }
 }
 
-void SensorManager::readSensorValues()
+void SensorManager::stopSensors()
+{
+    QList<QSensor*> sensors = { sensorPressure, sensorAcc, sensorGyro,
+                                sensorCompass, sensorMag, sensorTemperature };
+    for (QSensor *sensor : sensors) {
+        if (sensor) {
+            sensor->stop();
+            delete sensor;
+        }
+    }
+    sensorPressure = nullptr;
+    sensorAcc = nullptr;
+    sensorGyro = nullptr;
+    sensorCompass = nullptr;
+    sensorMag = nullptr;
+    sensorTemperature = nullptr;
+}
+
+void SensorManager::setRequestedRate(const QByteArray &type, int hz)
+{
+    // Only takes effect for sensors started afterwards, i.e. call before start()
+    m_requestedRates.insert(type, hz);
+}
+
+void SensorManager::configureDataRate(QSensor *sensor, SensorRate &rate)
+{
+    // availableDataRates() is only known once a backend is attached
+    if (!sensor->isConnectedToBackend())
+        sensor->connectToBackend();
+
+    rate.requested = m_requestedRates.value(sensor->type(), 0);
+    rate.maximum = 0;
+    for (const qrange &range : sensor->availableDataRates())
+        rate.maximum = qMax(rate.maximum, range.second);
+
+    int target = rate.requested > 0 ? rate.requested : rate.maximum;
+    if (rate.maximum > 0)
+        target = qMin(target, rate.maximum);
+    if (target > 0)
+        sensor->setDataRate(target);
+
+    // A barometer often repeats the same quantized value; those are real
+    // samples, duplicates are recognized by their timestamp instead.
+    sensor->setSkipDuplicates(false);
+}
+
+bool SensorManager::acceptTimestamp(SensorRate &rate, quint64 &timestamp)
+{
+    if (timestamp == 0)
+        timestamp = quint64(m_clock.nsecsElapsed() / 1000);
+
+    // Some backends signal readingChanged again for a reading already seen
+    if (timestamp == rate.lastTimestamp) {
+        ++rate.duplicates;
+        return false;
+    }
+    rate.lastTimestamp = timestamp;
+    ++rate.samples;
+    return true;
+}
+
+void SensorManager::pressureReadingChanged()
 {
-    processAccelerometerData();
-    emit sendPressureInfo(readPressure());
-    emit sendAccInfo(readAcc());
-    // emit sendGyroInfo(readGyro());
-    // emit sendCompassInfo(readCompass());
+    QPressureReading* reading = sensorPressure->reading();
+    if (!reading)
+        return;
+
+    quint64 timestamp = reading->timestamp();
+    if (!acceptTimestamp(m_pressureRate, timestamp))
+        return;
+
+    PressureSample sample;
+    if (readPressure(sample)) {
+        sample.timestamp = timestamp;
+        m_bus->pressure.Push(sample);
+    }
+}
+
+void SensorManager::accReadingChanged()
+{
+    QAccelerometerReading* reading = sensorAcc->reading();
+    if (!reading)
+        return;
+
+    // Checked before readAcc() so a repeated reading does not count twice
+    // in the attitude and gravity filters.
+    quint64 timestamp = reading->timestamp();
+    if (!acceptTimestamp(m_accRate, timestamp))
+        return;
+
+    m_acc[0] = reading->x();
+    m_acc[1] = reading->y();
+    m_acc[2] = reading->z();
+    m_accValid = true;
+
+    // Without a gyro the accelerometer drives the estimator itself
+    if (!m_gyroActive)
+        updateAttitude(0.0, 0.0, 0.0, timestamp);
+
+    AccelSample sample;
+    if (readAcc(sample, timestamp))
+        m_bus->accel.Push(sample);
+}
+
+void SensorManager::gyroReadingChanged()
+{
+    QGyroscopeReading* reading = sensorGyro->reading();
+    if (!reading)
+        return;
+
+    quint64 timestamp = reading->timestamp();
+    if (!acceptTimestamp(m_gyroRate, timestamp))
+        return;
+
+    m_gyroActive = true;
+    if (m_accValid) {
+        updateAttitude(reading->x() * DEG_TO_RAD, reading->y() * DEG_TO_RAD,
+                       reading->z() * DEG_TO_RAD, timestamp);
+    }
+}
+
+void SensorManager::magReadingChanged()
+{
+    QMagnetometerReading* reading = sensorMag->reading();
+    if (!reading)
+        return;
+
+    m_mag[0] = reading->x();
+    m_mag[1] = reading->y();
+    m_mag[2] = reading->z();
+    m_magValid = true;
+}
+
+void SensorManager::updateAttitude(qreal gx, qreal gy, qreal gz, quint64 timestamp)
+{
+    // Gyro and accelerometer share the sensor clock; a step backwards (the
+    // fallback clock taking over) just skips one integration step
+    qreal dt = 0.0;
+    if (m_attitudeTimestamp > 0 && timestamp > m_attitudeTimestamp)
+        dt = (timestamp - m_attitudeTimestamp) * 1e-6;
+    m_attitudeTimestamp = timestamp;
+
+    m_attitude.Update(gx, gy, gz, m_acc[0], m_acc[1], m_acc[2],
+                      m_mag[0], m_mag[1], m_mag[2], dt);
+}
+
+void SensorManager::temperatureReadingChanged()
+{
+    QAmbientTemperatureReading* reading = sensorTemperature->reading();
+    if (!reading)
+        return;
+
+    TemperatureSample sample;
+    sample.timestamp = reading->timestamp();
+    if (sample.timestamp == 0)
+        sample.timestamp = quint64(m_clock.nsecsElapsed() / 1000);
+    sample.temperature = reading->temperature();
+    m_bus->temperature.Push(sample);
+}
+
+QString SensorManager::rateReport(const char *name, SensorRate &rate, qint64 elapsedMs)
+{
+    const qreal achieved = elapsedMs > 0 ? rate.samples * 1000.0 / elapsedMs : 0.0;
+    QString line = QString("%1: %2 Hz achieved, requested %3, sensor reports %4 Hz (max %5), %6 duplicates")
+                       .arg(name)
+                       .arg(achieved, 0, 'f', 1)
+                       .arg(rate.requested > 0 ? QString::number(rate.requested) : QString("max"))
+                       .arg(rate.reported)
+                       .arg(rate.maximum)
+                       .arg(rate.duplicates);
+    rate.samples = 0;
+    rate.duplicates = 0;
+    return line;
+}
+
+void SensorManager::reportRates()
+{
+    const qint64 elapsed = m_reportClock.restart();
+
+    QStringList lines;
+    if (sensorPressure)
+        lines << rateReport("pressure", m_pressureRate, elapsed)
+                     + QString(", %1 dropped").arg(m_bus->pressure.Dropped());
+    if (sensorAcc)
+        lines << rateReport("accelerometer", m_accRate, elapsed)
+                     + QString(", %1 dropped").arg(m_bus->accel.Dropped());
+    if (sensorGyro)
+        lines << rateReport("gyroscope", m_gyroRate, elapsed);
+    if (lines.isEmpty())
+        return;
+
+    QString report = lines.join("\n");
+    qDebug().noquote() << report;
+    emit sendRateReport(report);
 }
 
 void SensorManager::setStop()
 {
     m_stop = true;
+    quit();
 }
 
 void SensorManager::run()
 {
-    while (!m_stop)
-    {
-        if(m_stop)
-            break;
-
-        processAccelerometerData();
-        emit sendPressureInfo(readPressure());
-        emit sendAccInfo(readAcc());
-        msleep(50);
-    }
+    // Sensors are created here so their readings arrive on this thread's
+    // event loop, one readingChanged per sample, at the negotiated rate.
+    m_clock.start();
+    startSensors();
+
+    QTimer reportTimer;
+    connect(&reportTimer, &QTimer::timeout, this, &SensorManager::reportRates, Qt::DirectConnection);
+    m_reportClock.start();
+    reportTimer.start(RATE_REPORT_INTERVAL_MS);
+
+    if (!m_stop)
+        exec();
+
+    reportTimer.stop();
+    stopSensors();
 }
 
 QList<qreal> SensorManager::readTemperature()
@@ -167,16 +381,18 @@ QList<qreal> SensorManager::readTemperature()
     return temp;
 }
 
-QList<qreal> SensorManager::readPressure()
+bool SensorManager::readPressure(PressureSample &sample)
 {
-    QList <qreal> temp;
     if(!sensorPressure)
-        return temp;
+        return false;
 
-    temp.clear();
-    temp.append(sensorPressure->reading()->property("pressure").value<qreal>());
-    temp.append(sensorPressure->reading()->property("temperature").value<qreal>());
-    temp.append(sensorPressure->reading()->property("timestamp").value<qreal>());
+    QPressureReading* reading = sensorPressure->reading();
+    if (!reading)
+        return false;
+
+    sample.timestamp = reading->timestamp();
+    sample.pressure = reading->pressure();
+    sample.temperature = reading->temperature();
 
     // const QMetaObject *metaObj = sensorPressure->reading()->metaObject();
     // for (int i = 0; i < metaObj->propertyCount(); ++i) {
@@ -184,7 +400,7 @@ QList<qreal> SensorManager::readPressure()
     //              << sensorPressure->reading()->property(metaObj->property(i).name());
     // }
 
-    return temp;
+    return true;
 }
 
 QList<qreal> SensorManager::readGyro()
@@ -211,77 +427,62 @@ QList<qreal> SensorManager::readCompass()
     return temp;
 }
 
-// Modify your readAcc() function to also process roll and pitch
-QList<qreal> SensorManager::readAcc()
-{
-    QList<qreal> temp;
-    if (!sensorAcc)
-        return temp;
-
-    QAccelerometerReading* reading = sensorAcc->reading();
-    if (!reading)
-        return temp;
-    // Process accelerometer data and update roll/pitch
-    processAccelerometerData();
-
-    // Add roll and pitch to the return values
-    temp.append(m_roll);
-    temp.append(m_pitch);
-    temp.append(reading->x());
-    temp.append(reading->y());
-    temp.append(reading->z());
-
-    return temp;
-}
-
-void SensorManager::processAccelerometerData()
+// Fills the sample with the raw axes plus the attitude, roll/pitch and vertical acceleration
+bool SensorManager::readAcc(AccelSample &sample, quint64 timestamp)
 {
     if (!sensorAcc)
-        return;
+        return false;
 
     QAccelerometerReading* reading = sensorAcc->reading();
     if (!reading)
-        return;
-
-    const qreal alpha = 0.1;
-
-    // Telefon dikey tutulduğunda:
-    // x: sağ-sol yatırma (roll)
-    // y: öne-arkaya eğme (pitch)
-    // z: dikey eksen
-    m_accX = m_accX * (1 - alpha) + reading->y() * alpha;  // Roll için Y ekseni
-    m_accY = m_accY * (1 - alpha) - reading->x() * alpha;  // Pitch için X ekseni (ters)
-    m_accZ = m_accZ * (1 - alpha) + reading->z() * alpha;
-
-    m_roll = calculateRoll();
-    m_pitch = calculatePitch();
+        return false;
+
+    sample.timestamp = timestamp;
+    sample.x = reading->x();
+    sample.y = reading->y();
+    sample.z = reading->z();
+
+    const Quaternion &q = m_attitude.Attitude();
+    sample.qw = q.w;
+    sample.qx = q.x;
+    sample.qy = q.y;
+    sample.qz = q.z;
+    sample.heading = m_magValid && m_attitude.IsInitialized()
+                         ? m_attitude.Heading()
+                         : std::numeric_limits<double>::quiet_NaN();
+
+    // Same angles the app always showed, now from the estimated up vector:
+    // roll tilts about the device y axis, pitch about x
+    qreal ux, uy, uz;
+    m_attitude.Up(ux, uy, uz);
+    sample.roll = atan2(-ux, sqrt(uy * uy + uz * uz)) * RAD_TO_DEG;
+    sample.pitch = atan2(uy, uz) * RAD_TO_DEG;
+    sample.vertical = calculateVerticalAcceleration(reading, timestamp);
+
+    return true;
 }
 
-qreal SensorManager::calculateRoll()
+qreal SensorManager::calculateVerticalAcceleration(const QAccelerometerReading* reading,
+                                                   quint64 timestamp)
 {
-    // Pitch hesaplaması (öne-arkaya eğme)
-    qreal acc_total = sqrt(m_accX * m_accX + m_accY * m_accY + m_accZ * m_accZ);
-
-    if (acc_total == 0)
+    if (!m_attitude.IsInitialized())
         return 0.0;
 
-    qreal roll = atan2(m_accY, sqrt(m_accX * m_accX + m_accZ * m_accZ)) * RAD_TO_DEG;
-
-    // -90 ile +90 derece arasına normalize et
-    if (roll > 90) roll = 180 - roll;
-    if (roll < -90) roll = -180 - roll;
-
-    return roll;
-}
-
-qreal SensorManager::calculatePitch()
-{
-    // Roll hesaplaması (sağ-sol yatırma)
-    qreal pitch = atan2(m_accX, m_accZ) * RAD_TO_DEG;
-
-    // -180 ile +180 derece arasına normalize et
-    if (pitch > 180) pitch -= 360;
-    if (pitch < -180) pitch += 360;
-
-    return pitch;
+    // Rotate the measurement into the earth-frame vertical
+    qreal up = m_attitude.Vertical(reading->x(), reading->y(), reading->z());
+
+    // Remove gravity. Tracking it slowly instead of using 9.80665 also
+    // absorbs the accelerometer's own scale and offset error. The time
+    // constant is fixed in seconds, so the IMU's data rate does not decide
+    // how much of a climb's onset is taken for gravity.
+    qreal dt = 0.0;
+    if (m_gravityTimestamp > 0 && timestamp > m_gravityTimestamp)
+        dt = (timestamp - m_gravityTimestamp) * 1e-6;
+    m_gravityTimestamp = timestamp;
+    if (m_gravity == 0)
+        m_gravity = up;
+    const qreal beta = dt / (GRAVITY_TIME_CONSTANT_S + dt);
+    m_gravity = m_gravity * (1 - beta) + up * beta;
+
+    return up - m_gravity;
 }
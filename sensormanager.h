@@ -10,28 +10,48 @@
 #include <QAccelerometer>
 #include <QGyroscope>
 #include <QCompass>
+#include <QMagnetometer>
 #include <QAmbientTemperatureSensor>
 #include <QMetaProperty>
+#include <QHash>
+#include <QElapsedTimer>
+#include <atomic>
+#include "SensorSamples.h"
+#include "AttitudeEstimator.h"
+
+#define RATE_REPORT_INTERVAL_MS 10000       // How often achieved sample rates are logged
+#define GRAVITY_TIME_CONSTANT_S 5.0         // Averaging time of the gravity estimate
+
+// Per-sensor acquisition bookkeeping, touched only by the sensor thread
+struct SensorRate {
+    int requested = 0;          // Hz asked for, 0 means the sensor maximum
+    int maximum = 0;            // Highest rate the backend advertises, 0 if unknown
+    int reported = 0;           // dataRate() after start
+    quint64 samples = 0;        // Samples delivered since the last report
+    quint64 duplicates = 0;     // Readings discarded because the timestamp did not advance
+    quint64 firstTimestamp = 0; // Sensor timestamps (us) spanning the report window
+    quint64 lastTimestamp = 0;
+};
 
 class SensorManager : public QThread
 {
     Q_OBJECT
 
 public:
-    explicit SensorManager(QObject *parent = nullptr);
+    explicit SensorManager(SensorBus *bus, QObject *parent = nullptr);
     ~SensorManager();
 
-    Q_INVOKABLE QList <qreal> readPressure();
+    bool readPressure(PressureSample &sample);
+    bool readAcc(AccelSample &sample, quint64 timestamp);
     Q_INVOKABLE QList <qreal> readGyro();
-    Q_INVOKABLE QList <qreal> readAcc();
     Q_INVOKABLE QList <qreal> readCompass();
     Q_INVOKABLE QList <qreal> readTemperature();
 
     void findSensors();
     void startSensors();
-    void readSensorValues();
-    qreal calculateRoll();
-    qreal calculatePitch();
+    void stopSensors();
+    void setRequestedRate(const QByteArray &type, int hz);
+    qreal calculateVerticalAcceleration(const QAccelerometerReading* reading, quint64 timestamp);
 
     void setStop();
 
@@ -40,27 +60,51 @@ private:
     QAccelerometer* sensorAcc = nullptr;
     QGyroscope* sensorGyro = nullptr;
     QCompass* sensorCompass = nullptr;
+    QMagnetometer* sensorMag = nullptr;
     QAmbientTemperatureSensor* sensorTemperature = nullptr;
 
-    void processAccelerometerData();
+    void updateAttitude(qreal gx, qreal gy, qreal gz, quint64 timestamp);
     static constexpr qreal RAD_TO_DEG = 180.0 / M_PI;
+    static constexpr qreal DEG_TO_RAD = M_PI / 180.0;
+
+    // Attitude from gyro, accelerometer and magnetometer, updated once per
+    // gyro sample, or per accelerometer sample on devices without a gyro
+    AttitudeEstimator m_attitude;
+    quint64 m_attitudeTimestamp = 0;
+    qreal m_acc[3] = {0.0, 0.0, 0.0};   // Latest readings, device frame
+    qreal m_mag[3] = {0.0, 0.0, 0.0};   // Zero until the magnetometer reports
+    bool m_accValid = false;
+    bool m_gyroActive = false;
+    bool m_magValid = false;
+    qreal m_gravity = 0.0;      // Slow average of the vertical specific force
+    quint64 m_gravityTimestamp = 0;
+
+    std::atomic<bool> m_stop{false};   // Set by setStop() from the GUI thread
+    SensorBus *m_bus;           // Pressure and accelerometer samples go here
+
+    QHash<QByteArray, int> m_requestedRates;    // Set before start(), keyed by sensor type
+    SensorRate m_pressureRate;
+    SensorRate m_accRate;
+    SensorRate m_gyroRate;
+    QElapsedTimer m_clock;      // Fallback timestamps for backends that report none
 
-    // Add these member variables to store processed values
-    qreal m_roll = 0.0;
-    qreal m_pitch = 0.0;
-    qreal m_accX = 0.0;
-    qreal m_accY = 0.0;
-    qreal m_accZ = 0.0;
+    void configureDataRate(QSensor *sensor, SensorRate &rate);
+    bool acceptTimestamp(SensorRate &rate, quint64 &timestamp);
+    QString rateReport(const char *name, SensorRate &rate, qint64 elapsedMs);
 
-    bool m_stop;
+private slots:
+    void pressureReadingChanged();
+    void accReadingChanged();
+    void gyroReadingChanged();
+    void magReadingChanged();
+    void temperatureReadingChanged();
+    void reportRates();
 
 signals:
-    void sendPressureInfo(QList <qreal>);
-    void sendAccInfo(QList <qreal>);
-    void sendGyroInfo(QList <qreal>);
-    void sendCompassInfo(QList <qreal>);
+    void sendRateReport(QString);
 private:
     QList<QSensor*> mySensorList;
+    QElapsedTimer m_reportClock;
 
 protected:
     void run() override;
@@ -0,0 +1,14 @@
+# Micro-benchmarks of the vario core's hot paths, so the speed figures behind
+# the filter and conversion code can be reproduced on any machine. Build it
+# the way the app is built (e.g. release, or with -march=haswell for AVX2).
+
+TEMPLATE = app
+TARGET = bench
+
+CONFIG += console c++17 thread release
+CONFIG -= app_bundle qt
+
+include(../../libvario/libvario.pri)
+
+SOURCES += \
+    main.cpp
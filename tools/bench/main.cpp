@@ -0,0 +1,403 @@
+// bench: times the hot paths of the vario core and prints the cost of one
+// operation of each, so the figures quoted for them can be reproduced.
+//
+//   bench [-t SECONDS] [name...]
+//
+// runs every benchmark whose name starts with one of the given names, or all
+// of them. Each is run for about SECONDS (default 0.2) several times and the
+// fastest round is reported, which filters out scheduler noise. Accuracy
+// reports, selected the same way, follow the timings.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "AltitudeTable.h"
+#include "AttitudeEstimator.h"
+#include "CaptureWriter.h"
+#include "Decimator.h"
+#include "FlightModel.h"
+#include "KalmanFilter.h"
+#include "KalmanFilterBank.h"
+#include "KalmanFilterN.h"
+#include "KalmanFilterUD.h"
+#include "KalmanSmoother.h"
+
+namespace {
+
+// Keeps results alive so the optimizer cannot drop the work producing them.
+volatile double g_sink;
+
+struct Benchmark {
+  const char* name;
+  const char* unit;  // What one operation is
+  // Runs the operation n times.
+  std::function<void(std::size_t n)> run;
+};
+
+// A figure that is not a time, e.g. the error of an approximation.
+struct Report {
+  const char* name;
+  std::function<void()> run;  // Prints its own lines
+};
+
+// Seconds for n operations of a benchmark.
+double Time(const Benchmark& bench, std::size_t n)
+{
+  const auto start = std::chrono::steady_clock::now();
+  bench.run(n);
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Nanoseconds per operation: the best of five rounds of about `seconds`.
+double Measure(const Benchmark& bench, double seconds)
+{
+  std::size_t n = 1;
+  while (Time(bench, n) < seconds / 20)
+    n *= 2;
+  n *= 4;
+  double best = 0;
+  for (int round = 0; round < 5; ++round) {
+    const double ns = Time(bench, n) * 1e9 / n;
+    if (round == 0 || ns < best)
+      best = ns;
+  }
+  return best;
+}
+
+// Noisy samples around a slow climb, shared by the filter benchmarks.
+std::vector<double> Pressures(std::size_t n)
+{
+  std::mt19937 rng(1);
+  std::normal_distribution<double> noise(0.0, 2.0);
+  std::vector<double> p(n);
+  for (std::size_t k = 0; k < n; ++k)
+    p[k] = 90000.0 - 0.1 * k + noise(rng);
+  return p;
+}
+
+constexpr std::size_t kSamples = 4096;  // Power of two, indexed with a mask
+constexpr std::size_t kLanes = 64;
+
+// KalmanFilterBank against the same number of scalar filters, per lane update.
+void AddFilterBank(std::vector<Benchmark>& benches)
+{
+  benches.push_back({"bank/scalar", "lane update", [](std::size_t n) {
+    static const std::vector<double> z = Pressures(kSamples);
+    std::vector<KalmanFilter> filters(kLanes, KalmanFilter(0.75));
+    for (KalmanFilter& f : filters)
+      f.Reset(z[0]);
+    for (std::size_t done = 0; done < n; done += kLanes)
+      for (std::size_t lane = 0; lane < kLanes; ++lane)
+        filters[lane].Update(z[(done / kLanes + lane) & (kSamples - 1)], 0.25, 0.01);
+    g_sink = filters[0].GetXAbs();
+  }});
+  benches.push_back({"bank/simd", "lane update", [](std::size_t n) {
+    static const std::vector<double> z = Pressures(kSamples + kLanes);
+    KalmanFilterBank bank(kLanes, 0.75);
+    bank.ResetAll(z[0]);
+    for (std::size_t done = 0; done < n; done += kLanes)
+      bank.Update(&z[(done / kLanes) & (kSamples - 1)], 0.25, 0.01);
+    g_sink = bank.GetXAbs(0);
+  }});
+}
+
+// One Update of a single altitude filter, fed a noisy climb at 100 Hz. T is
+// the filter's arithmetic type, Z the type of its measurement.
+template<typename Filter, typename T, typename Z = T>
+Benchmark FilterUpdate(const char* name)
+{
+  return {name, "update", [](std::size_t n) {
+    static const std::vector<double> z = Pressures(kSamples);
+    Filter filter(T(0.75));
+    filter.Reset(Z(z[0]));
+    for (std::size_t k = 0; k < n; ++k)
+      filter.Update(Z(z[k & (kSamples - 1)]), T(0.25), T(0.01));
+    g_sink = filter.GetXAbs();
+  }};
+}
+
+// The compile-time sized models against the hand-written 2-state filter.
+void AddFilterModels(std::vector<Benchmark>& benches)
+{
+  benches.push_back(FilterUpdate<KalmanFilter, double>("filter/2state"));
+  benches.push_back(FilterUpdate<kalman::ConstantVelocityFilter<double>, double>(
+      "filter/n2/double"));
+  benches.push_back(FilterUpdate<kalman::ConstantVelocityFilter<float>, float>(
+      "filter/n2/float"));
+  benches.push_back(FilterUpdate<kalman::ConstantAccelerationFilter<double>, double>(
+      "filter/n3/double"));
+  benches.push_back(FilterUpdate<kalman::ConstantAccelerationFilter<float>, float>(
+      "filter/n3/float"));
+  // Float U-D factors around a double origin
+  benches.push_back(FilterUpdate<KalmanFilterUD, float, double>("filter/ud"));
+}
+
+// The float U-D filter against the double reference over three hours of the
+// demo flight, repeated, at 100 Hz with +-30% jitter and an occasional
+// 200 ms gap in the sample intervals, as a phone's pressure sensor delivers
+// them.
+void AddFilterDivergence(std::vector<Report>& reports)
+{
+  reports.push_back({"filter/ud/divergence", [] {
+    std::vector<AirMass> script;
+    for (double start = 0; start < 3 * 3600 - 480; start += 480)
+      for (AirMass mass : FlightModel::DemoScript()) {
+        mass.start += start;
+        script.push_back(mass);
+      }
+    FlightSettings settings;
+    settings.start_altitude = 4000.0;
+    FlightModel model(settings, script);
+
+    std::mt19937 rng(4);
+    std::uniform_real_distribution<double> jitter(0.007, 0.013);
+    std::uniform_int_distribution<int> gap(0, 999);
+    KalmanFilter reference(0.75);
+    KalmanFilterUD ud(0.75f);
+    std::uint64_t now = 0;
+    reference.Reset(model.ReadPressure(now).pressure);
+    ud.Reset(reference.GetXAbs());
+    double max_x = 0, max_v = 0;
+    std::size_t samples = 0;
+    while (model.Time() < model.Duration()) {
+      const double dt = gap(rng) == 0 ? 0.2 : jitter(rng);
+      model.Advance(dt);
+      now += static_cast<std::uint64_t>(dt * 1e6);
+      const double z = model.ReadPressure(now).pressure;
+      reference.Update(z, 0.25, dt);
+      ud.Update(z, 0.25f, static_cast<float>(dt));
+      max_x = std::max(max_x, std::fabs(ud.GetXAbs() - reference.GetXAbs()));
+      max_v = std::max(max_v, std::fabs(ud.GetXVel() - reference.GetXVel()));
+      ++samples;
+    }
+    std::printf("%-24s %10.2e Pa   max |dx| over %zu samples, %.1f h\n",
+                "filter/ud/divergence", max_x, samples, model.Time() / 3600);
+    std::printf("%-24s %10.2e Pa/s max |dv|\n", "", max_v);
+  }});
+}
+
+// Decimator throughput per input sample, sample by sample as the processor
+// feeds it.
+Benchmark Decimation(const char* name, std::size_t ratio, std::size_t taps)
+{
+  return {name, "input sample", [ratio, taps](std::size_t n) {
+    static const std::vector<double> x = Pressures(kSamples);
+    Decimator decimator(ratio, taps);
+    double sum = 0;
+    for (std::size_t k = 0; k < n; ++k)
+      if (decimator.Add(x[k & (kSamples - 1)]))
+        sum += decimator.Output();
+    g_sink = sum;
+  }};
+}
+
+void AddDecimator(std::vector<Benchmark>& benches)
+{
+  benches.push_back(Decimation("decimate/4x32", 4, 32));
+  benches.push_back(Decimation("decimate/8x32", 8, 32));
+  benches.push_back(Decimation("decimate/4x64", 4, 64));
+}
+
+// Pressure to altitude per sample: the exact formula (std::pow) against the
+// table, one by one and in batches, over random pressures of 500-1050 hPa.
+void AddAltitude(std::vector<Benchmark>& benches)
+{
+  static std::vector<double> hpa = [] {
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<double> dist(500.0, 1050.0);
+    std::vector<double> p(kSamples);
+    for (double& v : p)
+      v = dist(rng);
+    return p;
+  }();
+
+  benches.push_back({"altitude/pow", "sample", [](std::size_t n) {
+    double sum = 0;
+    for (std::size_t k = 0; k < n; ++k)
+      sum += AltitudeTable::Exact(hpa[k & (kSamples - 1)], 1020.0);
+    g_sink = sum;
+  }});
+  benches.push_back({"altitude/table", "sample", [](std::size_t n) {
+    const AltitudeTable table(1020.0);
+    double sum = 0;
+    for (std::size_t k = 0; k < n; ++k)
+      sum += table.Altitude(hpa[k & (kSamples - 1)]);
+    g_sink = sum;
+  }});
+  benches.push_back({"altitude/batch", "sample", [](std::size_t n) {
+    const AltitudeTable table(1020.0);
+    std::vector<double> out(kSamples);
+    for (std::size_t done = 0; done < n; done += kSamples)
+      table.Altitude(hpa.data(), std::min(kSamples, n - done), out.data());
+    g_sink = out[0];
+  }});
+}
+
+// One AttitudeEstimator update per IMU sample of a slow turn, with and
+// without a magnetometer.
+void AddAttitude(std::vector<Benchmark>& benches)
+{
+  struct Imu {
+    double g[3], a[3], m[3];
+  };
+  static std::vector<Imu> imu = [] {
+    std::mt19937 rng(3);
+    std::normal_distribution<double> noise(0.0, 0.02);
+    std::vector<Imu> samples(kSamples);
+    for (Imu& s : samples)
+      s = {{0.02 + noise(rng), -0.01 + noise(rng), 0.3 + noise(rng)},
+           {noise(rng), noise(rng), 9.81 + noise(rng)},
+           {20.0 + noise(rng), noise(rng), -40.0 + noise(rng)}};
+    return samples;
+  }();
+
+  benches.push_back({"attitude/imu", "update", [](std::size_t n) {
+    AttitudeEstimator estimator;
+    for (std::size_t k = 0; k < n; ++k) {
+      const Imu& s = imu[k & (kSamples - 1)];
+      estimator.Update(s.g[0], s.g[1], s.g[2], s.a[0], s.a[1], s.a[2], 0.01);
+    }
+    g_sink = estimator.Attitude().w;
+  }});
+  benches.push_back({"attitude/mag", "update", [](std::size_t n) {
+    AttitudeEstimator estimator;
+    for (std::size_t k = 0; k < n; ++k) {
+      const Imu& s = imu[k & (kSamples - 1)];
+      estimator.Update(s.g[0], s.g[1], s.g[2], s.a[0], s.a[1], s.a[2],
+                       s.m[0], s.m[1], s.m[2], 0.01);
+    }
+    g_sink = estimator.Attitude().w;
+  }});
+}
+
+// The RTS smoother over a whole 10 hour trace at 50 Hz, noisy pressure that
+// climbs and sinks 50 Pa every 10 minutes; the best of three passes.
+void AddSmoother(std::vector<Report>& reports)
+{
+  reports.push_back({"smoother/10h", [] {
+    constexpr double kRate = 50.0;
+    constexpr std::size_t kTrace = static_cast<std::size_t>(10 * 3600 * kRate);
+    std::mt19937 rng(5);
+    std::normal_distribution<double> noise(0.0, 2.0);
+    std::vector<double> z(kTrace), x(kTrace), v(kTrace);
+    for (std::size_t k = 0; k < kTrace; ++k)
+      z[k] = 90000.0 + 50.0 * std::sin(k * (2 * 3.14159265358979 / (600 * kRate))) + noise(rng);
+
+    KalmanSmoother smoother(0.75, 0.25);
+    double best = 0;
+    for (int round = 0; round < 3; ++round) {
+      const auto start = std::chrono::steady_clock::now();
+      smoother.Smooth(z.data(), kTrace, 1 / kRate, x.data(), v.data());
+      const double seconds =
+          std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      if (round == 0 || seconds < best)
+        best = seconds;
+    }
+    g_sink = x[kTrace / 2] + v[kTrace / 2];
+    std::printf("%-24s %10.3f s per trace of %zu samples, %.2f ns per sample\n",
+                "smoother/10h", best, kTrace, best * 1e9 / kTrace);
+  }});
+}
+
+// Producer-side cost of recording one sample, as the app pays it on the
+// engine thread. Flat out, the producer fills batches faster than any writer
+// can take them and the cheap drop path skews the figure, so the producer is
+// paced at 200 k samples/s, far above the sensors' rate, with FlushIfDue()
+// after every 32 samples, and every Write() is timed on its own. The times
+// include one steady_clock read. The writer thread goes to the null device.
+void AddCapture(std::vector<Report>& reports)
+{
+  reports.push_back({"capture/write", [] {
+    using Clock = std::chrono::steady_clock;
+    constexpr std::size_t kWrites = 200000;
+    constexpr auto kPeriod = std::chrono::microseconds(5);
+    CaptureWriter writer;
+    if (!writer.Open("/dev/null")) {
+      std::printf("%-24s cannot open /dev/null\n", "capture/write");
+      return;
+    }
+    std::vector<double> ns(kWrites);
+    PressureSample sample{};
+    Clock::time_point next = Clock::now();
+    for (std::size_t k = 0; k < kWrites; ++k) {
+      while (Clock::now() < next) {
+      }
+      next += kPeriod;
+      sample.timestamp = k;
+      sample.pressure = 90000.0 + (k & 255);
+      const Clock::time_point start = Clock::now();
+      writer.Write(sample);
+      if ((k & 31) == 31)
+        writer.FlushIfDue();
+      ns[k] = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    }
+    writer.Close();
+    std::sort(ns.begin(), ns.end());
+    std::printf("%-24s %10.2f ns median, %.2f ns p99.9, %.2f ns max per sample, %llu dropped\n",
+                "capture/write", ns[kWrites / 2], ns[kWrites * 999 / 1000], ns.back(),
+                static_cast<unsigned long long>(writer.Dropped()));
+  }});
+}
+
+void Usage()
+{
+  std::fprintf(stderr, "usage: bench [-t SECONDS] [name...]\n");
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  double seconds = 0.2;
+  std::vector<std::string> filters;
+  for (int i = 1; i < argc; ++i) {
+    if (!std::strcmp(argv[i], "-t") && i + 1 < argc) {
+      seconds = std::atof(argv[++i]);
+    } else if (argv[i][0] == '-') {
+      Usage();
+      return 2;
+    } else {
+      filters.push_back(argv[i]);
+    }
+  }
+
+  std::vector<Benchmark> benches;
+  AddFilterBank(benches);
+  AddFilterModels(benches);
+  AddDecimator(benches);
+  AddAltitude(benches);
+  AddAttitude(benches);
+
+  std::vector<Report> reports;
+  AddFilterDivergence(reports);
+  AddSmoother(reports);
+  AddCapture(reports);
+
+  auto selected = [&](const std::string& name) {
+    return filters.empty() ||
+        std::any_of(filters.begin(), filters.end(), [&](const std::string& f) {
+          return name.compare(0, f.size(), f) == 0;
+        });
+  };
+  for (const Benchmark& bench : benches) {
+    if (!selected(bench.name))
+      continue;
+    std::printf("%-24s %10.2f ns per %s\n", bench.name, Measure(bench, seconds), bench.unit);
+    std::fflush(stdout);
+  }
+  for (const Report& report : reports) {
+    if (!selected(report.name))
+      continue;
+    report.run();
+    std::fflush(stdout);
+  }
+  return 0;
+}
@@ -0,0 +1,119 @@
+#ifndef WORKSTEALINGPOOL_H
+#define WORKSTEALINGPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size thread pool where every worker owns a task deque. Workers take
+// their own work from the back and, once idle, steal from the front of the
+// other deques, so uneven tasks (logs of very different length) still keep
+// every core busy until the end.
+class WorkStealingPool {
+  using Task = std::function<void()>;
+
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<std::thread> threads_;
+
+  std::mutex wake_mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  std::atomic<std::size_t> queued_{0};   // Tasks sitting in a deque.
+  std::atomic<std::size_t> pending_{0};  // Tasks submitted but not finished.
+  std::atomic<std::size_t> next_{0};
+  bool stop_ = false;
+
+  bool TryPop(std::size_t self, Task& task) {
+    const std::size_t n = queues_.size();
+    for (std::size_t i = 0; i < n; ++i) {
+      Queue& q = *queues_[(self + i) % n];
+      std::lock_guard<std::mutex> lock(q.mutex);
+      if (q.tasks.empty())
+        continue;
+      if (i == 0) {
+        task = std::move(q.tasks.back());
+        q.tasks.pop_back();
+      } else {
+        task = std::move(q.tasks.front());
+        q.tasks.pop_front();
+      }
+      --queued_;
+      return true;
+    }
+    return false;
+  }
+
+  void WorkerLoop(std::size_t self) {
+    for (;;) {
+      Task task;
+      if (TryPop(self, task)) {
+        task();
+        if (pending_.fetch_sub(1) == 1) {
+          std::lock_guard<std::mutex> lock(wake_mutex_);
+          done_.notify_all();
+        }
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(wake_mutex_);
+      wake_.wait(lock, [this] { return stop_ || queued_ > 0; });
+      if (stop_ && queued_ == 0)
+        return;
+    }
+  }
+
+ public:
+  explicit WorkStealingPool(unsigned threads = std::thread::hardware_concurrency()) {
+    if (threads == 0)
+      threads = 1;
+    for (unsigned i = 0; i < threads; ++i)
+      queues_.push_back(std::make_unique<Queue>());
+    for (unsigned i = 0; i < threads; ++i)
+      threads_.emplace_back(&WorkStealingPool::WorkerLoop, this, i);
+  }
+
+  ~WorkStealingPool() {
+    {
+      std::lock_guard<std::mutex> lock(wake_mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& t : threads_)
+      t.join();
+  }
+
+  std::size_t Size() const { return threads_.size(); }
+
+  void Submit(Task task) {
+    ++pending_;
+    Queue& q = *queues_[next_++ % queues_.size()];
+    // Count the task before it becomes visible so the counter never dips
+    // below zero when a thief grabs it straight away.
+    {
+      std::lock_guard<std::mutex> lock(wake_mutex_);
+      ++queued_;
+    }
+    {
+      std::lock_guard<std::mutex> lock(q.mutex);
+      q.tasks.push_back(std::move(task));
+    }
+    wake_.notify_one();
+  }
+
+  // Blocks until every task submitted so far has finished.
+  void Wait() {
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    done_.wait(lock, [this] { return pending_ == 0; });
+  }
+};
+
+#endif // WORKSTEALINGPOOL_H
@@ -0,0 +1,16 @@
+# Kalman filter auto-tuner. Headless console tool; shares the filter code
+# with the app so tuning replays exactly what runs on the phone.
+
+TEMPLATE = app
+TARGET = kftune
+
+CONFIG += console c++17 thread
+CONFIG -= app_bundle qt
+
+include(../../libvario/libvario.pri)
+
+SOURCES += \
+    main.cpp
+
+HEADERS += \
+    WorkStealingPool.h
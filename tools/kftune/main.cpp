@@ -0,0 +1,494 @@
+// kftune: searches the Kalman filter variances of the vario over recorded
+// pressure logs and writes the winner as the app's filter config file.
+//
+// Every candidate setting is replayed through VarioProcessor, i.e. the same
+// math as MainWindow::updatePressureAndAltitude(), and compared with a
+// lag-free reference climb rate from KalmanSmoother. The score combines the
+// lag of the vario behind that reference with the noise left once the lag is
+// taken out; lower is better.
+//
+// Logs with vertical acceleration are replayed through the IMU-aided filter
+// as in flight, and then the variances searched are the ones that filter
+// uses: var_accel_input and var_measurement. Baro-only logs tune var_accel
+// and var_measurement of the baro filters.
+//
+// Log format: a capture file written by the app (.vcap), recognized by its
+// header, or text with one sample per line,
+//
+//   <timestamp_us> <pressure_pa> [<vertical_accel_ms2>]
+//
+// separated by whitespace or a comma, as read by vario-cli. Lines starting
+// with '#' are ignored.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "CaptureReader.h"
+#include "KalmanSmoother.h"
+#include "VarioProcessor.h"
+#include "WorkStealingPool.h"
+
+namespace {
+
+struct Options {
+  std::vector<std::string> logs;
+  std::string output = "kalman.ini";
+  bool descent = false;
+  int grid = 12;
+  double min_var = 1e-3;
+  double max_var = 10;
+  double lag_weight = 1.0;   // Score per second of lag, in m/s.
+  double max_lag = 3.0;      // Longest lag searched, in seconds.
+  double warmup = 10.0;      // Seconds ignored at the start of every log.
+  double ref_accel = 0.75;   // Settings of the reference smoother.
+  double ref_measurement = 0.25;
+  int extend = 3;            // Times the grid may grow past an edge winner.
+  unsigned threads = 0;
+};
+
+// One pressure or acceleration sample of a log, in the order they arrived,
+// with the time since the previous sample of the same sensor.
+struct Event {
+  bool accel;
+  double value;  // Pa or m/s^2
+  double dt;     // s
+};
+
+struct Log {
+  std::string name;
+  std::vector<Event> events;
+  std::vector<double> pressure;   // Pa
+  std::vector<double> dt;         // s, dt[0] unused
+  std::vector<double> reference;  // Smoothed climb rate, m/s
+  double mean_dt = 0;
+  bool has_accel = false;
+};
+
+struct Candidate {
+  VarioSettings settings;
+  double score = 0;
+  double lag = 0;
+  double noise = 0;
+};
+
+struct Metrics {
+  double score = 0;
+  double lag = 0;
+  double noise = 0;
+};
+
+void Usage()
+{
+  std::fprintf(stderr,
+      "usage: kftune [options] log...\n"
+      "  -o FILE           config file to write (default kalman.ini)\n"
+      "  --descent         coordinate descent instead of a grid search\n"
+      "  --grid N          grid points per variance (default 12)\n"
+      "  --range MIN MAX   variance search range (default 1e-3 10)\n"
+      "  --extend N        grow the grid past an edge winner up to N times (default 3)\n"
+      "  --lag-weight W    score per second of lag in m/s (default 1)\n"
+      "  --ref A M         reference smoother variances (default 0.75 0.25)\n"
+      "  -j N              worker threads (default: all cores)\n");
+}
+
+bool ParseOptions(int argc, char** argv, Options& opt)
+{
+  for (int i = 1; i < argc; ++i) {
+    const char* a = argv[i];
+    auto need = [&](int count) {
+      if (i + count >= argc) {
+        std::fprintf(stderr, "kftune: %s needs %d argument(s)\n", a, count);
+        return false;
+      }
+      return true;
+    };
+    if (!std::strcmp(a, "-o")) {
+      if (!need(1)) return false;
+      opt.output = argv[++i];
+    } else if (!std::strcmp(a, "--descent")) {
+      opt.descent = true;
+    } else if (!std::strcmp(a, "--grid")) {
+      if (!need(1)) return false;
+      opt.grid = std::max(2, std::atoi(argv[++i]));
+    } else if (!std::strcmp(a, "--range")) {
+      if (!need(2)) return false;
+      opt.min_var = std::atof(argv[++i]);
+      opt.max_var = std::atof(argv[++i]);
+    } else if (!std::strcmp(a, "--extend")) {
+      if (!need(1)) return false;
+      opt.extend = std::max(0, std::atoi(argv[++i]));
+    } else if (!std::strcmp(a, "--lag-weight")) {
+      if (!need(1)) return false;
+      opt.lag_weight = std::atof(argv[++i]);
+    } else if (!std::strcmp(a, "--ref")) {
+      if (!need(2)) return false;
+      opt.ref_accel = std::atof(argv[++i]);
+      opt.ref_measurement = std::atof(argv[++i]);
+    } else if (!std::strcmp(a, "-j")) {
+      if (!need(1)) return false;
+      opt.threads = static_cast<unsigned>(std::atoi(argv[++i]));
+    } else if (a[0] == '-') {
+      std::fprintf(stderr, "kftune: unknown option %s\n", a);
+      return false;
+    } else {
+      opt.logs.push_back(a);
+    }
+  }
+  return !opt.logs.empty() && opt.min_var > 0 && opt.max_var > opt.min_var;
+}
+
+// Sorts a sample into the log. Acceleration before the first pressure sample
+// is dropped, as the app drops it before the baro has set the altitude.
+class LogBuilder {
+ public:
+  explicit LogBuilder(Log& log) : log_(log) {}
+
+  void Pressure(double t, double pressure)
+  {
+    if (pressure <= 0 || (last_pressure_ >= 0 && t <= last_pressure_))
+      return;  // Duplicate or out-of-order sample.
+    const double dt = last_pressure_ >= 0 ? (t - last_pressure_) * 1e-6 : 0;
+    log_.events.push_back({false, pressure, dt});
+    log_.dt.push_back(dt);
+    log_.pressure.push_back(pressure);
+    last_pressure_ = t;
+  }
+
+  void Acceleration(double t, double accel)
+  {
+    if (last_accel_ >= 0 && t <= last_accel_)
+      return;
+    const double dt = last_accel_ >= 0 ? (t - last_accel_) * 1e-6 : 0;
+    last_accel_ = t;
+    if (dt > 0 && last_pressure_ >= 0) {
+      log_.events.push_back({true, accel, dt});
+      log_.has_accel = true;
+    }
+  }
+
+ private:
+  Log& log_;
+  double last_pressure_ = -1;
+  double last_accel_ = -1;
+};
+
+bool LoadLog(const std::string& path, const Options& opt, Log& log)
+{
+  log.name = path;
+  LogBuilder builder(log);
+
+  CaptureReader capture;
+  if (capture.Open(path)) {
+    CaptureRecord record;
+    while (capture.Next(record)) {
+      if (record.type == capture::kPressure)
+        builder.Pressure(record.pressure.timestamp, record.pressure.pressure);
+      else if (record.type == capture::kAccel)
+        builder.Acceleration(record.accel.timestamp, record.accel.vertical);
+    }
+    if (capture.Corrupt())
+      std::fprintf(stderr, "kftune: %s stopped at a corrupt record\n", path.c_str());
+  } else {
+    std::ifstream in(path);
+    if (!in) {
+      std::fprintf(stderr, "kftune: cannot open %s\n", path.c_str());
+      return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+      if (line.empty() || line[0] == '#')
+        continue;
+      std::replace(line.begin(), line.end(), ',', ' ');
+      std::istringstream fields(line);
+      double t = 0, p = 0, accel = 0;
+      if (!(fields >> t >> p) || t < 0)
+        continue;
+      if (fields >> accel)
+        builder.Acceleration(t, accel);
+      builder.Pressure(t, p);
+    }
+  }
+
+  const std::size_t n = log.pressure.size();
+  if (n < 2) {
+    std::fprintf(stderr, "kftune: %s has no usable samples\n", path.c_str());
+    return false;
+  }
+
+  double total = 0;
+  for (std::size_t k = 1; k < n; ++k)
+    total += log.dt[k];
+  log.mean_dt = total / (n - 1);
+
+  // Lag-free reference climb rate from the smoothed raw altitude.
+  std::vector<double> altitude(n);
+  for (std::size_t k = 0; k < n; ++k)
+    altitude[k] = log.pressure[k] * 0.01;
+  AltitudeTable().Altitude(altitude.data(), n, altitude.data());
+  log.reference.resize(n);
+  KalmanSmoother smoother(opt.ref_accel, opt.ref_measurement);
+  smoother.Smooth(altitude.data(), n, log.dt.data(), nullptr, log.reference.data());
+  return true;
+}
+
+Metrics Evaluate(const Log& log, const VarioSettings& settings, const Options& opt)
+{
+  const std::size_t n = log.pressure.size();
+  std::vector<double> vario(n, 0.0);
+
+  // Same order as the samples arrived, so the IMU-aided filter sees the
+  // predict/correct sequence it would have seen in flight.
+  VarioProcessor processor(settings);
+  std::size_t k = 0;
+  for (const Event& e : log.events) {
+    if (e.accel) {
+      processor.UpdateAcceleration(e.value, e.dt);
+      continue;
+    }
+    if (k > 0) {
+      processor.UpdatePressure(e.value, e.dt);
+      vario[k] = processor.GetVario();
+    }
+    ++k;
+  }
+
+  const std::size_t first = std::min(n - 1, static_cast<std::size_t>(opt.warmup / log.mean_dt));
+  const std::size_t max_lag = static_cast<std::size_t>(opt.max_lag / log.mean_dt);
+
+  // The lag is the shift that best lines the vario up with the reference;
+  // what remains at that shift is noise.
+  Metrics best;
+  double best_mse = -1;
+  for (std::size_t lag = 0; lag <= max_lag && first + lag < n; ++lag) {
+    double sum = 0;
+    for (std::size_t k = first + lag; k < n; ++k) {
+      const double d = vario[k] - log.reference[k - lag];
+      sum += d * d;
+    }
+    const double mse = sum / (n - first - lag);
+    if (best_mse < 0 || mse < best_mse) {
+      best_mse = mse;
+      best.lag = lag * log.mean_dt;
+    }
+  }
+  best.noise = std::sqrt(best_mse);
+  best.score = best.noise + opt.lag_weight * best.lag;
+  return best;
+}
+
+// Scores all candidates over all logs, one pool task per (candidate, log).
+void EvaluateAll(WorkStealingPool& pool, const std::vector<Log>& logs,
+                 std::vector<Candidate>& candidates, const Options& opt)
+{
+  std::vector<Metrics> results(candidates.size() * logs.size());
+  for (std::size_t c = 0; c < candidates.size(); ++c)
+    for (std::size_t l = 0; l < logs.size(); ++l)
+      pool.Submit([&, c, l] {
+        results[c * logs.size() + l] = Evaluate(logs[l], candidates[c].settings, opt);
+      });
+  pool.Wait();
+
+  for (std::size_t c = 0; c < candidates.size(); ++c) {
+    Candidate& cand = candidates[c];
+    cand.score = cand.lag = cand.noise = 0;
+    for (std::size_t l = 0; l < logs.size(); ++l) {
+      const Metrics& m = results[c * logs.size() + l];
+      cand.score += m.score / logs.size();
+      cand.lag += m.lag / logs.size();
+      cand.noise += m.noise / logs.size();
+    }
+  }
+}
+
+// The two variances searched: the process noise of the filter that drives
+// the vario, and the measurement variance of the baro. With acceleration in
+// the logs that filter is the IMU-aided one, whose process noise is the
+// noise of the acceleration input.
+double ProcessVariance(const VarioSettings& settings, bool imu)
+{
+  return imu ? settings.var_accel_input : settings.var_accel;
+}
+
+const char* ProcessVarianceName(bool imu)
+{
+  return imu ? "var_accel_input" : "var_accel";
+}
+
+Candidate WithVariances(double var_process, double var_measurement, bool imu)
+{
+  Candidate c;
+  (imu ? c.settings.var_accel_input : c.settings.var_accel) = var_process;
+  c.settings.var_measurement = var_measurement;
+  return c;
+}
+
+// Log-spaced grid over [min_var, max_var]. When the winner sits on an edge
+// of the grid the optimum is likely outside it, so the grid grows by half its
+// width past that edge, at the same spacing, and only the new points are
+// scored; this repeats up to opt.extend times.
+std::vector<Candidate> GridSearch(WorkStealingPool& pool, const std::vector<Log>& logs,
+                                  const Options& opt, bool imu)
+{
+  const double step = std::log(opt.max_var / opt.min_var) / (opt.grid - 1);
+  const int grow = std::max(1, opt.grid / 2);
+  int lo[2] = {0, 0};                        // Grid index ranges, inclusive,
+  int hi[2] = {opt.grid - 1, opt.grid - 1};  // for process and measurement.
+  int done_lo[2] = {0, 0};
+  int done_hi[2] = {-1, -1};
+
+  std::vector<Candidate> visited;
+  for (int round = 0; ; ++round) {
+    std::vector<Candidate> candidates;
+    for (int a = lo[0]; a <= hi[0]; ++a)
+      for (int m = lo[1]; m <= hi[1]; ++m) {
+        if (a >= done_lo[0] && a <= done_hi[0] && m >= done_lo[1] && m <= done_hi[1])
+          continue;
+        candidates.push_back(WithVariances(opt.min_var * std::exp(a * step),
+                                           opt.min_var * std::exp(m * step), imu));
+      }
+    EvaluateAll(pool, logs, candidates, opt);
+    visited.insert(visited.end(), candidates.begin(), candidates.end());
+    std::copy(lo, lo + 2, done_lo);
+    std::copy(hi, hi + 2, done_hi);
+
+    const Candidate& best = *std::min_element(visited.begin(), visited.end(),
+        [](const Candidate& x, const Candidate& y) { return x.score < y.score; });
+    const double values[2] = {ProcessVariance(best.settings, imu),
+                              best.settings.var_measurement};
+    bool edge = false;
+    for (int i = 0; i < 2; ++i) {
+      const int index = static_cast<int>(std::lround(std::log(values[i] / opt.min_var) / step));
+      if (index == lo[i]) {
+        lo[i] -= grow;
+        edge = true;
+      } else if (index == hi[i]) {
+        hi[i] += grow;
+        edge = true;
+      }
+    }
+    if (!edge)
+      break;
+    if (round == opt.extend) {
+      std::fprintf(stderr, "kftune: best candidate is on the edge of the search range; "
+                           "try a wider --range or --extend\n");
+      break;
+    }
+  }
+  return visited;
+}
+
+std::vector<Candidate> CoordinateDescent(WorkStealingPool& pool, const std::vector<Log>& logs,
+                                         const Options& opt, bool imu)
+{
+  std::vector<Candidate> visited;
+  std::vector<Candidate> current{WithVariances(ProcessVariance(VarioSettings(), imu),
+                                               VarioSettings().var_measurement, imu)};
+  EvaluateAll(pool, logs, current, opt);
+  Candidate best = current[0];
+  visited.push_back(best);
+
+  // Try scaling each variance up and down; shrink the factor when nothing
+  // improves. All neighbours of a step are evaluated in parallel.
+  double factor = 4;
+  while (factor > 1.05) {
+    auto clamp = [&](double v) { return std::min(opt.max_var, std::max(opt.min_var, v)); };
+    const double a = ProcessVariance(best.settings, imu);
+    const double m = best.settings.var_measurement;
+    std::vector<Candidate> neighbours{
+      WithVariances(clamp(a * factor), m, imu), WithVariances(clamp(a / factor), m, imu),
+      WithVariances(a, clamp(m * factor), imu), WithVariances(a, clamp(m / factor), imu)};
+    EvaluateAll(pool, logs, neighbours, opt);
+    visited.insert(visited.end(), neighbours.begin(), neighbours.end());
+
+    auto winner = std::min_element(neighbours.begin(), neighbours.end(),
+                                   [](const Candidate& x, const Candidate& y) {
+                                     return x.score < y.score;
+                                   });
+    if (winner->score < best.score)
+      best = *winner;
+    else
+      factor = std::sqrt(factor);
+  }
+
+  const double a = ProcessVariance(best.settings, imu);
+  const double m = best.settings.var_measurement;
+  if (a <= opt.min_var || a >= opt.max_var || m <= opt.min_var || m >= opt.max_var)
+    std::fprintf(stderr, "kftune: best candidate is on the edge of the search range; "
+                         "try a wider --range\n");
+  return visited;
+}
+
+bool WriteConfig(const std::string& path, const Candidate& best, std::size_t logs, bool imu)
+{
+  std::ofstream out(path);
+  if (!out)
+    return false;
+  out << "; Written by kftune from " << logs << " log(s): score " << best.score
+      << ", lag " << best.lag << " s, noise " << best.noise << " m/s\n"
+      << "[kalman]\n"
+      << ProcessVarianceName(imu) << "=" << ProcessVariance(best.settings, imu) << "\n"
+      << "var_measurement=" << best.settings.var_measurement << "\n";
+  return static_cast<bool>(out);
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  Options opt;
+  if (!ParseOptions(argc, argv, opt)) {
+    Usage();
+    return 2;
+  }
+
+  std::vector<Log> logs(opt.logs.size());
+  for (std::size_t i = 0; i < opt.logs.size(); ++i)
+    if (!LoadLog(opt.logs[i], opt, logs[i]))
+      return 1;
+
+  // In flight the IMU-aided filter drives the vario whenever there is an
+  // accelerometer, so tune that one as soon as any log has acceleration.
+  const bool imu = std::any_of(logs.begin(), logs.end(),
+                               [](const Log& log) { return log.has_accel; });
+  for (const Log& log : logs)
+    if (imu && !log.has_accel)
+      std::fprintf(stderr, "kftune: %s has no acceleration and only constrains "
+                           "var_measurement\n", log.name.c_str());
+
+  WorkStealingPool pool(opt.threads ? opt.threads : std::thread::hardware_concurrency());
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<Candidate> ranked = opt.descent ? CoordinateDescent(pool, logs, opt, imu)
+                                              : GridSearch(pool, logs, opt, imu);
+  const double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+
+  std::sort(ranked.begin(), ranked.end(), [](const Candidate& x, const Candidate& y) {
+    return x.score < y.score;
+  });
+
+  std::printf("%zu candidate(s) x %zu log(s) on %zu thread(s) in %.2f s\n",
+              ranked.size(), logs.size(), pool.Size(), seconds);
+  std::printf("%4s %16s %16s %10s %8s %12s\n",
+              "rank", ProcessVarianceName(imu), "var_measurement", "score", "lag_s", "noise_mps");
+  for (std::size_t i = 0; i < ranked.size() && i < 10; ++i) {
+    const Candidate& c = ranked[i];
+    std::printf("%4zu %16.5g %16.5g %10.4f %8.3f %12.4f\n", i + 1,
+                ProcessVariance(c.settings, imu), c.settings.var_measurement,
+                c.score, c.lag, c.noise);
+  }
+
+  if (!WriteConfig(opt.output, ranked.front(), logs.size(), imu)) {
+    std::fprintf(stderr, "kftune: cannot write %s\n", opt.output.c_str());
+    return 1;
+  }
+  std::printf("wrote %s\n", opt.output.c_str());
+  return 0;
+}
@@ -0,0 +1,696 @@
+// simcheck: flies simulated flights whose truth is known (air masses, sensor
+// temperature drift, wind, thermal position) through the estimators of the
+// vario core and compares what they find with that truth.
+//
+//   simcheck [name...]
+//
+// runs every check whose name starts with one of the given names, or all of
+// them, and prints each measured error next to its bound. The exit status is
+// 1 if any bound is exceeded. The flights are seeded, so the numbers are the
+// same on every run of the same build.
+
+#include <algorithm>
+#include <deque>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "AltitudeFusion.h"
+#include "FlightModel.h"
+#include "ThermalDetector.h"
+#include "VarioProcessor.h"
+#include "WindEstimator.h"
+
+namespace {
+
+struct Check {
+  const char* name;
+  std::function<bool()> run;
+};
+
+// Prints a measured error against its bound; returns whether it is within.
+bool Expect(const char* what, double value, double bound, const char* unit)
+{
+  const bool ok = std::fabs(value) <= bound;
+  std::printf("  %-36s %10.4f %-5s (limit %g)%s\n", what, value, unit, bound,
+              ok ? "" : "  FAILED");
+  return ok;
+}
+
+// Root mean square of a running sum of squares.
+struct Rms {
+  double sum = 0;
+  std::size_t n = 0;
+  void Add(double e) { sum += e * e; ++n; }
+  double Value() const { return n ? std::sqrt(sum / n) : 0; }
+};
+
+// The sensor schedule of SimulatorSource, without its thread and rings:
+// every sensor ticks at its own rate and the samples of one instant come
+// accel, pressure, temperature, as the source pushes them.
+struct FlightHandlers {
+  std::function<void(const AccelSample&)> accel;
+  std::function<void(const PressureSample&, const TruthSample&)> pressure;
+  std::function<void(const TemperatureSample&)> temperature;
+};
+
+void Fly(FlightModel& model, const FlightSettings& settings, const FlightHandlers& on)
+{
+  auto period = [](double rate) {
+    return rate > 0 ? static_cast<std::uint64_t>(std::llround(1e6 / rate)) : UINT64_MAX;
+  };
+  const std::uint64_t pressure_period = period(settings.pressure_rate);
+  const std::uint64_t accel_period = period(settings.accel_rate);
+  const std::uint64_t temperature_period = period(settings.temperature_rate);
+
+  constexpr std::uint64_t kStart = 1000000;
+  const std::uint64_t end = kStart + static_cast<std::uint64_t>(model.Duration() * 1e6);
+  auto first = [](std::uint64_t p) { return p == UINT64_MAX ? UINT64_MAX : kStart; };
+  std::uint64_t now = kStart;
+  std::uint64_t next_pressure = first(pressure_period);
+  std::uint64_t next_accel = first(accel_period);
+  std::uint64_t next_temperature = first(temperature_period);
+
+  for (;;) {
+    const std::uint64_t due = std::min({next_pressure, next_accel, next_temperature});
+    if (due > end)
+      break;
+    model.Advance((due - now) * 1e-6);
+    now = due;
+    if (next_accel == now) {
+      const AccelSample sample = model.ReadAccel(now);
+      if (on.accel)
+        on.accel(sample);
+      next_accel += accel_period;
+    }
+    if (next_pressure == now) {
+      const PressureSample sample = model.ReadPressure(now);
+      if (on.pressure)
+        on.pressure(sample, model.Truth(now));
+      next_pressure += pressure_period;
+    }
+    if (next_temperature == now) {
+      const TemperatureSample sample = model.ReadTemperature(now);
+      if (on.temperature)
+        on.temperature(sample);
+      next_temperature += temperature_period;
+    }
+  }
+}
+
+// Vario and altitude errors of the processor on a flight.
+struct VarioErrors {
+  Rms vario;
+  Rms altitude;
+  double truth_altitude = 0;  // Worst disagreement of the truth with its pressure, m
+  double first_altitude = 0;  // Altitude error once settled, m
+  double final_altitude = 0;  // Altitude error at the end, m
+  double coefficient = 0;     // Temperature coefficient at the end, Pa/C
+  std::uint64_t learned = 0;  // Samples the temperature fit learned from
+};
+
+VarioErrors FlyVario(const VarioSettings& vario_settings, bool with_accel,
+                     const FlightSettings& settings = FlightSettings(),
+                     std::vector<AirMass> script = FlightModel::DemoScript())
+{
+  FlightModel model(settings, std::move(script));
+  VarioProcessor processor(vario_settings);
+  processor.Reset(settings.start_altitude);
+  VarioErrors errors;
+  std::uint64_t last_pressure = 0, last_accel = 0, start = 0;
+
+  FlightHandlers on;
+  if (with_accel)
+    on.accel = [&](const AccelSample& s) {
+      if (last_accel && last_pressure)
+        processor.UpdateAcceleration(s.vertical, (s.timestamp - last_accel) * 1e-6);
+      last_accel = s.timestamp;
+    };
+  on.pressure = [&](const PressureSample& s, const TruthSample& truth) {
+    if (!start)
+      start = s.timestamp;
+    if (last_pressure)
+      processor.UpdatePressure(s.pressure, (s.timestamp - last_pressure) * 1e-6);
+    last_pressure = s.timestamp;
+    errors.truth_altitude = std::max(errors.truth_altitude, std::fabs(
+        VarioProcessor::PressureToAltitude(truth.pressure * 0.01) - truth.altitude));
+    // Skip the settling of the filters
+    if (s.timestamp - start < 10000000)
+      return;
+    errors.vario.Add(processor.GetVario() - truth.climb);
+    errors.altitude.Add(processor.GetAltitude() - truth.altitude);
+    if (errors.altitude.n == 1)
+      errors.first_altitude = processor.GetAltitude() - truth.altitude;
+    errors.final_altitude = processor.GetAltitude() - truth.altitude;
+  };
+  // The pressure sensor's own temperature, as the app takes it from the
+  // pressure reading; the ambient thermometer is not what drifts.
+  on.temperature = nullptr;
+  on.pressure = [&, update = on.pressure](const PressureSample& s, const TruthSample& truth) {
+    processor.UpdateTemperature(s.temperature);
+    update(s, truth);
+  };
+  Fly(model, settings, on);
+  errors.coefficient = processor.Compensator().Coefficient();
+  errors.learned = processor.Compensator().LearnedSamples();
+  return errors;
+}
+
+// user-014: the simulator's truth is self-consistent and the vario follows it.
+bool CheckVario()
+{
+  bool ok = true;
+  const VarioErrors baro = FlyVario(VarioSettings(), false);
+  ok &= Expect("truth altitude vs. its pressure", baro.truth_altitude, 0.01, "m");
+  ok &= Expect("baro-only vario RMS error", baro.vario.Value(), 0.7, "m/s");
+  ok &= Expect("baro-only altitude RMS error", baro.altitude.Value(), 0.7, "m");
+  const VarioErrors imu = FlyVario(VarioSettings(), true);
+  ok &= Expect("IMU-aided vario RMS error", imu.vario.Value(), 0.05, "m/s");
+  ok &= Expect("IMU-aided altitude RMS error", imu.altitude.Value(), 0.1, "m");
+  VarioSettings adaptive;
+  adaptive.adaptive_measurement = true;
+  const VarioErrors learned = FlyVario(adaptive, true);
+  ok &= Expect("adaptive IMU-aided vario RMS error", learned.vario.Value(), 0.05, "m/s");
+  return ok;
+}
+
+// Time from the start of a climb until the vario shows 1 m/s, in s, or
+// infinity if it never does.
+struct StepResponse {
+  double truth = std::numeric_limits<double>::infinity();
+  double vario = std::numeric_limits<double>::infinity();
+};
+
+StepResponse FlyStep(bool with_accel, const FlightSettings& settings, double step_time,
+                     const std::vector<AirMass>& script)
+{
+  FlightModel model(settings, script);
+  VarioProcessor processor{VarioSettings()};
+  processor.Reset(settings.start_altitude);
+  StepResponse response;
+  std::uint64_t last_pressure = 0, last_accel = 0, start = 0;
+
+  auto record = [&](std::uint64_t timestamp, double truth_climb) {
+    const double t = (timestamp - start) * 1e-6 - step_time;
+    if (t < 0)
+      return;
+    if (truth_climb >= 1.0)
+      response.truth = std::min(response.truth, t);
+    if (processor.GetVario() >= 1.0)
+      response.vario = std::min(response.vario, t);
+  };
+  FlightHandlers on;
+  if (with_accel)
+    on.accel = [&](const AccelSample& s) {
+      if (last_accel && last_pressure)
+        processor.UpdateAcceleration(s.vertical, (s.timestamp - last_accel) * 1e-6);
+      last_accel = s.timestamp;
+      record(s.timestamp, model.Climb());
+    };
+  on.pressure = [&](const PressureSample& s, const TruthSample& truth) {
+    if (!start)
+      start = s.timestamp;
+    if (last_pressure)
+      processor.UpdatePressure(s.pressure, (s.timestamp - last_pressure) * 1e-6);
+    last_pressure = s.timestamp;
+    record(s.timestamp, truth.climb);
+  };
+  Fly(model, settings, on);
+  return response;
+}
+
+// user-003: a step into 2 m/s of lift after 30 s of level flight, with the
+// glider taking it up within a fifth of a second, at the app's 20 Hz baro
+// rate. The latency is how much later than the truth the vario reaches
+// 1 m/s; the IMU-aided filter has to do that within one baro period.
+bool CheckStepClimb()
+{
+  FlightSettings settings;
+  settings.pressure_rate = 20.0;
+  settings.glider_sink = 0.0;
+  settings.response_time = 0.2;
+  settings.ramp = 0.0;
+  settings.turbulence = 0.0;
+  constexpr double kStep = 30.0;
+  const std::vector<AirMass> script{{kStep, 30.0, 2.0, 0.0}};
+
+  const StepResponse baro = FlyStep(false, settings, kStep, script);
+  const StepResponse imu = FlyStep(true, settings, kStep, script);
+  bool ok = true;
+  std::printf("  %-36s %10.4f s\n", "truth reaches 1 m/s after", imu.truth);
+  std::printf("  %-36s %10.4f s\n", "baro-only latency", baro.vario - baro.truth);
+  ok &= Expect("IMU-aided latency", imu.vario - imu.truth, 1.0 / settings.pressure_rate, "s");
+  return ok;
+}
+
+// user-021: a sensor warming up by 15 C with a 4 Pa/C drift during a 20
+// minute rest on the ground, without gusts since nothing moves the phone.
+// Uncorrected that is 60 Pa, about 5 m of false sink. The drift is the
+// change of the altitude error since the start: the sensor's offset at its
+// first temperature is a constant no drift model can see.
+bool CheckTemperature()
+{
+  FlightSettings settings;
+  settings.sensor_warmup = 15.0;
+  settings.warmup_time = 300.0;
+  settings.pressure_tempco = 4.0;
+  settings.glider_sink = 0.0;
+  settings.turbulence = 0.0;
+  std::vector<AirMass> script{{0.0, 1200.0, 0.0, 0.0}};
+
+  bool ok = true;
+  auto drift = [](const VarioErrors& e) { return e.final_altitude - e.first_altitude; };
+  const VarioErrors off = FlyVario(VarioSettings(), false, settings, script);
+  std::printf("  %-36s %10.4f m\n", "uncorrected altitude drift", drift(off));
+
+  VarioSettings known;
+  known.temperature_coefficient = settings.pressure_tempco;
+  known.temperature_reference = settings.ground_temperature;
+  const VarioErrors corrected = FlyVario(known, false, settings, script);
+  ok &= Expect("altitude drift, known coefficient", drift(corrected), 0.3, "m");
+
+  VarioSettings learn;
+  learn.learn_temperature = true;
+  const VarioErrors learned = FlyVario(learn, false, settings, script);
+  ok &= Expect("learned coefficient error", learned.coefficient - settings.pressure_tempco,
+               0.2, "Pa/C");
+  ok &= Expect("altitude drift, learned coefficient", drift(learned), 1.0, "m");
+
+  // The same warm-up while flying at zero sink through smooth air that
+  // rises and sinks 0.2 m/s by turns, each for a minute: the vario never
+  // leaves the rest band, but the altitude moves by metres, which must not
+  // be learned as drift.
+  FlightSettings flying = settings;
+  flying.turbulence = 0.05;
+  std::vector<AirMass> drifting;
+  for (double start = 0; start < 1200.0; start += 120.0) {
+    drifting.push_back({start, 60.0, 0.2, 0.0});
+    drifting.push_back({start + 60.0, 60.0, -0.2, 0.0});
+  }
+  const VarioErrors airborne = FlyVario(learn, false, flying, drifting);
+  ok &= Expect("samples learned in zero-sink flight", static_cast<double>(airborne.learned),
+               0, "");
+  return ok;
+}
+
+// A horizontal track around one thermal, which FlightModel does not fly:
+// a glide, circles at a constant airspeed around a point a fixed offset from
+// the core, and a glide out. The air mass, with the core in it, drifts with
+// the wind, and so do the circles. The climb is a Gaussian core profile
+// less the glider's sink.
+struct TrackSettings {
+  double airspeed = 10.0;          // m/s
+  double wind_east = 0.0;          // m/s the air moves towards the east
+  double wind_north = 0.0;
+  double circle_period = 20.0;     // s per turn, negative to circle left
+  double glide = 60.0;             // s before and after circling
+  double circling = 180.0;         // s
+  double core_offset = 20.0;       // m from the circles' centre to the core
+  double strength = 3.0;           // m/s at the core
+  double core_radius = 60.0;       // m
+  double sink = 1.1;               // m/s
+  double gps_rate = 1.0;           // Hz
+  double course_noise = 0.0;       // deg
+  double speed_noise = 0.0;        // km/h
+  double no_course = 0.0;          // Share of fixes without course and speed, as GGA-only NMEA
+  unsigned seed = 1;
+};
+
+struct TrackTruth {
+  double time;         // s from the start
+  double climb;        // m/s
+  double altitude;     // m
+  double core_east;    // m from the origin
+  double core_north;
+  bool circling;
+};
+
+constexpr double kOriginLatitude = 46.0;
+constexpr double kOriginLongitude = 8.0;
+constexpr double kMetresPerDegree = 111194.9;
+
+void FlyTrack(const TrackSettings& track,
+              const std::function<void(const GpsFix&, const TrackTruth&)>& on_fix,
+              const std::function<void(const TrackTruth&)>& on_vario)
+{
+  constexpr double kPi = 3.14159265358979323846;
+  constexpr double dt = 0.1;
+  const double radius = track.airspeed * std::fabs(track.circle_period) / (2 * kPi);
+  const double turn = 360.0 / track.circle_period;   // deg/s, positive to the right
+  const double end = 2 * track.glide + track.circling;
+  const int fix_every = std::max(1, static_cast<int>(std::lround(1.0 / (track.gps_rate * dt))));
+
+  std::mt19937 rng(track.seed);
+  std::normal_distribution<double> normal;
+  std::uniform_real_distribution<double> uniform;
+
+  double east = 0, north = 0, heading = 30.0, altitude = 1000.0;
+  double core_east = 0, core_north = 0;
+  bool placed = false;
+  for (int step = 0; step * dt <= end; ++step) {
+    const double t = step * dt;
+    const bool circling = t >= track.glide && t < track.glide + track.circling;
+    if (circling && !placed) {
+      // The circles' centre lies a radius to the side of the turn
+      const double side = (heading + (turn > 0 ? 90.0 : -90.0)) * kPi / 180;
+      core_east = east + radius * std::sin(side) + track.core_offset;
+      core_north = north + radius * std::cos(side);
+      placed = true;
+    }
+    if (!placed) {
+      // Far ahead until the circling starts, so the glide is in sinking air
+      core_east = east + 1000.0;
+      core_north = north + 1000.0;
+    }
+
+    const double r = std::hypot(east - core_east, north - core_north);
+    const double climb = track.strength * std::exp(-r * r / (track.core_radius * track.core_radius))
+                         - track.sink;
+    const TrackTruth truth{t, climb, altitude, core_east, core_north, circling};
+    on_vario(truth);
+
+    const double h = heading * kPi / 180;
+    const double ground_east = track.airspeed * std::sin(h) + track.wind_east;
+    const double ground_north = track.airspeed * std::cos(h) + track.wind_north;
+    if (step % fix_every == 0) {
+      GpsFix fix{};
+      fix.timestamp = static_cast<std::uint64_t>(std::llround(t * 1e6)) + 1000000;
+      fix.latitude = kOriginLatitude + north / kMetresPerDegree;
+      fix.longitude = kOriginLongitude +
+          east / (kMetresPerDegree * std::cos(kOriginLatitude * kPi / 180));
+      fix.altitude = altitude;
+      fix.heading = std::fmod(std::atan2(ground_east, ground_north) * 180 / kPi
+                              + track.course_noise * normal(rng) + 720.0, 360.0);
+      fix.speed = std::hypot(ground_east, ground_north) * 3.6 + track.speed_noise * normal(rng);
+      if (uniform(rng) < track.no_course)
+        fix.heading = fix.speed = std::numeric_limits<double>::quiet_NaN();
+      on_fix(fix, truth);
+    }
+
+    east += ground_east * dt;
+    north += ground_north * dt;
+    core_east += track.wind_east * dt;
+    core_north += track.wind_north * dt;
+    altitude += climb * dt;
+    if (circling)
+      heading += turn * dt;
+  }
+}
+
+// Metres east and north of the track origin.
+void ToMetres(double latitude, double longitude, double& east, double& north)
+{
+  constexpr double kPi = 3.14159265358979323846;
+  north = (latitude - kOriginLatitude) * kMetresPerDegree;
+  east = (longitude - kOriginLongitude) * kMetresPerDegree * std::cos(kOriginLatitude * kPi / 180);
+}
+
+// user-022: circling is found and left in time, the thermal's statistics
+// match the truth and the core estimate lies closer to the core than the
+// circles' centre, in still air and drifting in 20 km/h of wind.
+bool CheckThermalTrack(const TrackSettings& track)
+{
+  ThermalDetector detector;
+  double entered = -1, left = -1, core_error = 0, core_offset = 0, climb_sum = 0;
+  std::size_t climb_count = 0;
+  double entry_altitude = 0, exit_altitude = 0;
+
+  FlyTrack(track, [&](const GpsFix& fix, const TrackTruth& truth) {
+    detector.UpdateFix(fix.timestamp, fix.latitude, fix.longitude, fix.heading, fix.speed);
+    if (detector.IsCircling() && entered < 0)
+      entered = truth.time;
+    if (!detector.IsCircling() && entered >= 0 && left < 0)
+      left = truth.time;
+    // Judge the core over the last circle flown
+    if (truth.circling && truth.time >= track.glide + track.circling - 1.0 && detector.HasCore()) {
+      double east, north;
+      ToMetres(detector.CoreLatitude(), detector.CoreLongitude(), east, north);
+      core_error = std::hypot(east - truth.core_east, north - truth.core_north);
+      core_offset = track.core_offset;
+    }
+  }, [&](const TrackTruth& truth) {
+    detector.UpdateVario(truth.climb, truth.altitude);
+    if (truth.circling) {
+      if (climb_count++ == 0)
+        entry_altitude = truth.altitude;
+      exit_altitude = truth.altitude;
+      climb_sum += truth.climb;
+    }
+  });
+
+  bool ok = true;
+  ok &= Expect("circling detected after", entered - track.glide,
+               ThermalDetector::kEnterTime + 5.0, "s");
+  ok &= Expect("circling ended after", left - (track.glide + track.circling),
+               ThermalDetector::kExitTime + 7.0, "s");
+  if (!detector.HasLast() || core_offset == 0) {
+    std::printf("  no thermal or core found  FAILED\n");
+    return false;
+  }
+  const ThermalStats& stats = detector.Last();
+  ok &= Expect("thermal duration error", stats.duration - track.circling, 5.0, "s");
+  ok &= Expect("thermal gain error", stats.gain - (exit_altitude - entry_altitude), 5.0, "m");
+  ok &= Expect("average climb error", stats.average_climb - climb_sum / climb_count, 0.1, "m/s");
+  ok &= Expect("circling direction error", stats.direction - (track.circle_period > 0 ? 1 : -1),
+               0, "");
+  ok &= Expect("core error", core_error, 0.6 * core_offset, "m");
+  return ok;
+}
+
+bool CheckThermal()
+{
+  TrackSettings still;
+  std::printf(" still air, circling right\n");
+  bool ok = CheckThermalTrack(still);
+
+  TrackSettings windy;
+  windy.wind_east = 4.5;
+  windy.wind_north = -3.0;
+  windy.circle_period = -22.0;
+  windy.course_noise = 2.0;
+  windy.speed_noise = 1.0;
+  std::printf(" 20 km/h wind, circling left, noisy GPS\n");
+  ok &= CheckThermalTrack(windy);
+
+  TrackSettings partial = windy;
+  partial.no_course = 0.3;
+  std::printf(" same, 30%% of the fixes without course or speed\n");
+  ok &= CheckThermalTrack(partial);
+  return ok;
+}
+
+// user-023: wind from the ground velocity while circling, against the wind
+// the track was flown in, judged as it stood at the end of the circling.
+bool CheckWindTrack(const TrackSettings& track)
+{
+  constexpr double kPi = 3.14159265358979323846;
+  WindEstimator wind;
+  bool valid = false;
+  double speed = 0, direction = 0, airspeed = 0, quality = 0;
+  FlyTrack(track, [&](const GpsFix& fix, const TrackTruth& truth) {
+    wind.UpdateFix(fix.timestamp, fix.heading, fix.speed);
+    if (truth.circling) {
+      valid = wind.IsValid();
+      speed = wind.Speed();
+      direction = wind.Direction();
+      airspeed = wind.Airspeed();
+      quality = wind.Quality();
+    }
+  }, [](const TrackTruth&) {});
+
+  if (!valid) {
+    std::printf("  no wind estimate  FAILED\n");
+    return false;
+  }
+  const double true_speed = std::hypot(track.wind_east, track.wind_north) * 3.6;
+  // The direction the wind blows from, opposite to where the air moves
+  const double true_direction =
+      std::fmod(std::atan2(-track.wind_east, -track.wind_north) * 180 / kPi + 360.0, 360.0);
+  double direction_error = std::fmod(direction - true_direction + 540.0, 360.0) - 180.0;
+  bool ok = true;
+  ok &= Expect("wind speed error", speed - true_speed, 1.5, "km/h");
+  if (true_speed > 5.0)
+    ok &= Expect("wind direction error", direction_error, 5.0, "deg");
+  ok &= Expect("airspeed error", airspeed - track.airspeed * 3.6, 1.5, "km/h");
+  ok &= Expect("fit quality shortfall", 1.0 - quality, 0.5, "");
+  return ok;
+}
+
+bool CheckWind()
+{
+  TrackSettings calm;
+  std::printf(" calm\n");
+  bool ok = CheckWindTrack(calm);
+
+  TrackSettings west;
+  west.wind_east = 15.0 / 3.6;
+  std::printf(" 15 km/h from the west\n");
+  ok &= CheckWindTrack(west);
+
+  TrackSettings strong;
+  // Strong, but below the airspeed: faster wind stops the course from
+  // turning through a full circle, and the glider from staying in a thermal
+  strong.wind_east = -6.0;
+  strong.wind_north = -6.0;
+  strong.airspeed = 11.0;
+  strong.circle_period = -24.0;
+  std::printf(" 31 km/h from the north-east, circling left\n");
+  ok &= CheckWindTrack(strong);
+
+  TrackSettings noisy;
+  noisy.wind_east = 3.0;
+  noisy.wind_north = 4.0;
+  noisy.course_noise = 3.0;
+  noisy.speed_noise = 1.5;
+  noisy.gps_rate = 5.0;
+  std::printf(" 18 km/h from the south-west, noisy 5 Hz GPS\n");
+  ok &= CheckWindTrack(noisy);
+
+  // Unknown course and speed must not count as a (0, 0) ground velocity
+  TrackSettings partial = west;
+  partial.no_course = 0.5;
+  std::printf(" 15 km/h from the west, half the fixes without course or speed\n");
+  ok &= CheckWindTrack(partial);
+
+  // Straight flight never covers enough of a circle for a fit
+  TrackSettings straight = west;
+  straight.circling = 0;
+  WindEstimator wind;
+  bool any_valid = false;
+  FlyTrack(straight, [&](const GpsFix& fix, const TrackTruth&) {
+    wind.UpdateFix(fix.timestamp, fix.heading, fix.speed);
+    any_valid |= wind.IsValid();
+  }, [](const TrackTruth&) {});
+  std::printf(" straight glide\n");
+  ok &= Expect("wind reported without circling", any_valid, 0, "");
+  return ok;
+}
+
+// user-025: the demo flight with a barometer set to the wrong QNH and a GPS
+// whose clock runs 3.7 s ahead of the sensor clock. Each fix measures the
+// true altitude with 5 m of noise, is stamped on the GPS clock, and reaches
+// the app after the receiver's 0.4 s latency and 20-200 ms of transport
+// delay. The fused altitude must lose the QNH error, and the clock offset
+// and latency must come out as the fix timing implies.
+bool CheckFusion()
+{
+  constexpr double kQnhError = 5.0;         // hPa, about 42 m of altitude
+  constexpr std::int64_t kGpsClock = 3700000;
+  constexpr double kLatency = 0.4;          // s
+  constexpr double kMinDelay = 0.02;        // s
+  constexpr double kMaxDelay = 0.2;
+
+  FlightSettings settings;
+  FlightModel model(settings, FlightModel::DemoScript());
+  VarioSettings vario_settings;
+  vario_settings.qnh = AltitudeTable::kStandardQnh - kQnhError;
+  VarioProcessor processor(vario_settings);
+  processor.Reset(settings.start_altitude);
+  AltitudeFusion fusion;
+
+  struct Pending {
+    std::uint64_t arrival;    // Sensor clock, us
+    GpsFix fix;
+  };
+  std::deque<Pending> pending;
+  std::mt19937 rng(5);
+  std::normal_distribution<double> gps_noise(0.0, 5.0);
+  std::uniform_real_distribution<double> delay(kMinDelay, kMaxDelay);
+
+  Rms baro_error, fused_error;
+  std::uint64_t last_pressure = 0, last_accel = 0, start = 0, next_fix = 0;
+  FlightHandlers on;
+  on.accel = [&](const AccelSample& s) {
+    if (last_accel && last_pressure)
+      processor.UpdateAcceleration(s.vertical, (s.timestamp - last_accel) * 1e-6);
+    last_accel = s.timestamp;
+  };
+  on.pressure = [&](const PressureSample& s, const TruthSample& truth) {
+    if (!start)
+      start = next_fix = s.timestamp;
+    if (last_pressure)
+      processor.UpdatePressure(s.pressure, (s.timestamp - last_pressure) * 1e-6);
+    last_pressure = s.timestamp;
+    fusion.UpdateBaro(s.timestamp, processor.GetAltitude(), processor.GetVario());
+
+    // The receiver measures now; the fix arrives later
+    if (s.timestamp >= next_fix) {
+      GpsFix fix{};
+      fix.timestamp = s.timestamp + kGpsClock;
+      fix.altitude = truth.altitude + gps_noise(rng);
+      const double late = kLatency + delay(rng);
+      pending.push_back({s.timestamp + static_cast<std::uint64_t>(late * 1e6), fix});
+      next_fix += 1000000;
+    }
+    while (!pending.empty() && pending.front().arrival <= s.timestamp) {
+      fusion.UpdateGps(pending.front().fix.timestamp, pending.front().fix.altitude);
+      pending.pop_front();
+    }
+
+    // Judge once the bias has had two minutes of fixes
+    if (s.timestamp - start < 120000000)
+      return;
+    baro_error.Add(processor.GetAltitude() - truth.altitude);
+    fused_error.Add(fusion.Altitude() - truth.altitude);
+  };
+  Fly(model, settings, on);
+
+  // The offset comes out less the least delay a fix arrived with, so fixes
+  // look that much late, and that is what the latency has to make up
+  const double delay_seen = (kGpsClock - fusion.ClockOffset()) * 1e-6;
+  bool ok = true;
+  std::printf("  %-36s %10.4f m\n", "baro altitude RMS error", baro_error.Value());
+  ok &= Expect("fused altitude RMS error", fused_error.Value(), 1.5, "m");
+  ok &= Expect("clock offset error", delay_seen - (kLatency + kMinDelay), 0.03, "s");
+  ok &= Expect("latency error", fusion.Latency() - delay_seen, 0.15, "s");
+  ok &= Expect("fixes rejected", static_cast<double>(fusion.FixesRejected()), 5, "");
+  return ok;
+}
+
+void Usage()
+{
+  std::fprintf(stderr, "usage: simcheck [name...]\n");
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  std::vector<std::string> filters;
+  for (int i = 1; i < argc; ++i) {
+    if (argv[i][0] == '-') {
+      Usage();
+      return 2;
+    } else {
+      filters.push_back(argv[i]);
+    }
+  }
+
+  const std::vector<Check> checks = {
+    {"vario", CheckVario},
+    {"step", CheckStepClimb},
+    {"temperature", CheckTemperature},
+    {"thermal", CheckThermal},
+    {"wind", CheckWind},
+    {"fusion", CheckFusion},
+  };
+
+  int failed = 0;
+  for (const Check& check : checks) {
+    const std::string name = check.name;
+    if (!filters.empty() &&
+        std::none_of(filters.begin(), filters.end(), [&](const std::string& f) {
+          return name.compare(0, f.size(), f) == 0;
+        }))
+      continue;
+    std::printf("%s\n", check.name);
+    if (!check.run())
+      ++failed;
+  }
+  std::printf(failed ? "%d check(s) FAILED\n" : "all checks passed\n", failed);
+  return failed ? 1 : 0;
+}
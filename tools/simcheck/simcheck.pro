@@ -0,0 +1,14 @@
+# Flies simulated flights with known air, wind and sensor errors through the
+# estimators of the vario core and checks their errors against fixed bounds.
+# Exits non-zero when a check fails, so CI can run it.
+
+TEMPLATE = app
+TARGET = simcheck
+
+CONFIG += console c++17 thread
+CONFIG -= app_bundle qt
+
+include(../../libvario/libvario.pri)
+
+SOURCES += \
+    main.cpp
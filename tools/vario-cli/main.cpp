@@ -0,0 +1,320 @@
+// vario-cli: runs recorded or streamed sensor data through the vario core
+// and prints what the app would show and play, one line per pressure sample.
+//
+// Input is a text stream on stdin or in a file, one sample per line:
+//
+//   <timestamp_us> <pressure_pa> [<vertical_accel_ms2> [<sensor_temperature_c>]]
+//
+// separated by whitespace or a comma, '#' starting a comment line. With the
+// optional acceleration the IMU-aided filter is used, as on the phone; the
+// temperature feeds the drift compensation. A capture file written by the
+// app (.vcap) is recognized by its header.
+//
+// Output is CSV on stdout:
+//
+//   time_s,pressure_hpa,altitude_m,vario_ms,tone_hz,tone_ms
+//
+// where tone_hz is 0 while the vario is silent.
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "CaptureReader.h"
+#include "SampleStatistics.h"
+#include "VarioProcessor.h"
+#include "VarioTone.h"
+
+namespace {
+
+struct Options {
+  std::string input;         // Empty or "-" for stdin
+  std::string config;        // kalman.ini as written by kftune
+  VarioSettings settings;
+  bool quiet = false;
+};
+
+void Usage()
+{
+  std::fprintf(stderr,
+      "usage: vario-cli [options] [file|-]\n"
+      "  -c FILE           read filter settings from a kalman.ini\n"
+      "  --var A M         process and measurement variance (default 0.75 0.25)\n"
+      "  --adaptive        adapt the measurement variance online\n"
+      "  --decimate M N    decimate pressure by M through an N-tap FIR\n"
+      "  --qnh HPA         sea level pressure altitudes refer to (default 1013.25)\n"
+      "  --prefilter SPEC  pressure pre-filter chain (default mean:10), e.g.\n"
+      "                    hampel:15:3,median:5,mean:10 or none\n"
+      "  --tempco K        pressure drift in Pa per Celsius of sensor temperature\n"
+      "  --learn-temperature  refine the drift coefficient while at rest\n"
+      "  -q                no sample statistics on stderr\n");
+}
+
+bool ParseOptions(int argc, char** argv, Options& opt)
+{
+  for (int i = 1; i < argc; ++i) {
+    const char* a = argv[i];
+    auto need = [&](int count) {
+      if (i + count >= argc) {
+        std::fprintf(stderr, "vario-cli: %s needs %d argument(s)\n", a, count);
+        return false;
+      }
+      return true;
+    };
+    if (!std::strcmp(a, "-c")) {
+      if (!need(1)) return false;
+      opt.config = argv[++i];
+    } else if (!std::strcmp(a, "--var")) {
+      if (!need(2)) return false;
+      opt.settings.var_accel = std::atof(argv[++i]);
+      opt.settings.var_measurement = std::atof(argv[++i]);
+    } else if (!std::strcmp(a, "--adaptive")) {
+      opt.settings.adaptive_measurement = true;
+    } else if (!std::strcmp(a, "--decimate")) {
+      if (!need(2)) return false;
+      opt.settings.decimation = std::strtoul(argv[++i], nullptr, 10);
+      opt.settings.decimation_taps = std::strtoul(argv[++i], nullptr, 10);
+    } else if (!std::strcmp(a, "--qnh")) {
+      if (!need(1)) return false;
+      opt.settings.qnh = std::atof(argv[++i]);
+    } else if (!std::strcmp(a, "--prefilter")) {
+      if (!need(1)) return false;
+      opt.settings.prefilter = argv[++i];
+    } else if (!std::strcmp(a, "--tempco")) {
+      if (!need(1)) return false;
+      opt.settings.temperature_coefficient = std::atof(argv[++i]);
+    } else if (!std::strcmp(a, "--learn-temperature")) {
+      opt.settings.learn_temperature = true;
+    } else if (!std::strcmp(a, "-q")) {
+      opt.quiet = true;
+    } else if (a[0] == '-' && a[1] != '\0') {
+      std::fprintf(stderr, "vario-cli: unknown option %s\n", a);
+      return false;
+    } else if (opt.input.empty()) {
+      opt.input = a;
+    } else {
+      std::fprintf(stderr, "vario-cli: only one input allowed\n");
+      return false;
+    }
+  }
+  return true;
+}
+
+// Reads the [kalman], [altimeter] and [temperature] groups of the app's config file; unknown
+// keys and other groups are ignored, so the same file can be shared with the app.
+bool LoadConfig(const std::string& path, VarioSettings& settings)
+{
+  std::ifstream in(path);
+  if (!in) {
+    std::fprintf(stderr, "vario-cli: cannot open %s\n", path.c_str());
+    return false;
+  }
+
+  std::string line, group;
+  while (std::getline(in, line)) {
+    line.erase(std::remove_if(line.begin(), line.end(), ::isspace), line.end());
+    if (line.empty() || line[0] == ';' || line[0] == '#')
+      continue;
+    if (line[0] == '[') {
+      group = line.substr(1, line.find(']') - 1);
+      continue;
+    }
+    const std::size_t eq = line.find('=');
+    if (eq == std::string::npos)
+      continue;
+    const std::string key = line.substr(0, eq);
+    const std::string value = line.substr(eq + 1);
+    if (group == "altimeter") {
+      if (key == "qnh")
+        settings.qnh = std::atof(value.c_str());
+      continue;
+    }
+    if (group == "temperature") {
+      if (key == "coefficient")
+        settings.temperature_coefficient = std::atof(value.c_str());
+      else if (key == "reference")
+        settings.temperature_reference = std::atof(value.c_str());
+      else if (key == "learn")
+        settings.learn_temperature = value == "true" || value == "1";
+      continue;
+    }
+    if (group != "kalman")
+      continue;
+    if (key == "var_accel")
+      settings.var_accel = std::atof(value.c_str());
+    else if (key == "var_measurement")
+      settings.var_measurement = std::atof(value.c_str());
+    else if (key == "var_jerk")
+      settings.var_jerk = std::atof(value.c_str());
+    else if (key == "var_accel_input")
+      settings.var_accel_input = std::atof(value.c_str());
+    else if (key == "adaptive_measurement")
+      settings.adaptive_measurement = value == "true" || value == "1";
+    else if (key == "adaptive_window")
+      settings.adaptive_window = std::strtoul(value.c_str(), nullptr, 10);
+    else if (key == "decimation")
+      settings.decimation = std::strtoul(value.c_str(), nullptr, 10);
+    else if (key == "decimation_taps")
+      settings.decimation_taps = std::strtoul(value.c_str(), nullptr, 10);
+    else if (key == "prefilter")
+      settings.prefilter = value;
+  }
+  return true;
+}
+
+// Feeds samples to the processor and prints one line per pressure sample.
+class Runner {
+ public:
+  Runner(const VarioSettings& settings, bool profile)
+    : processor_(settings)
+  {
+    processor_.Prefilter().SetProfiling(profile);
+  }
+
+  void Temperature(double celsius)
+  {
+    processor_.UpdateTemperature(celsius);
+  }
+
+  void Pressure(std::uint64_t timestamp, double pressure)
+  {
+    if (start_ == 0)
+      start_ = timestamp;
+    const double dt = pressure_stats_.Add(timestamp);
+    if (dt <= 0)
+      return;
+
+    if (!processor_.UpdatePressure(pressure, dt))
+      return;
+    const double vario = processor_.GetVario();
+    const Tone tone = tone_.Characteristics(vario);
+    std::printf("%.6f,%.3f,%.2f,%.3f,%.0f,%d\n",
+                (timestamp - start_) * 1e-6, processor_.GetPressure(),
+                processor_.GetAltitude(), vario,
+                tone.audible ? tone.frequency : 0.0f, tone.duration_ms);
+  }
+
+  void Acceleration(std::uint64_t timestamp, double accel)
+  {
+    const double dt = accel_stats_.Add(timestamp);
+    if (dt > 0 && pressure_stats_.Samples() > 0)
+      processor_.UpdateAcceleration(accel, dt);
+  }
+
+  void Report() const
+  {
+    Report("pressure", pressure_stats_);
+    if (accel_stats_.Samples() > 0)
+      Report("accelerometer", accel_stats_);
+    for (const FilterChain::StageCost& cost : processor_.Prefilter().Costs())
+      std::fprintf(stderr, "prefilter %s: %.1f ns per sample\n", cost.name.c_str(), cost.MeanNs());
+
+    const TemperatureCompensator& compensator = processor_.Compensator();
+    if (compensator.HasTemperature()) {
+      std::fprintf(stderr,
+          "temperature: coefficient %.3f Pa/C from %.1f C, final correction %.1f Pa, %llu samples learned\n",
+          compensator.Coefficient(), compensator.Reference(), compensator.Correction(),
+          static_cast<unsigned long long>(compensator.LearnedSamples()));
+    }
+  }
+
+ private:
+  static void Report(const char* name, const SampleStatistics& stats)
+  {
+    std::fprintf(stderr,
+        "%s: %llu samples, %.1f Hz, jitter %.2f ms, %llu duplicates, %llu dropouts\n",
+        name, static_cast<unsigned long long>(stats.Samples()), stats.Rate(),
+        stats.Jitter() * 1e-3, static_cast<unsigned long long>(stats.Duplicates()),
+        static_cast<unsigned long long>(stats.Dropouts()));
+  }
+
+  VarioProcessor processor_;
+  VarioTone tone_;
+  SampleStatistics pressure_stats_;
+  SampleStatistics accel_stats_;
+  std::uint64_t start_ = 0;
+};
+
+void RunText(std::istream& in, Runner& runner)
+{
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '#')
+      continue;
+    std::replace(line.begin(), line.end(), ',', ' ');
+    std::istringstream fields(line);
+    double t = 0, p = 0, accel = 0, temperature = 0;
+    if (!(fields >> t >> p) || t < 0 || p <= 0)
+      continue;
+    const std::uint64_t timestamp = static_cast<std::uint64_t>(t);
+    if (fields >> accel)
+      runner.Acceleration(timestamp, accel);
+    if (fields >> temperature)
+      runner.Temperature(temperature);
+    runner.Pressure(timestamp, p);
+  }
+}
+
+void RunCapture(CaptureReader& reader, Runner& runner)
+{
+  CaptureRecord record;
+  while (reader.Next(record)) {
+    if (record.type == capture::kPressure) {
+      // Backends without a temperature channel report exactly 0
+      if (record.pressure.temperature != 0)
+        runner.Temperature(record.pressure.temperature);
+      runner.Pressure(record.pressure.timestamp, record.pressure.pressure);
+    }
+    else if (record.type == capture::kAccel)
+      runner.Acceleration(record.accel.timestamp, record.accel.vertical);
+  }
+  if (reader.Corrupt())
+    std::fprintf(stderr, "vario-cli: capture stopped at a corrupt record\n");
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  Options opt;
+  if (!ParseOptions(argc, argv, opt)) {
+    Usage();
+    return 2;
+  }
+  if (!opt.config.empty() && !LoadConfig(opt.config, opt.settings))
+    return 1;
+  if (!FilterChain().Parse(opt.settings.prefilter)) {
+    std::fprintf(stderr, "vario-cli: invalid prefilter %s\n", opt.settings.prefilter.c_str());
+    return 2;
+  }
+
+  Runner runner(opt.settings, !opt.quiet);
+  std::printf("# time_s,pressure_hpa,altitude_m,vario_ms,tone_hz,tone_ms\n");
+
+  if (opt.input.empty() || opt.input == "-") {
+    RunText(std::cin, runner);
+  } else {
+    CaptureReader capture;
+    if (capture.Open(opt.input)) {
+      RunCapture(capture, runner);
+    } else {
+      std::ifstream in(opt.input);
+      if (!in) {
+        std::fprintf(stderr, "vario-cli: cannot open %s\n", opt.input.c_str());
+        return 1;
+      }
+      RunText(in, runner);
+    }
+  }
+
+  std::fflush(stdout);
+  if (!opt.quiet)
+    runner.Report();
+  return 0;
+}
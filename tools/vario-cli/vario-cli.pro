@@ -0,0 +1,13 @@
+# Headless vario: reads a pressure stream or capture and prints altitude,
+# vario and tone, using the same core as the app. Needs no Qt at all.
+
+TEMPLATE = app
+TARGET = vario-cli
+
+CONFIG += console c++17 thread
+CONFIG -= app_bundle qt
+
+include(../../libvario/libvario.pri)
+
+SOURCES += \
+    main.cpp
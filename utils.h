@@ -2,10 +2,8 @@
 #define UTILS_H
 #include <QObject>
 
-#define KF_VAR_ACCEL 0.0075 // Variance of pressure acceleration noise input.
-#define KF_VAR_MEASUREMENT 0.05 // Variance of pressure measurement noise.
-//#define KF_VAR_ACCEL 0.005 // Smaller variance for pressure acceleration noise input.
-//#define KF_VAR_MEASUREMENT 0.02 // Smaller variance for pressure measurement noise.
+// Kalman filter variances live in VarioSettings (VarioProcessor.h) and are
+// loaded at startup from the config file written by tools/kftune.
 
 #define SEA_LEVEL_PRESSURE 101325.0 // Pressure at sea level (Pa)
 #define SEA_LEVEL_PRESSURE_HPA 1013.25 // Pressure at sea level (hPa)
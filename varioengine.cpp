@@ -0,0 +1,361 @@
+#include "varioengine.h"
+#include "variosound.h"
+#include <QDebug>
+#include <QStringList>
+#include <QtMath>
+
+VarioEngine::VarioEngine(SensorBus *bus, const VarioSettings &settings, QObject *parent)
+    : QThread(parent)
+    , m_bus(bus)
+    , m_processor(settings)
+{
+}
+
+VarioEngine::~VarioEngine()
+{
+    setStop();
+    wait();
+}
+
+void VarioEngine::setSampleSource(std::shared_ptr<SampleSource> source,
+                                  std::shared_ptr<SimulatorSource> simulator)
+{
+    m_sampleSource = source;
+    m_simulator = simulator;
+}
+
+void VarioEngine::setStop()
+{
+    m_stop = true;
+    quit();
+}
+
+void VarioEngine::run()
+{
+    // Samples are picked up in batches; polling keeps the sensor thread free
+    // of any per-sample allocation or cross-thread event.
+    QTimer busTimer;
+    busTimer.setTimerType(Qt::PreciseTimer);
+    connect(&busTimer, &QTimer::timeout, this, &VarioEngine::drainSensorBus, Qt::DirectConnection);
+    m_busTimer = &busTimer;
+    busTimer.start(m_pollInterval);
+
+    QTimer statsTimer;
+    connect(&statsTimer, &QTimer::timeout, this, &VarioEngine::reportSampleStatistics, Qt::DirectConnection);
+    statsTimer.start(STATS_REPORT_INTERVAL_MS);
+
+    if (!m_stop)
+        exec();
+
+    busTimer.stop();
+    statsTimer.stop();
+    m_busTimer = nullptr;
+}
+
+void VarioEngine::drainSensorBus()
+{
+    // Merge pressure and accelerometer samples in timestamp order so the
+    // IMU-aided filter always predicts up to a baro sample before correcting.
+    // Comparing the ring heads only orders what has arrived: with one ring
+    // empty, an older sample of that sensor may still be on its way. So a
+    // sample newer than the other stream's last one waits, until its own
+    // ring has moved MERGE_HOLD_US past it. A sensor later than that is still
+    // taken out of order, and shows up as backwards in its statistics.
+    const bool flush = m_sampleSource && m_sampleSource->IsFinished();
+    for (;;) {
+        const PressureSample* p = m_bus->pressure.Front();
+        const AccelSample* a = m_bus->accel.Front();
+
+        if (!p && !a)
+            break;
+
+        if (!flush && p && !a && m_accStats.Started() && p->timestamp > m_accStats.Last()
+            && m_bus->pressure.Back()->timestamp - p->timestamp < MERGE_HOLD_US) {
+            break;
+        }
+        if (!flush && a && !p && m_pressureStats.Started() && a->timestamp > m_pressureStats.Last()
+            && m_bus->accel.Back()->timestamp - a->timestamp < MERGE_HOLD_US) {
+            break;
+        }
+
+        if (p && (!a || p->timestamp <= a->timestamp)) {
+            if (m_captureWriter)
+                m_captureWriter->Write(*p);
+            processPressure(*p);
+            if (m_simulator)
+                compareWithTruth(p->timestamp);
+            m_bus->pressure.Pop();
+        } else {
+            if (m_captureWriter)
+                m_captureWriter->Write(*a);
+            processAcceleration(*a);
+            m_bus->accel.Pop();
+        }
+    }
+
+    m_bus->temperature.Drain([this](const TemperatureSample &sample) {
+        if (m_captureWriter)
+            m_captureWriter->Write(sample);
+        m_current.ambientTemperature = sample.temperature;
+    });
+
+    m_bus->gps.Drain([this](const GpsFix &fix) {
+        if (m_captureWriter)
+            m_captureWriter->Write(fix);
+        m_gps.Publish(fix);
+        m_gpsStats.Add(fix.timestamp);
+        m_processor.UpdateGroundSpeed(fix.speed);
+        if (m_processor.Settings().gps_altitude) {
+            m_fusion.UpdateGps(fix.timestamp, fix.altitude);
+            updateFusedAltitude();
+        }
+        updateCourse(fix);
+        updateThermal(fix);
+        updateWind(fix);
+    });
+
+    if (m_captureWriter)
+        m_captureWriter->FlushIfDue();
+
+    if (m_sampleSource && !m_sourceReported && m_sampleSource->IsFinished()
+        && m_bus->pressure.Empty() && m_bus->accel.Empty()) {
+        reportSampleSource();
+    }
+}
+
+void VarioEngine::processPressure(const PressureSample &sample)
+{
+    m_current.temperature = sample.temperature;
+
+    // Interval on the sensor clock; 0 for the first sample or a duplicate
+    qreal dt = m_pressureStats.Add(sample.timestamp);
+    if (dt <= 0 || sample.pressure == 0)
+        return;
+
+    // Backends without a temperature channel report exactly 0
+    if (sample.temperature != 0)
+        m_processor.UpdateTemperature(sample.temperature);
+
+    try {
+        if (!m_processor.UpdatePressure(sample.pressure, dt))
+            return;     // Sample went into the decimator, no new output yet
+    }
+    catch (const std::exception& e) {
+        qWarning() << "Error processing sensor data:" << e.what();
+        return;
+    }
+
+    m_current.pressure = m_processor.GetPressure();
+    m_current.altitude = m_processor.GetAltitude();
+    m_current.vario = m_processor.GetVario();
+    m_fusion.UpdateBaro(sample.timestamp, m_current.altitude, m_current.vario);
+    updateFusedAltitude();
+    m_thermal.UpdateVario(m_current.vario, m_current.altitude);
+    publish(sample.timestamp);
+}
+
+void VarioEngine::processAcceleration(const AccelSample &sample)
+{
+    m_current.roll = sample.roll;
+    m_current.pitch = sample.pitch;
+    m_current.verticalAcc = sample.vertical;
+
+    m_heading.UpdateMagnetic(sample.heading);
+    m_current.heading = m_heading.Heading();
+    m_current.headingValid = m_heading.IsValid();
+
+    qreal dt = m_accStats.Add(sample.timestamp);
+
+    // Only aid the altitude filter once the baro has given it a starting point
+    if (dt > 0 && m_pressureStats.Started()) {
+        m_processor.UpdateAcceleration(sample.vertical, dt);
+        m_current.vario = m_processor.GetVario();
+        publish(sample.timestamp);
+    }
+}
+
+void VarioEngine::updateCourse(const GpsFix &fix)
+{
+    qreal dt = 0;
+    if (m_lastFixTimestamp > 0 && fix.timestamp > m_lastFixTimestamp)
+        dt = (fix.timestamp - m_lastFixTimestamp) * 1e-6;
+    m_lastFixTimestamp = fix.timestamp;
+
+    // Goes out with the next filter update, at most one baro interval later
+    m_heading.UpdateCourse(fix.heading, fix.speed, dt);
+    m_current.heading = m_heading.Heading();
+    m_current.headingValid = m_heading.IsValid();
+}
+
+void VarioEngine::updateThermal(const GpsFix &fix)
+{
+    const bool wasCircling = m_thermal.IsCircling();
+    m_thermal.UpdateFix(fix.timestamp, fix.latitude, fix.longitude, fix.heading, fix.speed);
+
+    m_current.circling = m_thermal.IsCircling();
+    m_current.hasThermal = m_current.circling || m_thermal.HasLast();
+    m_current.thermal = m_current.circling ? m_thermal.Current() : m_thermal.Last();
+    m_current.hasCore = m_thermal.HasCore();
+    if (m_current.hasCore) {
+        m_current.coreLatitude = m_thermal.CoreLatitude();
+        m_current.coreLongitude = m_thermal.CoreLongitude();
+    }
+
+    if (wasCircling && !m_current.circling) {
+        const ThermalStats &thermal = m_thermal.Last();
+        qDebug().noquote() << QString("Thermal left: %1 m in %2 s, %3 m/s average, circling %4")
+                                  .arg(thermal.gain, 0, 'f', 0)
+                                  .arg(thermal.duration, 0, 'f', 0)
+                                  .arg(thermal.average_climb, 0, 'f', 1)
+                                  .arg(thermal.direction > 0 ? "right" : "left");
+    }
+}
+
+void VarioEngine::updateWind(const GpsFix &fix)
+{
+    m_wind.UpdateFix(fix.timestamp, fix.heading, fix.speed);
+
+    // Keeps showing the last good wind through the glide, when there is
+    // nothing to fit
+    if (m_wind.IsValid() && m_wind.Quality() >= WIND_MIN_QUALITY) {
+        m_current.hasWind = true;
+        m_current.windSpeed = m_wind.Speed();
+        m_current.windDirection = m_wind.Direction();
+        m_current.windQuality = m_wind.Quality();
+    }
+}
+
+void VarioEngine::updateFusedAltitude()
+{
+    m_current.gpsCorrected = m_fusion.IsValid();
+    m_current.fusedAltitude = m_fusion.Altitude();
+}
+
+void VarioEngine::publish(quint64 timestamp)
+{
+    m_current.timestamp = timestamp;
+    m_state.Publish(m_current);
+
+    // The tone follows every filter update, whatever the display is doing
+    if (m_varioSound)
+        m_varioSound->updateVario(m_current.vario);
+}
+
+void VarioEngine::compareWithTruth(quint64 timestamp)
+{
+    // The simulator pushes the truth right after the pressure sample with the
+    // same timestamp; if it is not there yet, that sample is not compared.
+    auto &truth = m_simulator->Truth();
+    while (const TruthSample *t = truth.Front()) {
+        if (t->timestamp > timestamp)
+            break;
+        if (t->timestamp == timestamp) {
+            double varioError = m_current.vario - t->climb;
+            double altitudeError = m_current.altitude - t->altitude;
+            m_truthVarioError2 += varioError * varioError;
+            m_truthAltitudeError2 += altitudeError * altitudeError;
+            ++m_truthCount;
+        }
+        truth.Pop();
+    }
+}
+
+void VarioEngine::reportSampleSource()
+{
+    m_sourceReported = true;
+    qreal elapsed = m_sampleSource->ElapsedSeconds();
+    qDebug().noquote() << QString("%1 finished: %2 samples, %3 s of sensor time in %4 s (%5x real time)")
+                              .arg(m_simulator ? "Simulation" : "Replay")
+                              .arg(m_sampleSource->Samples())
+                              .arg(m_sampleSource->RecordedSeconds(), 0, 'f', 1)
+                              .arg(elapsed, 0, 'f', 3)
+                              .arg(elapsed > 0 ? m_sampleSource->RecordedSeconds() / elapsed : 0.0, 0, 'f', 0);
+    reportSampleStatistics();
+
+    // Back to a normal polling rate; a 0 ms timer would now just spin
+    if (m_busTimer)
+        m_busTimer->start(BUS_POLL_INTERVAL_MS);
+}
+
+void VarioEngine::reportSampleStatistics()
+{
+    auto describe = [](const char *name, const SampleStatistics &stats) {
+        return QString("%1: %2 samples, %3 Hz, interval %4 ms (jitter %5 ms, %6-%7 ms), "
+                       "%8 duplicates, %9 dropouts (%10 samples missed), %11 backwards")
+            .arg(name)
+            .arg(stats.Samples())
+            .arg(stats.Rate(), 0, 'f', 1)
+            .arg(stats.MeanInterval() / 1000.0, 0, 'f', 2)
+            .arg(stats.Jitter() / 1000.0, 0, 'f', 2)
+            .arg(stats.MinInterval() / 1000.0, 0, 'f', 1)
+            .arg(stats.MaxInterval() / 1000.0, 0, 'f', 1)
+            .arg(stats.Duplicates())
+            .arg(stats.Dropouts())
+            .arg(stats.MissedSamples())
+            .arg(stats.Backwards());
+    };
+
+    // Non-empty bins of the interval histogram, the last one open-ended
+    auto histogram = [](const char *name, const SampleStatistics &stats) {
+        QStringList bins;
+        const qreal width = stats.BinWidth() / 1000.0;
+        for (std::size_t bin = 0; bin < SampleStatistics::kHistogramBins; ++bin) {
+            if (stats.Histogram(bin) == 0)
+                continue;
+            const QString range = bin + 1 < SampleStatistics::kHistogramBins
+                ? QString("%1-%2").arg(bin * width, 0, 'f', 0).arg((bin + 1) * width, 0, 'f', 0)
+                : QString(">%1").arg(bin * width, 0, 'f', 0);
+            bins << QString("%1 ms: %2").arg(range).arg(stats.Histogram(bin));
+        }
+        return QString("%1 intervals: %2").arg(name).arg(bins.join(", "));
+    };
+
+    // Figures since the previous report, so a lasting change shows up in the
+    // next one instead of being averaged into the whole session
+    qDebug().noquote() << describe("pressure", m_pressureStats);
+    qDebug().noquote() << histogram("pressure", m_pressureStats);
+    qDebug().noquote() << describe("accelerometer", m_accStats);
+    qDebug().noquote() << histogram("accelerometer", m_accStats);
+    if (m_gpsStats.Samples() > 0) {
+        qDebug().noquote() << describe("gps", m_gpsStats);
+        qDebug().noquote() << histogram("gps", m_gpsStats);
+    }
+    m_pressureStats.NewWindow();
+    m_accStats.NewWindow();
+    m_gpsStats.NewWindow();
+
+    const TemperatureCompensator &compensator = m_processor.Compensator();
+    if (compensator.HasTemperature()) {
+        qDebug().noquote() << QString("temperature compensation: %1 Pa/C from %2 C, correcting %3 Pa, %4 samples learned")
+                                  .arg(compensator.Coefficient(), 0, 'f', 2)
+                                  .arg(compensator.Reference(), 0, 'f', 1)
+                                  .arg(compensator.Correction(), 0, 'f', 1)
+                                  .arg(compensator.LearnedSamples());
+    }
+
+    if (m_fusion.IsValid()) {
+        qDebug().noquote() << QString("altitude fusion: baro %1 m (+/- %2 m), GPS clock %3 s ahead, latency %4 s, "
+                                      "%5 fixes used, %6 rejected")
+                                  .arg(m_fusion.Bias(), 0, 'f', 1)
+                                  .arg(m_fusion.BiasSigma(), 0, 'f', 1)
+                                  .arg(m_fusion.ClockOffset() * 1e-6, 0, 'f', 3)
+                                  .arg(m_fusion.Latency(), 0, 'f', 2)
+                                  .arg(m_fusion.FixesUsed())
+                                  .arg(m_fusion.FixesRejected());
+    }
+
+    if (m_processor.Prefilter().IsProfiling()) {
+        for (const FilterChain::StageCost &cost : m_processor.Prefilter().Costs()) {
+            qDebug().noquote() << QString("prefilter %1: %2 ns per sample")
+                                      .arg(QString::fromStdString(cost.name))
+                                      .arg(cost.MeanNs(), 0, 'f', 1);
+        }
+    }
+
+    if (m_truthCount > 0) {
+        qDebug().noquote() << QString("against simulated truth: vario RMS error %1 m/s, altitude RMS error %2 m over %3 samples")
+                                  .arg(qSqrt(m_truthVarioError2 / m_truthCount), 0, 'f', 3)
+                                  .arg(qSqrt(m_truthAltitudeError2 / m_truthCount), 0, 'f', 2)
+                                  .arg(m_truthCount);
+    }
+}
@@ -0,0 +1,132 @@
+#ifndef VARIOENGINE_H
+#define VARIOENGINE_H
+
+#include <QObject>
+#include <QThread>
+#include <QTimer>
+#include <QString>
+#include <atomic>
+#include <memory>
+#include "SensorSamples.h"
+#include "SampleStatistics.h"
+#include "Snapshot.h"
+#include "VarioProcessor.h"
+#include "AltitudeFusion.h"
+#include "HeadingEstimator.h"
+#include "ThermalDetector.h"
+#include "WindEstimator.h"
+#include "CaptureWriter.h"
+#include "SampleSource.h"
+#include "SimulatorSource.h"
+
+#define BUS_POLL_INTERVAL_MS 10             // How often sensor samples are drained
+#define MERGE_HOLD_US 50000                 // Sensor time a sample waits for the other stream
+#define STATS_REPORT_INTERVAL_MS 10000      // How often sample timing statistics are logged
+#define WIND_MIN_QUALITY 0.4                // Wind estimates below this are not shown
+
+class VarioSound;
+
+// What the filters made of the latest sample, for the display to pick up
+struct VarioState {
+    quint64 timestamp = 0;      // Sensor clock of the sample, us
+    double pressure = 0;        // Filtered pressure in hPa
+    double altitude = 0;        // Barometric altitude in m
+    double fusedAltitude = 0;   // The same corrected by the GPS, see AltitudeFusion
+    bool gpsCorrected = false;  // Whether it is yet; plain baro until then
+    double vario = 0;           // Vertical speed in m/s
+    double temperature = 0;     // Celsius, from the pressure sensor
+    double ambientTemperature = 0;
+    double verticalAcc = 0;     // Earth-frame vertical acceleration in m/s^2
+    double roll = 0;
+    double pitch = 0;
+    double heading = 0;         // Degrees clockwise from north, see HeadingEstimator
+    bool headingValid = false;
+    bool circling = false;      // The thermal is the current one while circling,
+    bool hasThermal = false;    // the last one left otherwise
+    ThermalStats thermal;
+    bool hasCore = false;
+    double coreLatitude = 0;
+    double coreLongitude = 0;
+    bool hasWind = false;       // Last estimate good enough to show
+    double windSpeed = 0;       // km/h
+    double windDirection = 0;   // Degrees the wind blows from
+    double windQuality = 0;     // 0-1, see WindEstimator::Quality()
+};
+
+// The vario's signal path on its own thread: drains the sensor bus, runs the
+// filters, records captures and feeds the tone generator directly, so a slow
+// repaint on the GUI thread can no longer delay the audio. Results are
+// published as snapshots the UI reads at its own pace.
+//
+// Everything passed in with the setters must be set before start() and is
+// then only touched by this thread until it has finished.
+class VarioEngine : public QThread
+{
+    Q_OBJECT
+
+public:
+    VarioEngine(SensorBus *bus, const VarioSettings &settings, QObject *parent = nullptr);
+    ~VarioEngine();
+
+    void setPollInterval(int ms) { m_pollInterval = ms; }
+    void setSampleSource(std::shared_ptr<SampleSource> source, std::shared_ptr<SimulatorSource> simulator);
+    void setCaptureWriter(std::shared_ptr<CaptureWriter> writer) { m_captureWriter = writer; }
+    void setVarioSound(VarioSound *sound) { m_varioSound = sound; }
+
+    void setStop();
+
+    // Latest results, safe to read from any thread
+    const Snapshot<VarioState>& state() const { return m_state; }
+    const Snapshot<GpsFix>& gps() const { return m_gps; }
+
+private slots:
+    void drainSensorBus();
+    void reportSampleStatistics();
+
+protected:
+    void run() override;
+
+private:
+    void processPressure(const PressureSample &sample);
+    void processAcceleration(const AccelSample &sample);
+    void updateCourse(const GpsFix &fix);
+    void updateThermal(const GpsFix &fix);
+    void updateWind(const GpsFix &fix);
+    void updateFusedAltitude();
+    void compareWithTruth(quint64 timestamp);
+    void reportSampleSource();
+    void publish(quint64 timestamp);
+
+    std::atomic<bool> m_stop{false};
+    SensorBus *m_bus;
+    VarioProcessor m_processor;     // Kalman filters, pre-filter and altitude conversion
+    AltitudeFusion m_fusion;        // Baro altitude bias and GPS clock offset
+    HeadingEstimator m_heading;     // Magnetic heading trained on the GPS course
+    ThermalDetector m_thermal;      // Circling and thermal statistics
+    WindEstimator m_wind;           // Circle fit to the ground velocity
+    quint64 m_lastFixTimestamp = 0;
+    VarioSound *m_varioSound = nullptr;
+    std::shared_ptr<CaptureWriter> m_captureWriter;
+    std::shared_ptr<SampleSource> m_sampleSource;
+    std::shared_ptr<SimulatorSource> m_simulator;
+    bool m_sourceReported = false;
+
+    int m_pollInterval = BUS_POLL_INTERVAL_MS;
+    QTimer *m_busTimer = nullptr;   // Created in run(), lives on this thread
+
+    // Sample timing; the filter dt comes from the sensor timestamps
+    SampleStatistics m_pressureStats;
+    SampleStatistics m_accStats;
+    SampleStatistics m_gpsStats;    // On the GPS clock
+
+    // Filter error against the simulator's ground truth
+    double m_truthVarioError2 = 0;
+    double m_truthAltitudeError2 = 0;
+    quint64 m_truthCount = 0;
+
+    VarioState m_current;
+    Snapshot<VarioState> m_state;
+    Snapshot<GpsFix> m_gps;
+};
+
+#endif // VARIOENGINE_H
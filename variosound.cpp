@@ -82,12 +82,13 @@ private:
 };
 
 VarioSound::VarioSound(QObject *parent)
-    : QObject(parent), m_isRunning(false), m_currentVario(0.0), m_frequency(0.0),
-    m_duration(0), m_currentVolume(1.0), m_sinkToneOnThreshold(-1.0), m_climbToneOnThreshold(0.1)
+    : QObject(parent), m_tone(0.1f, -1.0f), m_currentVolume(1.0), m_isRunning(false)
 {
+    // Children, so they follow the object to the audio thread
     m_audioBuffer = new ContinuousAudioBuffer(this);
-    initializeAudio();
-    connect(&m_toneTimer, &QTimer::timeout, this, &VarioSound::generateNextBuffer);
+    m_toneTimer = new QTimer(this);
+    m_toneTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_toneTimer, &QTimer::timeout, this, &VarioSound::generateNextBuffer);
 }
 
 VarioSound::~VarioSound()
@@ -118,26 +119,6 @@ void VarioSound::initializeAudio()
             this, &VarioSound::handleAudioStateChanged);
 }
 
-void VarioSound::calculateSoundCharacteristics()
-{
-    if (m_currentVario > m_sinkToneOnThreshold && m_currentVario < m_climbToneOnThreshold) {
-        m_duration = 50;
-        m_currentVolume = 0.0f;
-        m_frequency = 0.0f;
-    } else if (m_currentVario <= m_sinkToneOnThreshold) {
-        m_frequency = 440.0f;
-        m_duration = 800;
-        m_currentVolume = 1.0f;
-    } else if (m_currentVario >= m_climbToneOnThreshold) {
-        m_frequency = qBound(750.0f,
-                             750.0f + 1450.0f * (m_currentVario / 5.0f),
-                             2200.0f);
-        float durationRange = 400.0f - 50.0f;
-        m_duration = 400.0f - (durationRange * (m_currentVario / 5.0f));
-        m_currentVolume = 1.0f;
-    }
-}
-
 void VarioSound::handleAudioStateChanged(QAudio::State state)
 {
     if (state == QAudio::IdleState && m_isRunning) {
@@ -222,51 +203,37 @@ void VarioSound::generateNextBuffer()
 {
     if (!m_isRunning) return;
 
-    static bool isBeeping = false;
-    calculateSoundCharacteristics();
-
-    if (m_currentVario >= m_climbToneOnThreshold) {
-        if (isBeeping) {
-            if (m_currentVolume > 0.0f && m_frequency > 0.0f) {
-                generateTone(m_frequency, m_duration);
-                if (m_audioSink->state() == QAudio::StoppedState ||
-                    m_audioSink->state() == QAudio::IdleState) {
-                    m_audioSink->start(m_audioBuffer);
-                }
-            }
-        } else {
-            if (m_audioSink->state() == QAudio::ActiveState) {
-                m_audioSink->stop();
-            }
-        }
-        isBeeping = !isBeeping;
-    } else if (m_currentVario <= m_sinkToneOnThreshold) {
-        if (m_currentVolume > 0.0f && m_frequency > 0.0f) {
-            generateTone(m_frequency, m_duration);
-            if (m_audioSink->state() == QAudio::StoppedState ||
-                m_audioSink->state() == QAudio::IdleState) {
-                m_audioSink->start(m_audioBuffer);
-            }
+    Tone tone = m_tone.Next(m_currentVario.load(std::memory_order_relaxed));
+    m_currentVolume = tone.volume;
+
+    if (tone.audible) {
+        generateTone(tone.frequency, tone.duration_ms);
+        if (m_audioSink->state() == QAudio::StoppedState ||
+            m_audioSink->state() == QAudio::IdleState) {
+            m_audioSink->start(m_audioBuffer);
         }
     } else {
         if (m_audioSink->state() == QAudio::ActiveState) {
             m_audioSink->stop();
         }
-        isBeeping = false;
     }
 
-    m_toneTimer.start(m_duration);
+    m_toneTimer->start(tone.duration_ms);
 }
 
 void VarioSound::updateVario(qreal vario)
 {
-    m_currentVario = vario;
+    m_currentVario.store(vario, std::memory_order_relaxed);
 }
 
 void VarioSound::start()
 {
     if (!m_isRunning) {
+        if (!m_audioSink) {
+            initializeAudio();
+        }
         m_isRunning = true;
+        m_tone.Reset();
         generateNextBuffer();
     }
 }
@@ -274,7 +241,7 @@ void VarioSound::start()
 void VarioSound::stop()
 {
     m_isRunning = false;
-    m_toneTimer.stop();
+    m_toneTimer->stop();
     if (m_audioSink) {
         m_audioSink->stop();
     }
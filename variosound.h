@@ -7,10 +7,15 @@
 #include <QAudioSink>
 #include <QTimer>
 #include <QBuffer>
+#include <atomic>
 #include <memory>
+#include "VarioTone.h"
 
 class ContinuousAudioBuffer;
 
+// Plays the vario tone. Meant to live on its own thread (moveToThread, then
+// start() through a queued call) so beeps keep their timing however busy the
+// GUI is; the audio sink is created in start(), on that thread.
 class VarioSound : public QObject {
     Q_OBJECT
 public:
@@ -19,7 +24,7 @@ public:
 
     void start();
     void stop();
-    void updateVario(qreal vario);
+    void updateVario(qreal vario);      // Thread-safe, called by the DSP thread
 
 private slots:
     void handleAudioStateChanged(QAudio::State state);
@@ -29,20 +34,16 @@ private:
     void initializeAudio();
     //void generateTone(float frequency, int durationMs);
     void generateTone(float frequency, int durationMs);
-    void calculateSoundCharacteristics();
 
     std::unique_ptr<QAudioSink> m_audioSink;
     QByteArray m_audioData;
 
     ContinuousAudioBuffer* m_audioBuffer;
-    QTimer m_toneTimer;
+    QTimer *m_toneTimer;
 
-    float m_climbToneOnThreshold{};
-    float m_sinkToneOnThreshold{};
-    qreal m_currentVario{};
+    VarioTone m_tone;           // Decides tone and beep timing from the vario
+    std::atomic<qreal> m_currentVario{0.0};
     float m_currentVolume{};
-    int m_duration{};
-    float m_frequency{};
     bool m_isRunning{false};
 
     static constexpr int SAMPLE_RATE = 44100;
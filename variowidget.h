@@ -6,6 +6,7 @@
 #include <QPainterPath>
 #include <QTimer>
 #include <QPolygonF>
+#include <QtMath>
 
 class VarioWidget : public QWidget {
     Q_OBJECT
@@ -13,14 +14,21 @@ class VarioWidget : public QWidget {
 public:
     explicit VarioWidget(QWidget* parent = nullptr)
         : QWidget(parent), m_heading(0), m_sizeRatio(1.0f), m_thickness(0.04f), m_padding(5) {
-        QTimer* timer = new QTimer(this);
-        connect(timer, &QTimer::timeout, this, [this]() { this->update(); });
-        timer->start(16); // Approximately 60 FPS
+        // Only runs while the card is turning towards a new heading, so an
+        // unchanged heading costs no repaints at all
+        m_headingTimer = new QTimer(this);
+        m_headingTimer->setInterval(16); // Approximately 60 FPS
+        connect(m_headingTimer, &QTimer::timeout, this, &VarioWidget::stepHeading);
     }
 
+    // Heading in degrees; the card turns there the short way round over a few frames
     void setHeading(float heading) {
-        m_heading = heading;
-        update();
+        heading = wrapHeading(heading);
+        if (heading == m_targetHeading)
+            return;
+        m_targetHeading = heading;
+        if (!m_headingTimer->isActive())
+            m_headingTimer->start();
     }
 
     void setSizeRatio(float ratio) {
@@ -39,7 +47,10 @@ public:
     }
 
     void setVerticalSpeed(float vario) {
-        m_verticalSpeed = qBound(MIN_VARIO, vario, MAX_VARIO);
+        vario = qBound(MIN_VARIO, vario, MAX_VARIO);
+        if (vario == m_verticalSpeed)
+            return;
+        m_verticalSpeed = vario;
         update();
     }
 
@@ -72,8 +83,33 @@ protected:
         update(); // Trigger a repaint when the widget is resized
     }
 
+private slots:
+    void stepHeading()
+    {
+        // Eases a fixed fraction of the remaining turn per frame; the
+        // difference is wrapped so 350 -> 10 turns 20 degrees, not 340
+        float diff = wrapHeading(m_targetHeading - m_heading + 180.0f) - 180.0f;
+        if (qAbs(diff) < HEADING_SETTLED) {
+            m_heading = m_targetHeading;
+            m_headingTimer->stop();
+        } else {
+            m_heading = wrapHeading(m_heading + diff * HEADING_EASING);
+        }
+        update();
+    }
+
 private:
+    static float wrapHeading(float heading)
+    {
+        heading = std::fmod(heading, 360.0f);
+        if (heading < 0)
+            heading += 360.0f;
+        return heading < 360.0f ? heading : 0.0f;
+    }
+
+    QTimer* m_headingTimer;
     float m_heading= 0.0f;
+    float m_targetHeading = 0.0f;
     float m_verticalSpeed= 0.0f;
 
     float m_sizeRatio;
@@ -83,6 +119,8 @@ private:
 
     const float MAX_VARIO = 10.0f;
     const float MIN_VARIO = -10.0f;
+    const float HEADING_EASING = 0.25f;     // Fraction of the remaining turn per frame
+    const float HEADING_SETTLED = 0.05f;    // Degrees
 
     void drawCompassAndHSI(QPainter& painter, const QRectF& rect)
     {
@@ -164,7 +202,7 @@ private:
         }
         painter.restore();
 
-        QString headingText = QString::number(qRound(m_heading));
+        QString headingText = QString::number(qRound(m_heading) % 360);
         QRectF digitalRect(center.x() - 60, center.y() + innerRadius * 0.55, 120, 40);
 
         painter.setPen(Qt::NoPen);